@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace h1st {
+
+template <typename T>
+class array_ref
+{
+private:
+
+    const T* _begin;
+    const T* _end;
+
+public:
+
+    typedef T value_type;
+    typedef const T* const_iterator;
+
+    array_ref(
+    ) :
+        _begin(0),
+        _end(0)
+    {
+    }
+
+    array_ref(
+        const T* begin,
+        const T* end
+    ) :
+        _begin(begin),
+        _end(end)
+    {
+    }
+
+    const_iterator begin(
+    ) const
+    {
+        return _begin;
+    }
+
+    const_iterator end(
+    ) const
+    {
+        return _end;
+    }
+
+    size_t size(
+    ) const
+    {
+        return static_cast<size_t>(_end - _begin);
+    }
+
+    bool empty(
+    ) const
+    {
+        return _begin == _end;
+    }
+
+    const T& operator [](
+        size_t i
+    ) const
+    {
+        return _begin[i];
+    }
+};
+
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <h1st/node_arena.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct heap_allocator
+{
+    void* allocate(
+        size_t size
+    )
+    {
+        return ::operator new(size);
+    }
+
+    void deallocate(
+        void* block,
+        size_t
+    )
+    {
+        ::operator delete(block);
+    }
+};
+
+/**
+ * Replays the allocation pattern of a graph whose outputs are constantly
+ * overwritten: a window of live node blocks of varying sizes where the
+ * oldest block is released whenever a new one is pushed.
+ */
+template <typename Allocator>
+void alloc_churn(
+    benchmark::State& state
+)
+{
+    const size_t window = static_cast<size_t>(state.range(0));
+
+    Allocator allocator;
+    std::vector<std::pair<void*, size_t> > live(window);
+
+    for (size_t i = 0; i < window; i++)
+    {
+        const size_t size = 88 + 24 * (i % 5) + 16 * (1 + i % 3);
+        live[i] = std::make_pair(allocator.allocate(size), size);
+    }
+
+    size_t i = 0;
+
+    for (auto _ : state)
+    {
+        const size_t slot = i % window;
+        const size_t size = 88 + 24 * (i % 5) + 16 * (1 + i % 3);
+
+        allocator.deallocate(live[slot].first, live[slot].second);
+        live[slot] = std::make_pair(allocator.allocate(size), size);
+        benchmark::DoNotOptimize(live[slot].first);
+
+        i++;
+    }
+
+    for (size_t j = 0; j < window; j++)
+        allocator.deallocate(live[j].first, live[j].second);
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void push_churn(
+    benchmark::State& state
+)
+{
+    const size_t width = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    h1st::bench::make_lattice(graph, width, 2);
+
+    std::vector<std::string> files_in(1, h1st::bench::file_name("out.", 0, 0));
+    std::vector<std::string> files_out(1);
+
+    size_t i = 0;
+
+    for (auto _ : state)
+    {
+        files_out[0] = h1st::bench::file_name("out.", 1, i % width);
+        graph.push_node(files_in.begin(), files_in.end(),
+            "command", files_out.begin(), files_out.end());
+        i++;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+void teardown(
+    benchmark::State& state
+)
+{
+    const size_t length = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        h1st::hist_graph* graph = new h1st::hist_graph();
+        h1st::bench::make_chain(*graph, length);
+        state.ResumeTiming();
+
+        delete graph;
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+BENCHMARK_TEMPLATE(alloc_churn, h1st::node_arena)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(alloc_churn, heap_allocator)->Range(1 << 8, 1 << 16);
+BENCHMARK(push_churn)->Range(1 << 4, 1 << 12);
+BENCHMARK(teardown)->Range(1 << 10, 1 << 16)->Unit(benchmark::kMillisecond);
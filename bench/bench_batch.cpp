@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<h1st::hist_step> make_steps(
+    size_t count,
+    size_t shard = 0
+)
+{
+    std::vector<h1st::hist_step> steps;
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        files_in.clear();
+
+        if (i > 0)
+            files_in.push_back(h1st::bench::file_name("out.", shard,
+                (i - 1) % 1024));
+
+        files_out[0] = h1st::bench::file_name("out.", shard, i % 1024);
+
+        steps.push_back(h1st::hist_step(files_in.begin(), files_in.end(),
+            "command", files_out.begin(), files_out.end()));
+    }
+
+    return steps;
+}
+
+void push_each(
+    benchmark::State& state
+)
+{
+    const std::vector<h1st::hist_step> steps = make_steps(
+        static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+
+        for (size_t i = 0; i < steps.size(); i++)
+        {
+            graph.push_node(
+                steps[i].files_in().begin(), steps[i].files_in().end(),
+                steps[i].command(),
+                steps[i].files_out().begin(), steps[i].files_out().end());
+        }
+
+        benchmark::DoNotOptimize(graph.bytes_used());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void push_batch(
+    benchmark::State& state
+)
+{
+    const std::vector<h1st::hist_step> steps = make_steps(
+        static_cast<size_t>(state.range(0)));
+    const size_t batch = static_cast<size_t>(state.range(1));
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+
+        for (size_t i = 0; i < steps.size(); i += batch)
+        {
+            graph.push_batch(steps.begin() + i,
+                steps.begin() + std::min(steps.size(), i + batch));
+        }
+
+        benchmark::DoNotOptimize(graph.bytes_used());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void merge_shards(
+    benchmark::State& state
+)
+{
+    // Each worker records its own files, the merge shares nothing but
+    // the paths and commands
+
+    const size_t num_shards = static_cast<size_t>(state.range(1));
+
+    std::vector<h1st::hist_graph*> shards;
+    std::vector<const h1st::hist_graph*> graphs;
+
+    for (size_t i = 0; i < num_shards; i++)
+    {
+        const std::vector<h1st::hist_step> steps = make_steps(
+            static_cast<size_t>(state.range(0)) / num_shards, i);
+
+        shards.push_back(new h1st::hist_graph());
+        shards.back()->push_batch(steps.begin(), steps.end());
+        graphs.push_back(shards.back());
+    }
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        graph.merge(graphs.begin(), graphs.end());
+
+        benchmark::DoNotOptimize(graph.bytes_used());
+    }
+
+    for (size_t i = 0; i < num_shards; i++)
+        delete shards[i];
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+BENCHMARK(push_each)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+BENCHMARK(push_batch)->Args({1 << 16, 64})->Args({1 << 16, 1024})
+    ->Args({1 << 16, 16384})->Unit(benchmark::kMillisecond);
+BENCHMARK(merge_shards)->Args({1 << 16, 1})->Args({1 << 16, 4})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <h1st/concurrent.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t num_files = 256;
+
+/**
+ * The baseline: every call goes through one global mutex.
+ */
+class locked_graph
+{
+private:
+
+    mutable std::mutex _mutex;
+    h1st::hist_graph _graph;
+
+public:
+
+    template <typename ITF, typename ITO>
+    void push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _graph.push_node(files_in_begin, files_in_end, command,
+            files_out_begin, files_out_end);
+    }
+
+    template <typename ITO>
+    void push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _graph.push_node(command, files_out_begin, files_out_end);
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _graph.has_input(file);
+    }
+
+    template <typename ITF>
+    size_t track(
+        ITF files_begin,
+        ITF files_end
+    ) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<const h1st::hist_node*> nodes;
+        _graph.track(files_begin, files_end, std::back_inserter(nodes), true);
+        return nodes.size();
+    }
+};
+
+/**
+ *
+ */
+class shared_graph
+{
+private:
+
+    h1st::concurrent_hist_graph _graph;
+
+public:
+
+    template <typename ITF, typename ITO>
+    void push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        _graph.push_node(files_in_begin, files_in_end, command,
+            files_out_begin, files_out_end);
+    }
+
+    template <typename ITO>
+    void push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        _graph.push_node(command, files_out_begin, files_out_end);
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        return _graph.has_input(file);
+    }
+
+    template <typename ITF>
+    size_t track(
+        ITF files_begin,
+        ITF files_end
+    ) const
+    {
+        std::vector<const h1st::concurrent_node*> nodes;
+        _graph.track(files_begin, files_end, std::back_inserter(nodes), true);
+        return nodes.size();
+    }
+};
+
+/**
+ * Record one step of a workload where chains of 16 steps rotate over a
+ * fixed pool of files, so old nodes keep being released.
+ */
+template <typename Graph>
+void push_step(
+    Graph& graph,
+    const std::vector<std::string>& files,
+    size_t step
+)
+{
+    const std::string* file_in = &files[(step + num_files - 1) % num_files];
+    const std::string* file_out = &files[step % num_files];
+
+    if (step % 16 != 0 && graph.has_input(*file_in))
+        graph.push_node(file_in, file_in + 1, "command",
+            file_out, file_out + 1);
+    else
+        graph.push_node("command", file_out, file_out + 1);
+}
+
+template <typename Graph>
+struct fixture
+{
+    std::vector<std::string> files;
+    Graph graph;
+    std::atomic<bool> stop;
+    std::thread writer;
+
+    fixture(
+    ) :
+        files(),
+        graph(),
+        stop(false),
+        writer()
+    {
+        for (size_t i = 0; i < num_files; i++)
+            files.push_back(h1st::bench::file_name("out.", 0, i));
+
+        for (size_t i = 0; i < num_files; i++)
+            push_step(graph, files, i);
+
+        writer = std::thread([this]()
+        {
+            for (size_t i = num_files; !stop.load(); i++)
+                push_step(graph, files, i);
+        });
+    }
+
+    ~fixture(
+    )
+    {
+        stop.store(true);
+        writer.join();
+    }
+};
+
+/**
+ * Reader threads query the graph while one writer keeps pushing.
+ */
+template <typename Graph>
+void query(
+    benchmark::State& state
+)
+{
+    static std::unique_ptr<fixture<Graph> > shared;
+
+    if (state.thread_index() == 0)
+        shared.reset(new fixture<Graph>());
+
+    size_t i = static_cast<size_t>(state.thread_index()) * 7919;
+
+    for (auto _ : state)
+    {
+        const std::string& file = shared->files[i++ % num_files];
+
+        benchmark::DoNotOptimize(shared->graph.has_input(file));
+        benchmark::DoNotOptimize(shared->graph.track(&file, &file + 1));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0)
+        shared.reset();
+}
+
+void query_locked(
+    benchmark::State& state
+)
+{
+    query<locked_graph>(state);
+}
+
+void query_concurrent(
+    benchmark::State& state
+)
+{
+    query<shared_graph>(state);
+}
+
+}
+
+BENCHMARK(query_locked)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(query_concurrent)->ThreadRange(1, 64)->UseRealTime();
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <h1st/exporters.hpp>
+#include <h1st/loader.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+template <typename Printer>
+const std::string& printed_chain(
+)
+{
+    static std::string text;
+
+    if (text.empty())
+    {
+        h1st::hist_graph graph;
+        h1st::bench::make_chain(graph, 1 << 20);
+
+        std::stringstream ss;
+
+        {
+            h1st::output_buffer buffer(&ss);
+            Printer printer(&buffer);
+            graph.print(printer);
+        }
+
+        text = ss.str();
+    }
+
+    return text;
+}
+
+void load_printed(
+    benchmark::State& state
+)
+{
+    const std::string& text =
+        printed_chain<h1st::hist_node_print_buffered>();
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        h1st::load_printed_graph(graph, text.data(), text.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+    state.SetBytesProcessed(state.iterations() *
+        static_cast<int64_t>(text.size()));
+}
+
+void load_jsonl(
+    benchmark::State& state
+)
+{
+    const std::string& text =
+        printed_chain<h1st::hist_node_export_jsonl>();
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        h1st::load_jsonl_graph(graph, text.data(), text.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+    state.SetBytesProcessed(state.iterations() *
+        static_cast<int64_t>(text.size()));
+}
+
+void push_node_chain(
+    benchmark::State& state
+)
+{
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        h1st::bench::make_chain(graph, 1 << 20);
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+}
+
+BENCHMARK(load_printed)->Unit(benchmark::kMillisecond);
+BENCHMARK(load_jsonl)->Unit(benchmark::kMillisecond);
+BENCHMARK(push_node_chain)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <h1st/exporters.hpp>
+#include <h1st/output_buffer.hpp>
+#include <h1st/provenance.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+const h1st::hist_graph& chain_1m(
+)
+{
+    static h1st::hist_graph graph;
+
+    if (graph.paths().size() == 0)
+        h1st::bench::make_chain(graph, 1 << 20);
+
+    return graph;
+}
+
+void print_stream(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    std::ofstream stream("/dev/null");
+
+    for (auto _ : state)
+    {
+        h1st::hist_node_print_to_stream printer(&stream);
+        graph.print(printer);
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void print_buffered_stream(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    std::ofstream stream("/dev/null");
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(&stream);
+        h1st::hist_node_print_buffered printer(&buffer);
+        graph.print(printer);
+        buffer.flush();
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void print_buffered_fd(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(fd);
+        h1st::hist_node_print_buffered printer(&buffer);
+        graph.print(printer);
+        buffer.flush();
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void export_dot(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(fd);
+        h1st::hist_node_export_dot exporter(&buffer);
+        graph.print(exporter);
+        exporter.close();
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void export_track_dot(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    const std::string file = h1st::bench::file_name("out.", (1 << 20) - 1, 0);
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(fd);
+        h1st::hist_node_export_dot exporter(&buffer);
+        graph.track(&file, &file + 1, h1st::make_printer_iterator(exporter),
+            false);
+        exporter.close();
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void export_condensed_dot(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    const std::string file = h1st::bench::file_name("out.", (1 << 20) - 1, 0);
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        std::vector<const h1st::hist_node*> nodes;
+        graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+        h1st::condensed_provenance<const h1st::hist_node*> provenance(
+            nodes.begin(), nodes.end());
+        provenance.reduce();
+
+        h1st::output_buffer buffer(fd);
+        h1st::export_condensed_dot(&buffer, provenance);
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+void export_jsonl(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = chain_1m();
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(fd);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+        graph.print(exporter);
+        buffer.flush();
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() * (1 << 20));
+}
+
+}
+
+BENCHMARK(print_stream)->Unit(benchmark::kMillisecond);
+BENCHMARK(print_buffered_stream)->Unit(benchmark::kMillisecond);
+BENCHMARK(print_buffered_fd)->Unit(benchmark::kMillisecond);
+BENCHMARK(export_dot)->Unit(benchmark::kMillisecond);
+BENCHMARK(export_track_dot)->Unit(benchmark::kMillisecond);
+BENCHMARK(export_condensed_dot)->Unit(benchmark::kMillisecond);
+BENCHMARK(export_jsonl)->Unit(benchmark::kMillisecond);
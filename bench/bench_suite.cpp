@@ -0,0 +1,535 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <h1st/branch.hpp>
+#include <h1st/graph_policies.hpp>
+#include <h1st/output_buffer.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Every operation runs over every shape of history, state.range(0) is
+// the number of steps pushed to build the shape
+
+namespace {
+
+struct chain_shape
+{
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_chain(graph, n);
+    }
+
+    static std::vector<std::string> outputs(
+        size_t n
+    )
+    {
+        return std::vector<std::string>(1,
+            h1st::bench::file_name("out.", n - 1, 0));
+    }
+};
+
+struct fan_in_shape
+{
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_fan_in(graph, n - 1);
+    }
+
+    static std::vector<std::string> outputs(
+        size_t
+    )
+    {
+        return std::vector<std::string>(1,
+            h1st::bench::file_name("out.", 1, 0));
+    }
+};
+
+struct fan_out_shape
+{
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_fan_out(graph, n - 1);
+    }
+
+    static std::vector<std::string> outputs(
+        size_t n
+    )
+    {
+        std::vector<std::string> files;
+
+        for (size_t i = 0; i < n - 1; i++)
+            files.push_back(h1st::bench::file_name("out.", 1, i));
+
+        return files;
+    }
+};
+
+struct lattice_shape
+{
+    static const size_t width = 16;
+
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_lattice(graph, width, n / width);
+    }
+
+    static std::vector<std::string> outputs(
+        size_t n
+    )
+    {
+        std::vector<std::string> files;
+
+        for (size_t i = 0; i < width; i++)
+            files.push_back(h1st::bench::file_name("out.", n / width - 1, i));
+
+        return files;
+    }
+};
+
+struct churn_shape
+{
+    static const size_t num_files = 8;
+
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_churn(graph, n, num_files);
+    }
+
+    static std::vector<std::string> outputs(
+        size_t
+    )
+    {
+        std::vector<std::string> files;
+
+        for (size_t i = 0; i < num_files; i++)
+            files.push_back(h1st::bench::file_name("out.", 0, i));
+
+        return files;
+    }
+};
+
+struct deep_path_shape
+{
+    static const std::string& prefix(
+    )
+    {
+        static const std::string value = h1st::bench::deep_prefix(16);
+        return value;
+    }
+
+    template <typename Graph>
+    static void build(
+        Graph& graph,
+        size_t n
+    )
+    {
+        h1st::bench::make_chain(graph, n, prefix().c_str());
+    }
+
+    static std::vector<std::string> outputs(
+        size_t n
+    )
+    {
+        return std::vector<std::string>(1,
+            h1st::bench::file_name(prefix().c_str(), n - 1, 0));
+    }
+};
+
+struct node_counter
+{
+    size_t count;
+
+    node_counter(
+    ) :
+        count(0)
+    {
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node&
+    )
+    {
+        count++;
+    }
+};
+
+template <typename Shape>
+void push_node(
+    benchmark::State& state
+)
+{
+    // Building the shape measures push_node, and for the churn shape
+    // the release and prune of the shadowed nodes
+
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    size_t bytes = 0;
+    size_t nodes = 0;
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        Shape::build(graph, n);
+
+        state.PauseTiming();
+        node_counter counter;
+        graph.print(counter);
+        bytes = graph.bytes_used();
+        nodes = counter.count;
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["live_nodes"] = static_cast<double>(nodes);
+    state.counters["bytes_per_node"] = nodes == 0 ? 0.0 :
+        static_cast<double>(bytes) / static_cast<double>(nodes);
+}
+
+template <typename Shape>
+void has_input(
+    benchmark::State& state
+)
+{
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    Shape::build(graph, n);
+
+    const std::vector<std::string> files = Shape::outputs(n);
+
+    for (auto _ : state)
+        for (size_t i = 0; i < files.size(); i++)
+            benchmark::DoNotOptimize(graph.has_input(files[i]));
+
+    state.SetItemsProcessed(state.iterations() *
+        static_cast<int64_t>(files.size()));
+}
+
+template <typename Shape>
+void track(
+    benchmark::State& state
+)
+{
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    Shape::build(graph, n);
+
+    const std::vector<std::string> files = Shape::outputs(n);
+    std::vector<const h1st::hist_node*> nodes;
+
+    for (auto _ : state)
+    {
+        nodes.clear();
+        graph.track(files.begin(), files.end(), std::back_inserter(nodes),
+            false);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() *
+        static_cast<int64_t>(nodes.size()));
+}
+
+template <typename Shape>
+void print(
+    benchmark::State& state
+)
+{
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    Shape::build(graph, n);
+
+    node_counter counter;
+    graph.print(counter);
+
+    const int fd = ::open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        h1st::output_buffer buffer(fd);
+        h1st::hist_node_print_buffered printer(&buffer);
+        graph.print(printer);
+        buffer.flush();
+    }
+
+    ::close(fd);
+
+    state.SetItemsProcessed(state.iterations() *
+        static_cast<int64_t>(counter.count));
+}
+
+template <typename Shape>
+void prune(
+    benchmark::State& state
+)
+{
+    // The outputs of the shape are rebound so its whole history becomes
+    // garbage, which a deferred graph keeps until the collection, the
+    // only part that is timed
+
+    typedef h1st::basic_hist_graph<h1st::null_stats,
+        h1st::deferred_pruning> graph_type;
+
+    const size_t n = static_cast<size_t>(state.range(0));
+    const std::vector<std::string> files = Shape::outputs(n);
+    size_t num_garbage = 0;
+
+    for (auto _ : state)
+    {
+        graph_type graph(h1st::command_store::encoding_plain,
+            h1st::deferred_pruning(static_cast<size_t>(-1)));
+
+        Shape::build(graph, n);
+
+        for (size_t i = 0; i < files.size(); i++)
+            graph.push_node("rebind", files.begin() + i,
+                files.begin() + i + 1);
+
+        num_garbage = graph.num_garbage();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        graph.collect();
+
+        state.SetIterationTime(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations() *
+        static_cast<int64_t>(num_garbage));
+}
+
+template <typename Pruning>
+void churn_pruning(
+    benchmark::State& state
+)
+{
+    typedef h1st::basic_hist_graph<h1st::null_stats, Pruning> graph_type;
+
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        graph_type graph;
+        h1st::bench::make_churn(graph, n);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Pruning>
+void churn_pause(
+    benchmark::State& state
+)
+{
+    // Long lived nodes followed by a temporary file that is rewritten
+    // over and over, the counters are the longest single push and the
+    // pushes over 100 us, which also catch the node vector growing
+
+    typedef h1st::basic_hist_graph<h1st::null_stats, Pruning> graph_type;
+
+    const size_t n = static_cast<size_t>(state.range(0));
+    double max_pause = 0;
+    size_t num_slow = 0;
+
+    for (auto _ : state)
+    {
+        graph_type graph;
+        h1st::bench::make_fan_out(graph, n);
+
+        std::vector<std::string> files_out(1, "tmp");
+
+        for (size_t i = 0; i < 4 * n; i++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            graph.push_node("tmp", files_out.begin(), files_out.end());
+
+            const double pause = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count();
+
+            max_pause = std::max(max_pause, pause);
+            num_slow += pause > 100 ? 1 : 0;
+        }
+    }
+
+    state.counters["max_pause_us"] = max_pause;
+    state.counters["slow_pushes"] = static_cast<double>(num_slow);
+    state.SetItemsProcessed(state.iterations() * 4 * state.range(0));
+}
+
+void fork_graph(
+    benchmark::State& state
+)
+{
+    // Forks taken directly from an unmodified graph share its snapshot
+
+    h1st::hist_graph graph;
+    h1st::bench::make_chain(graph, 1 << 16);
+    graph.fork();
+
+    const size_t n = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < n; i++)
+            benchmark::DoNotOptimize(graph.fork().num_nodes());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void fork_nested(
+    benchmark::State& state
+)
+{
+    // A chain of what-if forks, each one adding a node to the previous
+
+    h1st::hist_graph graph;
+    h1st::bench::make_chain(graph, 1 << 10);
+
+    const size_t n = static_cast<size_t>(state.range(0));
+    const std::vector<std::string> files(1,
+        h1st::bench::file_name("out.", (1 << 10) - 1, 0));
+
+    for (auto _ : state)
+    {
+        h1st::hist_branch branch = graph.fork();
+
+        for (size_t i = 0; i < n; i++)
+        {
+            branch.push_node(files.begin(), files.end(), "command",
+                files.begin(), files.end());
+            branch = branch.fork();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void fork_interleaved(
+    benchmark::State& state
+)
+{
+    // Every fork after a push rebuilds the snapshot of the graph, so
+    // this grows with the size of the graph
+
+    const size_t n = static_cast<size_t>(state.range(0));
+    std::vector<std::string> files(1, "out");
+
+    for (auto _ : state)
+    {
+        h1st::hist_graph graph;
+        h1st::bench::make_chain(graph, n);
+
+        std::vector<h1st::hist_branch> branches;
+
+        for (size_t i = 0; i < 64; i++)
+        {
+            graph.push_node("command", files.begin(), files.end());
+            branches.push_back(graph.fork());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+
+}
+
+#define H1ST_BENCH_PRUNE(Shape) \
+    BENCHMARK_TEMPLATE(prune, Shape)->RangeMultiplier(8) \
+        ->Range(1 << 10, 1 << 16)->UseManualTime()->Iterations(16)
+
+#define H1ST_BENCH_SHAPES(Operation) \
+    BENCHMARK_TEMPLATE(Operation, chain_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(Operation, fan_in_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(Operation, fan_out_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(Operation, lattice_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(Operation, churn_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16); \
+    BENCHMARK_TEMPLATE(Operation, deep_path_shape) \
+        ->RangeMultiplier(8)->Range(1 << 10, 1 << 16)
+
+H1ST_BENCH_SHAPES(push_node);
+H1ST_BENCH_SHAPES(has_input);
+H1ST_BENCH_SHAPES(track);
+H1ST_BENCH_SHAPES(print);
+
+H1ST_BENCH_PRUNE(chain_shape);
+H1ST_BENCH_PRUNE(fan_in_shape);
+H1ST_BENCH_PRUNE(fan_out_shape);
+H1ST_BENCH_PRUNE(lattice_shape);
+H1ST_BENCH_PRUNE(churn_shape);
+H1ST_BENCH_PRUNE(deep_path_shape);
+
+BENCHMARK_TEMPLATE(churn_pruning, h1st::eager_pruning)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(churn_pruning, h1st::deferred_pruning)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(churn_pruning, h1st::no_pruning)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(churn_pruning, h1st::incremental_pruning)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(churn_pruning, h1st::generational_pruning)->Arg(1 << 16);
+
+BENCHMARK_TEMPLATE(churn_pause, h1st::eager_pruning)->Arg(1 << 18)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(churn_pause, h1st::incremental_pruning)->Arg(1 << 18)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(churn_pause, h1st::generational_pruning)->Arg(1 << 18)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(fork_graph)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(fork_nested)->Arg(10000)->Arg(20000)->Arg(80000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(fork_interleaved)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)
+    ->Unit(benchmark::kMillisecond);
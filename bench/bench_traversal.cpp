@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+void track_chain(
+    benchmark::State& state
+)
+{
+    const size_t length = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    h1st::bench::make_chain(graph, length);
+
+    const std::string file = h1st::bench::file_name("out.", length - 1, 0);
+    std::vector<const h1st::hist_node*> nodes;
+
+    for (auto _ : state)
+    {
+        nodes.clear();
+        graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void track_chain_snapshot(
+    benchmark::State& state
+)
+{
+    const size_t length = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    h1st::bench::make_chain(graph, length);
+
+    const h1st::hist_snapshot& snapshot = graph.snapshot();
+
+    const std::string file = h1st::bench::file_name("out.", length - 1, 0);
+    std::vector<h1st::hist_csr_node> nodes;
+
+    for (auto _ : state)
+    {
+        nodes.clear();
+        snapshot.track(&file, &file + 1, std::back_inserter(nodes), false);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void track_lattice(
+    benchmark::State& state
+)
+{
+    const size_t width = 8;
+    const size_t depth = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    h1st::bench::make_lattice(graph, width, depth);
+
+    const std::string file = h1st::bench::file_name("out.", depth - 1, 0);
+    std::vector<const h1st::hist_node*> nodes;
+
+    for (auto _ : state)
+    {
+        nodes.clear();
+        graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * width);
+}
+
+void ancestors_chain_first(
+    benchmark::State& state
+)
+{
+    const size_t length = static_cast<size_t>(state.range(0));
+
+    h1st::hist_graph graph;
+    h1st::bench::make_chain(graph, length);
+
+    const std::string file = h1st::bench::file_name("out.", length - 1, 0);
+
+    for (auto _ : state)
+    {
+        // Stop at the fifth ancestor, the cost must not depend on length
+
+        h1st::provenance_range<h1st::hist_node> range = graph.ancestors(
+            &file, &file + 1, false);
+
+        h1st::provenance_range<h1st::hist_node>::iterator it = range.begin();
+        for (int i = 0; i < 5 && it != range.end(); i++)
+            ++it;
+
+        benchmark::DoNotOptimize(*it);
+    }
+}
+
+const h1st::hist_graph& lattice_1m(
+)
+{
+    static h1st::hist_graph graph;
+
+    if (graph.paths().size() == 0)
+        h1st::bench::make_lattice(graph, 10000, 100);
+
+    return graph;
+}
+
+void track_many_parallel(
+    benchmark::State& state
+)
+{
+    const h1st::hist_graph& graph = lattice_1m();
+    const size_t num_threads = static_cast<size_t>(state.range(0));
+
+    std::vector<std::string> files;
+    for (size_t i = 0; i < 10000; i++)
+        files.push_back(h1st::bench::file_name("out.", 99, i));
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    for (auto _ : state)
+    {
+        nodes.clear();
+        graph.track_parallel(files.begin(), files.end(),
+            std::back_inserter(nodes), false, num_threads);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() *
+        static_cast<int64_t>(nodes.size()));
+}
+
+}
+
+BENCHMARK(track_chain)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(track_chain_snapshot)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(track_lattice)->Range(1 << 4, 1 << 12)->Unit(benchmark::kMillisecond);
+BENCHMARK(ancestors_chain_first)->Range(1 << 10, 1 << 20);
+BENCHMARK(track_many_parallel)->RangeMultiplier(2)->Range(1, 64)
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <h1st/historian.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace h1st {
+namespace bench {
+
+inline std::string file_name(
+    const char* prefix,
+    size_t layer,
+    size_t index
+)
+{
+    char buffer[64];
+    std::sprintf(buffer, "%zu.%zu.txt", layer, index);
+    return prefix + std::string(buffer);
+}
+
+/**
+ * Push a linear chain where every step consumes the previous output.
+ */
+template <typename Graph>
+void make_chain(
+    Graph& graph,
+    size_t length,
+    const char* prefix = "out."
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_name(prefix, 0, 0));
+
+    graph.push_node("command", files_out.begin(), files_out.end());
+
+    for (size_t i = 1; i < length; i++)
+    {
+        files_in.swap(files_out);
+        files_out.assign(1, file_name(prefix, i, 0));
+
+        graph.push_node(files_in.begin(), files_in.end(),
+            "command", files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ * Push a lattice of layers where every step consumes two neighbouring
+ * outputs of the previous layer, so the number of distinct paths to the
+ * first layer grows exponentially with the depth.
+ */
+template <typename Graph>
+void make_lattice(
+    Graph& graph,
+    size_t width,
+    size_t depth,
+    const char* prefix = "out."
+)
+{
+    std::vector<std::string> files_in(2);
+    std::vector<std::string> files_out(1);
+
+    for (size_t i = 0; i < width; i++)
+    {
+        files_out[0] = file_name(prefix, 0, i);
+        graph.push_node("command", files_out.begin(), files_out.end());
+    }
+
+    for (size_t d = 1; d < depth; d++)
+    {
+        for (size_t i = 0; i < width; i++)
+        {
+            files_in[0] = file_name(prefix, d - 1, i);
+            files_in[1] = file_name(prefix, d - 1, (i + 1) % width);
+            files_out[0] = file_name(prefix, d, i);
+
+            graph.push_node(files_in.begin(), files_in.end(),
+                "command", files_out.begin(), files_out.end());
+        }
+    }
+}
+
+/**
+ * Push width independent sources followed by a single step that
+ * consumes all of them.
+ */
+template <typename Graph>
+void make_fan_in(
+    Graph& graph,
+    size_t width,
+    const char* prefix = "out."
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1);
+
+    for (size_t i = 0; i < width; i++)
+    {
+        files_out[0] = file_name(prefix, 0, i);
+        graph.push_node("command", files_out.begin(), files_out.end());
+        files_in.push_back(files_out[0]);
+    }
+
+    files_out[0] = file_name(prefix, 1, 0);
+    graph.push_node(files_in.begin(), files_in.end(), "command",
+        files_out.begin(), files_out.end());
+}
+
+/**
+ * Push a single source followed by width steps that consume it.
+ */
+template <typename Graph>
+void make_fan_out(
+    Graph& graph,
+    size_t width,
+    const char* prefix = "out."
+)
+{
+    std::vector<std::string> files_in(1, file_name(prefix, 0, 0));
+    std::vector<std::string> files_out(1);
+
+    graph.push_node("command", files_in.begin(), files_in.end());
+
+    for (size_t i = 0; i < width; i++)
+    {
+        files_out[0] = file_name(prefix, 1, i);
+        graph.push_node(files_in.begin(), files_in.end(), "command",
+            files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ * Push steps that keep rewriting a small set of files from each other,
+ * restarting from a source every num_files steps, so almost every step
+ * shadows a node that is released once the chain restarts.
+ */
+template <typename Graph>
+void make_churn(
+    Graph& graph,
+    size_t length,
+    size_t num_files = 8,
+    const char* prefix = "out."
+)
+{
+    std::vector<std::string> files_in(1);
+    std::vector<std::string> files_out(1);
+
+    for (size_t i = 0; i < num_files; i++)
+    {
+        files_out[0] = file_name(prefix, 0, i);
+        graph.push_node("command", files_out.begin(), files_out.end());
+    }
+
+    for (size_t i = num_files; i < length; i++)
+    {
+        files_in[0] = file_name(prefix, 0, (i + 1) % num_files);
+        files_out[0] = file_name(prefix, 0, i % num_files);
+
+        if (i % num_files == 0)
+            graph.push_node("command", files_out.begin(), files_out.end());
+        else
+            graph.push_node(files_in.begin(), files_in.end(), "command",
+                files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ * Prefix of depth directories shared by every file, to stress the
+ * hashing and comparison of long paths.
+ */
+inline std::string deep_prefix(
+    size_t depth
+)
+{
+    std::string prefix;
+
+    for (size_t i = 0; i < depth; i++)
+        prefix += "build/subdirectory/";
+
+    return prefix + "out.";
+}
+
+}
+}
@@ -0,0 +1,708 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "graph_policies.hpp"
+#include "snapshot.hpp"
+#include "string_ref.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+namespace detail {
+
+struct branch_step
+{
+    std::string command;
+    std::vector<boost::uint32_t> nodes_in;
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out;
+};
+
+/**
+ * Nodes pushed to a branch between two forks. Once a fork freezes a
+ * layer it is never modified again, so it can be shared by any number
+ * of branches and threads.
+ */
+struct branch_layer
+{
+    boost::shared_ptr<const branch_layer> parent;
+    boost::uint32_t first;
+    std::vector<branch_step> steps;
+    boost::unordered_map<std::string, boost::uint32_t> bindings;
+
+    branch_layer(
+    ) :
+        parent(),
+        first(0),
+        steps(),
+        bindings()
+    {
+    }
+
+    void swap(
+        branch_layer& other
+    )
+    {
+        parent.swap(other.parent);
+        std::swap(first, other.first);
+        steps.swap(other.steps);
+        bindings.swap(other.bindings);
+    }
+};
+
+}
+
+class hist_branch;
+class hist_branch_inputs;
+class hist_branch_outputs;
+
+class hist_branch_node
+{
+private:
+
+    const hist_branch* _branch;
+    boost::uint32_t _index;
+
+public:
+
+    hist_branch_node(
+        const hist_branch* branch,
+        boost::uint32_t index
+    ) :
+        _branch(branch),
+        _index(index)
+    {
+    }
+
+    const hist_branch_node* operator ->(
+    ) const
+    {
+        return this;
+    }
+
+    boost::uint32_t index(
+    ) const
+    {
+        return _index;
+    }
+
+    /**
+     * Nodes pushed to the branch continue the numbering of the base,
+     * in 64 bits so it cannot overflow for any Id policy of the graph.
+     */
+    inline uuid64::type uuid(
+    ) const;
+
+    inline hist_branch_inputs nodes_in(
+    ) const;
+
+    inline hist_branch_outputs files_out(
+    ) const;
+
+    inline string_ref command(
+    ) const;
+};
+
+class hist_branch_input
+{
+private:
+
+    const hist_branch* _branch;
+    boost::uint32_t _index;
+    size_t _edge;
+
+public:
+
+    hist_branch_input(
+        const hist_branch* branch,
+        boost::uint32_t index,
+        size_t edge
+    ) :
+        _branch(branch),
+        _index(index),
+        _edge(edge)
+    {
+    }
+
+    inline hist_branch_node node(
+    ) const;
+
+    inline string_ref file(
+    ) const;
+};
+
+class hist_branch_inputs
+{
+private:
+
+    const hist_branch* _branch;
+    boost::uint32_t _index;
+
+public:
+
+    hist_branch_inputs(
+        const hist_branch* branch,
+        boost::uint32_t index
+    ) :
+        _branch(branch),
+        _index(index)
+    {
+    }
+
+    inline size_t size(
+    ) const;
+
+    hist_branch_input operator [](
+        size_t i
+    ) const
+    {
+        return hist_branch_input(_branch, _index, i);
+    }
+};
+
+class hist_branch_outputs
+{
+private:
+
+    const hist_branch* _branch;
+    boost::uint32_t _index;
+
+public:
+
+    hist_branch_outputs(
+        const hist_branch* branch,
+        boost::uint32_t index
+    ) :
+        _branch(branch),
+        _index(index)
+    {
+    }
+
+    inline size_t size(
+    ) const;
+
+    inline string_ref operator [](
+        size_t i
+    ) const;
+};
+
+/**
+ * Copy-on-write branch of a graph. The nodes of the graph stay in an
+ * immutable CSR view shared by every branch, and the nodes pushed to a
+ * branch go to a layer of its own. fork() freezes that layer and hands
+ * it to both the branch and the new fork, so forking costs the same
+ * regardless of the size of the graph and nothing is copied when either
+ * side is modified afterwards.
+ *
+ * Node indices continue the indices of the view, so a node keeps its
+ * index in every fork. Lookups walk the layers from the newest one. A
+ * fork merges the layers of similar size, so a chain of nested forks
+ * keeps O(log n) layers and copies each node O(log n) times.
+ *
+ * A branch is not thread-safe, but distinct branches sharing layers can
+ * be used by different threads.
+ */
+class hist_branch
+{
+    friend class hist_branch_node;
+    friend class hist_branch_input;
+    friend class hist_branch_inputs;
+    friend class hist_branch_outputs;
+
+private:
+
+    boost::shared_ptr<const hist_csr_view> _base;
+    boost::uint32_t _base_nodes;
+    uuid64::type _first_uuid;
+    boost::shared_ptr<const detail::branch_layer> _frozen;
+    detail::branch_layer _delta;
+
+    const detail::branch_step* step(
+        boost::uint32_t index
+    ) const
+    {
+        if (index < _base_nodes)
+            return 0;
+
+        if (index >= _delta.first)
+            return &_delta.steps[index - _delta.first];
+
+        const detail::branch_layer* layer = _frozen.get();
+
+        while (index < layer->first)
+            layer = layer->parent.get();
+
+        return &layer->steps[index - layer->first];
+    }
+
+    static size_t level(
+        size_t size
+    )
+    {
+        size_t level = 0;
+
+        while (size > 1)
+        {
+            size >>= 1;
+            level++;
+        }
+
+        return level;
+    }
+
+    void merge_layers(
+    )
+    {
+        // Merges the newest frozen layer with its parents while they are
+        // not larger in powers of two, like a carry in a binary counter.
+        // A step moving to a merged layer at least doubles the size of
+        // its layer, so it is copied O(log n) times and the layers get
+        // larger towards the root, which bounds the depth to O(log n)
+
+        size_t size = _frozen->steps.size();
+        const detail::branch_layer* parent = _frozen->parent.get();
+
+        std::vector<const detail::branch_layer*> chain(1, _frozen.get());
+
+        while (parent != 0 && level(parent->steps.size()) <= level(size))
+        {
+            size += parent->steps.size();
+            chain.push_back(parent);
+            parent = parent->parent.get();
+        }
+
+        if (chain.size() == 1)
+            return;
+
+        boost::shared_ptr<detail::branch_layer> merged(
+            new detail::branch_layer());
+
+        merged->parent = chain.back()->parent;
+        merged->first = chain.back()->first;
+        merged->steps.reserve(size);
+
+        // Oldest layer first, so the newest binding of each path wins
+
+        for (size_t i = chain.size(); i > 0; i--)
+        {
+            const detail::branch_layer& layer = *chain[i - 1];
+
+            merged->steps.insert(merged->steps.end(), layer.steps.begin(),
+                layer.steps.end());
+
+            for (boost::unordered_map<std::string, boost::uint32_t>::
+                const_iterator it = layer.bindings.begin();
+                it != layer.bindings.end(); it++)
+                merged->bindings[it->first] = it->second;
+        }
+
+        _frozen = merged;
+    }
+
+public:
+
+    /**
+     * The view must not be null, and must outlive every branch forked
+     * from this one, which the shared pointer takes care of.
+     */
+    explicit hist_branch(
+        const boost::shared_ptr<const hist_csr_view>& base
+    ) :
+        _base(base),
+        _base_nodes(0),
+        _first_uuid(0),
+        _frozen(),
+        _delta()
+    {
+        if (_base.get() == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("base"));
+        }
+
+        _base_nodes = static_cast<boost::uint32_t>(_base->num_nodes());
+
+        if (_base_nodes != 0)
+            _first_uuid = _base->node(_base_nodes - 1).uuid() + 1;
+
+        _delta.first = _base_nodes;
+    }
+
+    /**
+     * Freezes the pending nodes of this branch and returns a branch
+     * that shares them.
+     */
+    hist_branch fork(
+    )
+    {
+        if (!_delta.steps.empty())
+        {
+            const boost::uint32_t first = static_cast<boost::uint32_t>(
+                num_nodes());
+
+            boost::shared_ptr<detail::branch_layer> layer(
+                new detail::branch_layer());
+
+            layer->swap(_delta);
+
+            _frozen = layer;
+
+            merge_layers();
+
+            _delta.parent = _frozen;
+            _delta.first = first;
+        }
+
+        return *this;
+    }
+
+    template <typename ITF, typename ITO>
+    hist_branch_node push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        detail::branch_step next;
+        next.command = command;
+
+        for (ITF file_it = files_in_begin; file_it != files_in_end;
+            file_it++)
+        {
+            const std::string& file = *file_it;
+
+            if (file.empty())
+            {
+                EX3_THROW(empty_input_value_exception()
+                    << argument_name("file"));
+            }
+
+            const boost::uint32_t index = binding(file);
+
+            if (index == invalid_csr_index)
+            {
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            next.nodes_in.push_back(index);
+            next.files_in.push_back(file);
+        }
+
+        next.files_out.assign(files_out_begin, files_out_end);
+
+        if (next.files_out.empty())
+        {
+            EX3_THROW(empty_output_exception());
+        }
+
+        const boost::uint32_t index = static_cast<boost::uint32_t>(
+            num_nodes());
+
+        _delta.steps.push_back(next);
+
+        for (size_t i = 0; i < next.files_out.size(); i++)
+            _delta.bindings[next.files_out[i]] = index;
+
+        return hist_branch_node(this, index);
+    }
+
+    template <typename ITO>
+    hist_branch_node push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        const std::string* none = 0;
+
+        return push_node(none, none, command, files_out_begin,
+            files_out_end);
+    }
+
+    /**
+     * Index of the node bound to the file, or invalid_csr_index.
+     */
+    boost::uint32_t binding(
+        const std::string& file
+    ) const
+    {
+        boost::unordered_map<std::string, boost::uint32_t>::const_iterator
+            it = _delta.bindings.find(file);
+
+        if (it != _delta.bindings.end())
+            return it->second;
+
+        for (const detail::branch_layer* layer = _frozen.get(); layer != 0;
+            layer = layer->parent.get())
+        {
+            it = layer->bindings.find(file);
+
+            if (it != layer->bindings.end())
+                return it->second;
+        }
+
+        return _base->binding(file);
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        return binding(file) != invalid_csr_index;
+    }
+
+    hist_branch_node node(
+        size_t index
+    ) const
+    {
+        return hist_branch_node(this, static_cast<boost::uint32_t>(index));
+    }
+
+    /**
+     * Number of nodes of the view and of every layer, including the
+     * ones no longer reachable from a binding.
+     */
+    size_t num_nodes(
+    ) const
+    {
+        return _delta.first + _delta.steps.size();
+    }
+
+    const hist_csr_view& base(
+    ) const
+    {
+        return *_base;
+    }
+
+    template <typename ITF, typename ITN>
+    bool track(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing
+    ) const
+    {
+        bool found_all = true;
+
+        std::vector<bool> visited(num_nodes(), false);
+        std::vector<boost::uint32_t> pending;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const boost::uint32_t index = binding(file);
+
+            if (index == invalid_csr_index)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            if (visited[index])
+                continue;
+
+            visited[index] = true;
+            pending.push_back(index);
+
+            while (!pending.empty())
+            {
+                const hist_branch_inputs inputs = node(pending.back()).
+                    nodes_in();
+
+                pending.pop_back();
+
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    const boost::uint32_t input = inputs[i].node().index();
+
+                    if (!visited[input])
+                    {
+                        visited[input] = true;
+                        pending.push_back(input);
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < visited.size(); i++)
+        {
+            if (visited[i])
+            {
+                *nodes_out = node(i);
+                nodes_out++;
+            }
+        }
+
+        return found_all;
+    }
+
+    /**
+     * Prints the nodes still reachable from a binding in index order,
+     * which is what the graph would print after pushing the same nodes.
+     */
+    template <typename Printer>
+    void print(
+        Printer& printer
+    ) const
+    {
+        // Newest bindings first, so a path rebound by a layer hides the
+        // bindings of older layers and of the view
+
+        boost::unordered_map<std::string, boost::uint32_t> bindings(
+            _delta.bindings);
+
+        for (const detail::branch_layer* layer = _frozen.get(); layer != 0;
+            layer = layer->parent.get())
+            bindings.insert(layer->bindings.begin(), layer->bindings.end());
+
+        std::vector<std::string> files;
+
+        for (size_t id = 0; id < _base->num_paths(); id++)
+        {
+            const std::string file = _base->path(
+                static_cast<path_id>(id)).str();
+
+            if (bindings.count(file) == 0)
+                files.push_back(file);
+        }
+
+        for (boost::unordered_map<std::string, boost::uint32_t>::
+            const_iterator it = bindings.begin(); it != bindings.end(); it++)
+            files.push_back(it->first);
+
+        std::vector<hist_branch_node> nodes;
+        track(files.begin(), files.end(), std::back_inserter(nodes), true);
+
+        for (size_t i = 0; i < nodes.size(); i++)
+            printer(nodes[i]);
+    }
+};
+
+inline uuid64::type hist_branch_node::uuid(
+) const
+{
+    if (_index < _branch->_base_nodes)
+        return _branch->_base->node(_index).uuid();
+
+    return _branch->_first_uuid +
+        static_cast<uuid64::type>(_index - _branch->_base_nodes);
+}
+
+inline hist_branch_inputs hist_branch_node::nodes_in(
+) const
+{
+    return hist_branch_inputs(_branch, _index);
+}
+
+inline hist_branch_outputs hist_branch_node::files_out(
+) const
+{
+    return hist_branch_outputs(_branch, _index);
+}
+
+inline string_ref hist_branch_node::command(
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return _branch->_base->node(_index).command();
+
+    return string_ref(step->command);
+}
+
+inline hist_branch_node hist_branch_input::node(
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return hist_branch_node(_branch, _branch->_base->node(_index).
+            nodes_in()[_edge].node().index());
+
+    return hist_branch_node(_branch, step->nodes_in[_edge]);
+}
+
+inline string_ref hist_branch_input::file(
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return _branch->_base->node(_index).nodes_in()[_edge].file();
+
+    return string_ref(step->files_in[_edge]);
+}
+
+inline size_t hist_branch_inputs::size(
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return _branch->_base->node(_index).nodes_in().size();
+
+    return step->nodes_in.size();
+}
+
+inline size_t hist_branch_outputs::size(
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return _branch->_base->node(_index).files_out().size();
+
+    return step->files_out.size();
+}
+
+inline string_ref hist_branch_outputs::operator [](
+    size_t i
+) const
+{
+    const detail::branch_step* step = _branch->step(_index);
+
+    if (step == 0)
+        return _branch->_base->node(_index).files_out()[i];
+
+    return string_ref(step->files_out[i]);
+}
+
+}
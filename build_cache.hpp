@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "historian.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Memoization layer over a graph. Steps are recorded by their Merkle
+ * key and a lookup returns the node that already produced the step's
+ * outputs, as long as those outputs are still bound to a node with the
+ * same key, so a driver can skip re-running the command. Entries whose
+ * outputs were rebound are dropped by the lookup that finds them.
+ */
+template <typename Graph>
+class build_cache
+{
+private:
+
+    typedef typename Graph::node_type node_type;
+    typedef std::vector<std::string> file_vector;
+    typedef boost::unordered_map<boost::uint64_t, file_vector> entry_map;
+
+    static const boost::uint32_t current_version = 1;
+    static const boost::uint32_t byte_order_mark = 0x01020304;
+
+    Graph* _graph;
+    entry_map _entries;
+    size_t _hits;
+    size_t _misses;
+
+    static const char* magic_value(
+    )
+    {
+        return "H1STBCH";
+    }
+
+    /**
+     * Return the single node the outputs are still bound to, or null if
+     * any of them was rebound to another node or to a different key.
+     */
+    const node_type* bound_node(
+        boost::uint64_t key,
+        const file_vector& files_out
+    ) const
+    {
+        const node_type* node = 0;
+
+        for (size_t i = 0; i < files_out.size(); i++)
+        {
+            const path_id id = _graph->paths().find(files_out[i]);
+
+            if (id == invalid_path_id)
+                return 0;
+
+            const node_type* bound = _graph->binding(id);
+
+            if (bound == 0 || bound->key() != key ||
+                (node != 0 && bound != node))
+                return 0;
+
+            node = bound;
+        }
+
+        return node;
+    }
+
+    /**
+     * The node must have run the same command on the current producers
+     * of the inputs, so a collision of the keys is a miss.
+     */
+    template <typename ITF>
+    bool same_step(
+        const node_type* node,
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command
+    ) const
+    {
+        if (!(node->command() == command))
+            return false;
+
+        size_t i = 0;
+
+        for (ITF file_it = files_in_begin; file_it != files_in_end;
+            file_it++, i++)
+        {
+            const std::string& file = *file_it;
+
+            if (i == node->nodes_in().size())
+                return false;
+
+            const path_id id = _graph->paths().find(file);
+
+            if (id == invalid_path_id ||
+                node->nodes_in()[i].file_id() != id ||
+                node->nodes_in()[i].node() != _graph->binding(id))
+                return false;
+        }
+
+        return i == node->nodes_in().size();
+    }
+
+    template <typename T>
+    static void put(
+        std::ostream& stream,
+        const T& value
+    )
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void get(
+        std::istream& stream,
+        T& value,
+        const std::string& file
+    )
+    {
+        if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T)))
+        {
+            EX3_THROW(invalid_format_exception()
+                << file_name(file));
+        }
+    }
+
+public:
+
+    build_cache(
+        Graph& graph
+    ) :
+        _graph(&graph),
+        _entries(),
+        _hits(0),
+        _misses(0)
+    {
+    }
+
+    /**
+     * Return the node that already ran this command on the current
+     * producers of the inputs, or null if the step has to run. The
+     * inputs must be bound.
+     */
+    template <typename ITF>
+    const node_type* lookup(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command
+    )
+    {
+        const boost::uint64_t key = _graph->step_key(files_in_begin,
+            files_in_end, command);
+
+        typename entry_map::iterator entry = _entries.find(key);
+
+        if (entry != _entries.end())
+        {
+            const node_type* node = bound_node(key, entry->second);
+
+            if (node == 0)
+            {
+                // The outputs are no longer bound to this key, so the
+                // entry can never hit again
+
+                _entries.erase(entry);
+            }
+            else if (same_step(node, files_in_begin, files_in_end, command))
+            {
+                _hits++;
+                return node;
+            }
+        }
+
+        _misses++;
+        return 0;
+    }
+
+    const node_type* lookup(
+        const std::string& command
+    )
+    {
+        const std::string* none = 0;
+        return lookup(none, none, command);
+    }
+
+    template <typename ITF, typename ITO>
+    const node_type* push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        const node_type* node = _graph->push_node(files_in_begin,
+            files_in_end, command, files_out_begin, files_out_end);
+
+        record(node);
+        return node;
+    }
+
+    template <typename ITO>
+    const node_type* push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        const node_type* node = _graph->push_node(command,
+            files_out_begin, files_out_end);
+
+        record(node);
+        return node;
+    }
+
+    /**
+     * Remember a node pushed to the graph directly.
+     */
+    void record(
+        const node_type* node
+    )
+    {
+        if (node == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("node"));
+        }
+
+        file_vector& files_out = _entries[node->key()];
+        files_out.clear();
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            files_out.push_back(node->files_out()[i].str());
+    }
+
+    size_t size(
+    ) const
+    {
+        return _entries.size();
+    }
+
+    size_t hits(
+    ) const
+    {
+        return _hits;
+    }
+
+    size_t misses(
+    ) const
+    {
+        return _misses;
+    }
+
+    void reset_counters(
+    )
+    {
+        _hits = 0;
+        _misses = 0;
+    }
+
+    /**
+     * Write the entries to a file, replacing it only once the new
+     * contents are complete.
+     */
+    void save(
+        const std::string& file
+    ) const
+    {
+        const std::string tmp = file + ".tmp";
+
+        std::ofstream stream(tmp.c_str(), std::ios::out |
+            std::ios::binary | std::ios::trunc);
+
+        char magic[8];
+        std::memcpy(magic, magic_value(), 8);
+
+        const boost::uint32_t version = current_version;
+        const boost::uint32_t byte_order = byte_order_mark;
+
+        stream.write(magic, 8);
+        put(stream, version);
+        put(stream, byte_order);
+        put(stream, static_cast<boost::uint64_t>(_entries.size()));
+
+        for (typename entry_map::const_iterator it = _entries.begin();
+            it != _entries.end(); it++)
+        {
+            put(stream, it->first);
+            put(stream, static_cast<boost::uint32_t>(it->second.size()));
+
+            for (size_t i = 0; i < it->second.size(); i++)
+            {
+                const std::string& path = it->second[i];
+
+                put(stream, static_cast<boost::uint32_t>(path.size()));
+                stream.write(path.data(),
+                    static_cast<std::streamsize>(path.size()));
+            }
+        }
+
+        stream.close();
+
+        if (!stream || std::rename(tmp.c_str(), file.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+
+            EX3_THROW(io_exception()
+                << file_name(file));
+        }
+    }
+
+    /**
+     * Add the entries of a file written by save. Entries whose outputs
+     * are no longer bound are kept until a lookup finds them.
+     */
+    void load(
+        const std::string& file
+    )
+    {
+        std::ifstream stream(file.c_str(), std::ios::in | std::ios::binary);
+
+        if (!stream)
+        {
+            EX3_THROW(io_exception()
+                << file_name(file));
+        }
+
+        char magic[8];
+        boost::uint32_t version = 0;
+        boost::uint32_t byte_order = 0;
+        boost::uint64_t num_entries = 0;
+
+        if (!stream.read(magic, 8) ||
+            std::memcmp(magic, magic_value(), 8) != 0)
+        {
+            EX3_THROW(invalid_format_exception()
+                << file_name(file));
+        }
+
+        get(stream, version, file);
+        get(stream, byte_order, file);
+        get(stream, num_entries, file);
+
+        if (version != current_version || byte_order != byte_order_mark)
+        {
+            EX3_THROW(invalid_format_exception()
+                << file_name(file));
+        }
+
+        entry_map entries;
+        std::string path;
+
+        for (boost::uint64_t i = 0; i < num_entries; i++)
+        {
+            boost::uint64_t key = 0;
+            boost::uint32_t num_files = 0;
+
+            get(stream, key, file);
+            get(stream, num_files, file);
+
+            file_vector& files_out = entries[key];
+
+            for (boost::uint32_t j = 0; j < num_files; j++)
+            {
+                boost::uint32_t size = 0;
+                get(stream, size, file);
+
+                path.resize(size);
+
+                if (size != 0 && !stream.read(&path[0], size))
+                {
+                    EX3_THROW(invalid_format_exception()
+                        << file_name(file));
+                }
+
+                files_out.push_back(path);
+            }
+        }
+
+        for (typename entry_map::iterator it = entries.begin();
+            it != entries.end(); it++)
+            _entries[it->first].swap(it->second);
+    }
+
+private:
+
+    build_cache(
+        const build_cache&
+    );
+
+    build_cache& operator =(
+        const build_cache&
+    );
+};
+
+}
@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "node_arena.hpp"
+#include "path_table.hpp"
+#include "string_ref.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Header of an interned command. It is followed in the same block by
+ * the command bytes or, for tokenized commands, by pointers to the
+ * tokens whose concatenation is the command.
+ */
+struct command_entry
+{
+    size_t refs;
+    boost::uint64_t hash;
+    boost::uint32_t size;
+    boost::uint32_t num_tokens;
+
+    const char* bytes(
+    ) const
+    {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+
+    const std::string* const* tokens(
+    ) const
+    {
+        return reinterpret_cast<const std::string* const*>(this + 1);
+    }
+};
+
+/**
+ * Read-only view of an interned command. Tokenized commands are not
+ * contiguous, so the view exposes them as a sequence of chunks and a
+ * character iterator instead of a data pointer.
+ */
+class command_ref
+{
+private:
+
+    const command_entry* _entry;
+
+public:
+
+    class const_iterator
+    {
+    private:
+
+        const char* _p;
+        const char* _chunk_end;
+        const std::string* const* _next;
+        const std::string* const* _last;
+
+    public:
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef char value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const char* pointer;
+        typedef const char& reference;
+
+        const_iterator(
+            const char* p,
+            const char* chunk_end,
+            const std::string* const* next,
+            const std::string* const* last
+        ) :
+            _p(p),
+            _chunk_end(chunk_end),
+            _next(next),
+            _last(last)
+        {
+        }
+
+        reference operator *(
+        ) const
+        {
+            return *_p;
+        }
+
+        const_iterator& operator ++(
+        )
+        {
+            if (++_p == _chunk_end && _next != _last)
+            {
+                _p = (*_next)->data();
+                _chunk_end = _p + (*_next)->size();
+                _next++;
+            }
+
+            return *this;
+        }
+
+        const_iterator operator ++(
+            int
+        )
+        {
+            const_iterator it(*this);
+            ++(*this);
+            return it;
+        }
+
+        bool operator ==(
+            const const_iterator& other
+        ) const
+        {
+            return _p == other._p && _next == other._next;
+        }
+
+        bool operator !=(
+            const const_iterator& other
+        ) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    command_ref(
+        const command_entry* entry = 0
+    ) :
+        _entry(entry)
+    {
+    }
+
+    size_t size(
+    ) const
+    {
+        return _entry == 0 ? 0 : _entry->size;
+    }
+
+    bool empty(
+    ) const
+    {
+        return size() == 0;
+    }
+
+    size_t num_chunks(
+    ) const
+    {
+        if (empty())
+            return 0;
+
+        return _entry->num_tokens == 0 ? 1 : _entry->num_tokens;
+    }
+
+    string_ref chunk(
+        size_t i
+    ) const
+    {
+        if (_entry->num_tokens == 0)
+            return string_ref(_entry->bytes(), _entry->size);
+
+        return string_ref(*_entry->tokens()[i]);
+    }
+
+    const_iterator begin(
+    ) const
+    {
+        if (empty())
+            return const_iterator(0, 0, 0, 0);
+
+        if (_entry->num_tokens == 0)
+            return const_iterator(_entry->bytes(),
+                _entry->bytes() + _entry->size, 0, 0);
+
+        const std::string* const* tokens = _entry->tokens();
+
+        return const_iterator(tokens[0]->data(),
+            tokens[0]->data() + tokens[0]->size(), tokens + 1,
+            tokens + _entry->num_tokens);
+    }
+
+    const_iterator end(
+    ) const
+    {
+        if (empty())
+            return const_iterator(0, 0, 0, 0);
+
+        if (_entry->num_tokens == 0)
+            return const_iterator(_entry->bytes() + _entry->size,
+                _entry->bytes() + _entry->size, 0, 0);
+
+        const std::string* const* last = _entry->tokens() +
+            _entry->num_tokens;
+        const std::string* token = *(last - 1);
+
+        return const_iterator(token->data() + token->size(),
+            token->data() + token->size(), last, last);
+    }
+
+    std::string str(
+    ) const
+    {
+        std::string result;
+        result.reserve(size());
+
+        for (size_t i = 0; i < num_chunks(); i++)
+            result.append(chunk(i).data(), chunk(i).size());
+
+        return result;
+    }
+
+    /**
+     * Same value as path_table::hash of the full command.
+     */
+    boost::uint64_t hash(
+    ) const
+    {
+        return _entry == 0 ? path_table::hash("", 0) : _entry->hash;
+    }
+
+    int compare(
+        const string_ref& other
+    ) const
+    {
+        size_t offset = 0;
+
+        for (size_t i = 0; i < num_chunks(); i++)
+        {
+            const string_ref part = chunk(i);
+            const size_t n = std::min(part.size(), other.size() - offset);
+
+            const int c = std::memcmp(part.data(), other.data() + offset, n);
+
+            if (c != 0)
+                return c;
+
+            if (n < part.size())
+                return 1;
+
+            offset += n;
+        }
+
+        return offset < other.size() ? -1 : 0;
+    }
+
+    const command_entry* entry(
+    ) const
+    {
+        return _entry;
+    }
+};
+
+inline bool operator ==(
+    const command_ref& a,
+    const string_ref& b
+)
+{
+    return a.size() == b.size() && a.compare(b) == 0;
+}
+
+inline bool operator ==(
+    const string_ref& a,
+    const command_ref& b
+)
+{
+    return b == a;
+}
+
+inline bool operator ==(
+    const command_ref& a,
+    const command_ref& b
+)
+{
+    // Commands interned by the same store are equal only if they share
+    // the entry, but views from different stores have to be compared
+
+    return a.entry() == b.entry() || (a.size() == b.size() &&
+        std::equal(a.begin(), a.end(), b.begin()));
+}
+
+inline bool operator !=(
+    const command_ref& a,
+    const string_ref& b
+)
+{
+    return !(a == b);
+}
+
+inline bool operator !=(
+    const string_ref& a,
+    const command_ref& b
+)
+{
+    return !(b == a);
+}
+
+inline bool operator !=(
+    const command_ref& a,
+    const command_ref& b
+)
+{
+    return !(a == b);
+}
+
+inline std::ostream& operator <<(
+    std::ostream& stream,
+    const command_ref& command
+)
+{
+    for (size_t i = 0; i < command.num_chunks(); i++)
+        stream << command.chunk(i);
+
+    return stream;
+}
+
+/**
+ * Reference counted set of the commands of a graph, each distinct
+ * command is stored once and nodes keep a pointer to its entry. With
+ * encoding_tokenized the commands are split after every space and the
+ * tokens are interned in a dictionary shared by all commands, so
+ * commands built from the same template only store one pointer per
+ * token. Tokens are kept until the store is destroyed.
+ */
+class command_store
+{
+public:
+
+    enum encoding
+    {
+        encoding_plain,
+        encoding_tokenized
+    };
+
+private:
+
+    encoding _encoding;
+    node_arena _arena;
+    path_table _tokens;
+    std::vector<command_entry*> _slots;
+    size_t _size;
+
+    static size_t entry_size(
+        const command_entry* entry
+    )
+    {
+        if (entry->num_tokens == 0)
+            return sizeof(command_entry) + entry->size;
+
+        return sizeof(command_entry) +
+            entry->num_tokens * sizeof(const std::string*);
+    }
+
+    size_t find_slot(
+        const string_ref& command,
+        boost::uint64_t hash
+    ) const
+    {
+        const size_t mask = _slots.size() - 1;
+
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            const command_entry* entry = _slots[i];
+
+            if (entry == 0 || (entry->hash == hash &&
+                command_ref(entry) == command))
+                return i;
+        }
+    }
+
+    void grow(
+    )
+    {
+        std::vector<command_entry*> slots(2 * _slots.size(),
+            static_cast<command_entry*>(0));
+        const size_t mask = slots.size() - 1;
+
+        for (size_t i = 0; i < _slots.size(); i++)
+        {
+            if (_slots[i] == 0)
+                continue;
+
+            size_t j = static_cast<size_t>(_slots[i]->hash) & mask;
+
+            while (slots[j] != 0)
+                j = (j + 1) & mask;
+
+            slots[j] = _slots[i];
+        }
+
+        _slots.swap(slots);
+    }
+
+    command_entry* create(
+        const string_ref& command,
+        boost::uint64_t hash
+    )
+    {
+        std::vector<const std::string*> tokens;
+
+        if (_encoding == encoding_tokenized)
+        {
+            const char* begin = command.begin();
+
+            while (begin != command.end())
+            {
+                const char* end = std::find(begin, command.end(), ' ');
+
+                if (end != command.end())
+                    end++;
+
+                tokens.push_back(&_tokens.str(_tokens.intern(
+                    std::string(begin, end))));
+
+                begin = end;
+            }
+        }
+
+        const size_t size = sizeof(command_entry) + (tokens.empty() ?
+            command.size() : tokens.size() * sizeof(const std::string*));
+
+        command_entry* entry = static_cast<command_entry*>(
+            _arena.allocate(size));
+
+        entry->refs = 0;
+        entry->hash = hash;
+        entry->size = static_cast<boost::uint32_t>(command.size());
+        entry->num_tokens = static_cast<boost::uint32_t>(tokens.size());
+
+        if (tokens.empty())
+            std::memcpy(const_cast<char*>(entry->bytes()), command.data(),
+                command.size());
+        else
+            std::copy(tokens.begin(), tokens.end(),
+                const_cast<const std::string**>(entry->tokens()));
+
+        return entry;
+    }
+
+    void erase_slot(
+        size_t i
+    )
+    {
+        // Backward shift deletion keeps the probe sequences intact
+        // without tombstones
+
+        const size_t mask = _slots.size() - 1;
+
+        _slots[i] = 0;
+
+        for (size_t j = (i + 1) & mask; _slots[j] != 0; j = (j + 1) & mask)
+        {
+            const size_t home = static_cast<size_t>(_slots[j]->hash) & mask;
+
+            // Move the entry if its home is not cyclically in (i, j]
+
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+                _slots[i] = _slots[j];
+                _slots[j] = 0;
+                i = j;
+            }
+        }
+    }
+
+public:
+
+    command_store(
+        encoding enc = encoding_plain
+    ) :
+        _encoding(enc),
+        _arena(),
+        _tokens(),
+        _slots(16, static_cast<command_entry*>(0)),
+        _size(0)
+    {
+    }
+
+    /**
+     * Return the entry of the command, creating it if needed, and take
+     * a reference to it.
+     */
+    const command_entry* acquire(
+        const string_ref& command
+    )
+    {
+        const boost::uint64_t hash = path_table::hash(command.data(),
+            command.size());
+
+        size_t i = find_slot(command, hash);
+
+        if (_slots[i] == 0)
+        {
+            if (4 * (_size + 1) > 3 * _slots.size())
+            {
+                grow();
+                i = find_slot(command, hash);
+            }
+
+            _slots[i] = create(command, hash);
+            _size++;
+        }
+
+        _slots[i]->refs++;
+
+        return _slots[i];
+    }
+
+    void release(
+        const command_entry* entry
+    )
+    {
+        command_entry* owned = const_cast<command_entry*>(entry);
+
+        if (--owned->refs != 0)
+            return;
+
+        const size_t mask = _slots.size() - 1;
+        size_t i = static_cast<size_t>(entry->hash) & mask;
+
+        while (_slots[i] != entry)
+            i = (i + 1) & mask;
+
+        erase_slot(i);
+        _size--;
+
+        _arena.deallocate(owned, entry_size(entry));
+    }
+
+    encoding get_encoding(
+    ) const
+    {
+        return _encoding;
+    }
+
+    /**
+     * Number of distinct commands.
+     */
+    size_t size(
+    ) const
+    {
+        return _size;
+    }
+
+    size_t num_tokens(
+    ) const
+    {
+        return _tokens.size();
+    }
+
+    size_t bytes_used(
+    ) const
+    {
+        return _arena.bytes_used() +
+            _slots.size() * sizeof(command_entry*);
+    }
+
+private:
+
+    command_store(
+        const command_store&
+    );
+
+    command_store& operator =(
+        const command_store&
+    );
+};
+
+}
@@ -0,0 +1,767 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "array_ref.hpp"
+#include "command_store.hpp"
+#include "node_arena.hpp"
+#include "path_table.hpp"
+#include "epoch_domain.hpp"
+#include "threading.hpp"
+#include "historian.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+class concurrent_node;
+
+typedef basic_node_input<concurrent_node> concurrent_node_input;
+
+/**
+ * Node of a concurrent_hist_graph. Everything but the reference count
+ * is immutable once the node is published, the uuid is the push
+ * sequence number and is never renumbered. The command is interned in
+ * the graph's command_store.
+ */
+class concurrent_node
+{
+public:
+
+    typedef array_ref<concurrent_node_input> nodes_in_array;
+    typedef array_ref<path_ref> files_out_array;
+
+private:
+
+    boost::uint64_t _uuid;
+    size_t _refs;
+    nodes_in_array _nodes_in;
+    files_out_array _files_out;
+    command_ref _command;
+
+public:
+
+    concurrent_node(
+        boost::uint64_t uuid,
+        const concurrent_node_input* nodes_in_begin,
+        const concurrent_node_input* nodes_in_end,
+        const command_entry* command,
+        const path_ref* files_out_begin,
+        const path_ref* files_out_end
+    ) :
+        _uuid(uuid),
+        _refs(0),
+        _nodes_in(nodes_in_begin, nodes_in_end),
+        _files_out(files_out_begin, files_out_end),
+        _command(command)
+    {
+    }
+
+    boost::uint64_t uuid(
+    ) const
+    {
+        return _uuid;
+    }
+
+    // Only touched by the writer holding the graph lock
+
+    size_t& refs(
+    )
+    {
+        return _refs;
+    }
+
+    const nodes_in_array& nodes_in(
+    ) const
+    {
+        return _nodes_in;
+    }
+
+    const files_out_array& files_out(
+    ) const
+    {
+        return _files_out;
+    }
+
+    const command_ref& command(
+    ) const
+    {
+        return _command;
+    }
+};
+
+/**
+ * hist_graph variant that can be shared between threads. Writers are
+ * serialized by a mutex while has_input, track and print never block:
+ * the file bindings live in an open addressing index whose slots are
+ * atomic and which is republished as a new version when it grows, and
+ * released nodes and old index versions are reclaimed only after every
+ * reader that could still see them has left its read section.
+ */
+class concurrent_hist_graph
+{
+public:
+
+    typedef concurrent_node node_type;
+
+    /**
+     * Nodes returned by track stay valid while the calling thread holds
+     * a read_section, readers that only test the result do not need one.
+     */
+    class read_section
+    {
+    private:
+
+        epoch_guard _guard;
+
+    public:
+
+        read_section(
+            const concurrent_hist_graph& graph
+        ) :
+            _guard(graph._epochs)
+        {
+        }
+    };
+
+private:
+
+    struct path_entry
+    {
+        boost::uint64_t hash;
+        std::string str;
+        path_id id;
+        boost::atomic<concurrent_node*> binding;
+
+        path_entry(
+            boost::uint64_t hash,
+            const std::string& str,
+            path_id id
+        ) :
+            hash(hash),
+            str(str),
+            id(id),
+            binding(0)
+        {
+        }
+    };
+
+    struct path_index
+    {
+        size_t mask;
+        boost::atomic<path_entry*>* slots;
+
+        path_index(
+            size_t capacity
+        ) :
+            mask(capacity - 1),
+            slots(new boost::atomic<path_entry*>[capacity])
+        {
+            for (size_t i = 0; i < capacity; i++)
+                slots[i].store(0, boost::memory_order_relaxed);
+        }
+
+        ~path_index(
+        )
+        {
+            delete[] slots;
+        }
+    };
+
+    typedef std::pair<epoch_domain::epoch_type, concurrent_node*>
+        retired_node;
+    typedef std::pair<epoch_domain::epoch_type, path_index*>
+        retired_index;
+    typedef boost::unordered_set<const concurrent_node*> node_set;
+
+    static const size_t reclaim_threshold = 64;
+
+    detail::mutex _mutex;
+    mutable epoch_domain _epochs;
+    boost::atomic<path_index*> _index;
+    boost::atomic<boost::uint64_t> _revision;
+    boost::uint64_t _uuid;
+    node_arena _arena;
+    command_store _commands;
+    std::vector<path_entry*> _entries;
+    std::vector<concurrent_node*> _released;
+    std::vector<retired_node> _retired_nodes;
+    std::vector<retired_index> _retired_indexes;
+
+    static size_t node_size(
+        size_t num_nodes_in,
+        size_t num_files_out
+    )
+    {
+        return sizeof(concurrent_node) +
+            num_nodes_in * sizeof(concurrent_node_input) +
+            num_files_out * sizeof(path_ref);
+    }
+
+    static const path_entry* find_entry(
+        const path_index* index,
+        const std::string& file
+    )
+    {
+        const boost::uint64_t hash = path_table::hash(file);
+
+        for (size_t i = static_cast<size_t>(hash) & index->mask; ;
+            i = (i + 1) & index->mask)
+        {
+            const path_entry* entry = index->slots[i].load(
+                boost::memory_order_acquire);
+
+            if (entry == 0)
+                return 0;
+
+            if (entry->hash == hash && entry->str == file)
+                return entry;
+        }
+    }
+
+    static void insert_entry(
+        path_index* index,
+        path_entry* entry
+    )
+    {
+        size_t i = static_cast<size_t>(entry->hash) & index->mask;
+
+        while (index->slots[i].load(boost::memory_order_relaxed) != 0)
+            i = (i + 1) & index->mask;
+
+        index->slots[i].store(entry, boost::memory_order_release);
+    }
+
+    const concurrent_node* lookup(
+        const std::string& file
+    ) const
+    {
+        const path_entry* entry = find_entry(
+            _index.load(boost::memory_order_acquire), file);
+
+        if (entry == 0)
+            return 0;
+
+        return entry->binding.load(boost::memory_order_acquire);
+    }
+
+    path_entry* intern(
+        const std::string& file
+    )
+    {
+        path_index* index = _index.load(boost::memory_order_relaxed);
+        const path_entry* found = find_entry(index, file);
+
+        if (found != 0)
+            return _entries[found->id];
+
+        // Readers keep probing the old index while a larger one is
+        // filled, the old one is retired once the new one is published
+
+        if (4 * (_entries.size() + 1) > 3 * (index->mask + 1))
+        {
+            path_index* grown = new path_index(2 * (index->mask + 1));
+
+            for (size_t i = 0; i < _entries.size(); i++)
+                insert_entry(grown, _entries[i]);
+
+            _index.store(grown, boost::memory_order_release);
+            _retired_indexes.push_back(retired_index(_epochs.retire(),
+                index));
+            index = grown;
+        }
+
+        _entries.reserve(_entries.size() + 1);
+
+        path_entry* entry = new path_entry(path_table::hash(file), file,
+            static_cast<path_id>(_entries.size()));
+
+        _entries.push_back(entry);
+        insert_entry(index, entry);
+
+        return entry;
+    }
+
+    concurrent_node* create_node(
+        const std::vector<concurrent_node_input>& nodes_in,
+        const std::string& command,
+        const std::vector<path_ref>& files_out
+    )
+    {
+        const size_t size = node_size(nodes_in.size(), files_out.size());
+        char* block = static_cast<char*>(_arena.allocate(size));
+
+        concurrent_node_input* nodes_in_begin =
+            reinterpret_cast<concurrent_node_input*>(
+                block + sizeof(concurrent_node));
+        concurrent_node_input* nodes_in_end = std::uninitialized_copy(
+            nodes_in.begin(), nodes_in.end(), nodes_in_begin);
+
+        path_ref* files_out_begin = reinterpret_cast<path_ref*>(
+            nodes_in_end);
+        path_ref* files_out_end = std::uninitialized_copy(
+            files_out.begin(), files_out.end(), files_out_begin);
+
+        const command_entry* entry = 0;
+
+        try
+        {
+            entry = _commands.acquire(command);
+        }
+        catch (...)
+        {
+            _arena.deallocate(block, size);
+            throw;
+        }
+
+        return new (block) concurrent_node(_uuid, nodes_in_begin,
+            nodes_in_end, entry, files_out_begin, files_out_end);
+    }
+
+    void destroy_node(
+        concurrent_node* node
+    )
+    {
+        const size_t size = node_size(node->nodes_in().size(),
+            node->files_out().size());
+
+        // Readers of the node left before it was reclaimed, so its
+        // command can be released under the writer lock
+
+        _commands.release(node->command().entry());
+        node->~concurrent_node();
+        _arena.deallocate(node, size);
+    }
+
+    void release(
+        concurrent_node* node
+    )
+    {
+        // Same cascade as hist_graph::release, but the dead nodes are
+        // only unlinked here and freed by reclaim
+
+        std::vector<concurrent_node*> pending(1, node);
+
+        while (!pending.empty())
+        {
+            concurrent_node* dead = pending.back();
+            pending.pop_back();
+
+            if (--dead->refs() != 0)
+                continue;
+
+            for (size_t i = 0; i < dead->nodes_in().size(); i++)
+                pending.push_back(const_cast<concurrent_node*>(
+                    dead->nodes_in()[i].node()));
+
+            _released.push_back(dead);
+        }
+    }
+
+    const concurrent_node* add_node(
+        concurrent_node* node
+    )
+    {
+        std::vector<concurrent_node*> shadowed;
+
+        _uuid++;
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+            const_cast<concurrent_node*>(
+                node->nodes_in()[i].node())->refs()++;
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+        {
+            path_entry* entry = _entries[node->files_out()[i].id()];
+            concurrent_node* bound = entry->binding.load(
+                boost::memory_order_relaxed);
+
+            node->refs()++;
+
+            if (bound != 0)
+                shadowed.push_back(bound);
+
+            entry->binding.store(node, boost::memory_order_release);
+        }
+
+        for (size_t i = 0; i < shadowed.size(); i++)
+            release(shadowed[i]);
+
+        _revision.fetch_add(1, boost::memory_order_release);
+
+        retire();
+
+        return node;
+    }
+
+    void retire(
+    )
+    {
+        // Everything unlinked by this push shares one epoch tag, the
+        // slots of the readers are only scanned once enough objects
+        // are waiting so the scan is amortized over many pushes
+
+        if (_released.empty())
+            return;
+
+        const epoch_domain::epoch_type tag = _epochs.retire();
+
+        for (size_t i = 0; i < _released.size(); i++)
+            _retired_nodes.push_back(retired_node(tag, _released[i]));
+
+        _released.clear();
+
+        if (_retired_nodes.size() + _retired_indexes.size() >=
+            reclaim_threshold)
+            reclaim_retired();
+    }
+
+    void reclaim_retired(
+    )
+    {
+        const epoch_domain::epoch_type min_epoch = _epochs.min_active();
+
+        // Tags grow along the lists, so the reclaimable objects are
+        // always a prefix
+
+        size_t n = 0;
+
+        while (n < _retired_nodes.size() &&
+            _retired_nodes[n].first < min_epoch)
+            destroy_node(_retired_nodes[n++].second);
+
+        _retired_nodes.erase(_retired_nodes.begin(),
+            _retired_nodes.begin() + static_cast<std::ptrdiff_t>(n));
+
+        n = 0;
+
+        while (n < _retired_indexes.size() &&
+            _retired_indexes[n].first < min_epoch)
+            delete _retired_indexes[n++].second;
+
+        _retired_indexes.erase(_retired_indexes.begin(),
+            _retired_indexes.begin() + static_cast<std::ptrdiff_t>(n));
+    }
+
+    template <typename ITO>
+    void intern_files_out(
+        ITO files_out_begin,
+        ITO files_out_end,
+        std::vector<path_ref>& files_out
+    )
+    {
+        if (files_out_begin == files_out_end)
+        {
+            EX3_THROW(empty_output_exception());
+        }
+
+        for (ITO file_it = files_out_begin; file_it != files_out_end; file_it++)
+        {
+            const path_entry* entry = intern(*file_it);
+            files_out.push_back(path_ref(entry->id, &entry->str));
+        }
+    }
+
+    static void visit(
+        node_set& visited,
+        std::vector<const concurrent_node*>& pending,
+        std::vector<const concurrent_node*>& found,
+        const concurrent_node* node
+    )
+    {
+        // The uuids are sparse, so the visited set is a hash set and
+        // the topological order is recovered by sorting at the end
+
+        if (!visited.insert(node).second)
+            return;
+
+        pending.push_back(node);
+        found.push_back(node);
+
+        while (!pending.empty())
+        {
+            const concurrent_node* next = pending.back();
+            pending.pop_back();
+
+            for (size_t i = 0; i < next->nodes_in().size(); i++)
+            {
+                const concurrent_node* input = next->nodes_in()[i].node();
+
+                if (visited.insert(input).second)
+                {
+                    pending.push_back(input);
+                    found.push_back(input);
+                }
+            }
+        }
+    }
+
+    static bool uuid_less(
+        const concurrent_node* a,
+        const concurrent_node* b
+    )
+    {
+        return a->uuid() < b->uuid();
+    }
+
+    void collect_live(
+        std::vector<const concurrent_node*>& found
+    ) const
+    {
+        const path_index* index = _index.load(boost::memory_order_acquire);
+        node_set visited;
+        std::vector<const concurrent_node*> pending;
+
+        for (size_t i = 0; i <= index->mask; i++)
+        {
+            const path_entry* entry = index->slots[i].load(
+                boost::memory_order_acquire);
+
+            if (entry == 0)
+                continue;
+
+            const concurrent_node* node = entry->binding.load(
+                boost::memory_order_acquire);
+
+            if (node != 0)
+                visit(visited, pending, found, node);
+        }
+
+        std::sort(found.begin(), found.end(), uuid_less);
+    }
+
+public:
+
+    concurrent_hist_graph(
+        size_t max_readers = 256
+    ) :
+        _mutex(),
+        _epochs(max_readers),
+        _index(new path_index(16)),
+        _revision(0),
+        _uuid(0),
+        _arena(),
+        _commands(),
+        _entries(),
+        _released(),
+        _retired_nodes(),
+        _retired_indexes()
+    {
+    }
+
+    template <typename ITF, typename ITO>
+    const concurrent_node* push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        detail::scoped_lock lock(_mutex);
+
+        std::vector<concurrent_node_input> nodes_in;
+
+        for (ITF file_it = files_in_begin; file_it != files_in_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const path_entry* entry = find_entry(
+                _index.load(boost::memory_order_relaxed), file);
+
+            if (entry == 0 || entry->binding.load(
+                boost::memory_order_relaxed) == 0)
+            {
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            nodes_in.push_back(concurrent_node_input(
+                entry->binding.load(boost::memory_order_relaxed),
+                path_ref(entry->id, &entry->str)));
+        }
+
+        std::vector<path_ref> files_out;
+        intern_files_out(files_out_begin, files_out_end, files_out);
+
+        return add_node(create_node(nodes_in, command, files_out));
+    }
+
+    template <typename ITO>
+    const concurrent_node* push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        detail::scoped_lock lock(_mutex);
+
+        std::vector<path_ref> files_out;
+        intern_files_out(files_out_begin, files_out_end, files_out);
+
+        return add_node(create_node(std::vector<concurrent_node_input>(),
+            command, files_out));
+    }
+
+    template <typename Printer>
+    void print(
+        Printer& printer
+    ) const
+    {
+        epoch_guard guard(_epochs);
+
+        std::vector<const concurrent_node*> found;
+        collect_live(found);
+
+        for (size_t i = 0; i < found.size(); i++)
+            printer(found[i]);
+    }
+
+    template <typename ITF, typename ITN>
+    bool track(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing
+    ) const
+    {
+        epoch_guard guard(_epochs);
+
+        bool found_all = true;
+
+        node_set visited;
+        std::vector<const concurrent_node*> pending;
+        std::vector<const concurrent_node*> found;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const concurrent_node* node_in = lookup(file);
+
+            if (node_in == 0)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            visit(visited, pending, found, node_in);
+        }
+
+        std::sort(found.begin(), found.end(), uuid_less);
+
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            *nodes_out = found[i];
+            nodes_out++;
+        }
+
+        return found_all;
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        epoch_guard guard(_epochs);
+
+        return lookup(file) != 0;
+    }
+
+    /**
+     * Number of pushes published so far, readers can use it to detect
+     * that the graph changed between two queries.
+     */
+    boost::uint64_t revision(
+    ) const
+    {
+        return _revision.load(boost::memory_order_acquire);
+    }
+
+    /**
+     * Free the released nodes that no reader can reach anymore and
+     * return how many retired objects are still waiting.
+     */
+    size_t reclaim(
+    )
+    {
+        detail::scoped_lock lock(_mutex);
+
+        reclaim_retired();
+
+        return _retired_nodes.size() + _retired_indexes.size();
+    }
+
+    size_t bytes_used(
+    )
+    {
+        detail::scoped_lock lock(_mutex);
+
+        return _arena.bytes_used() + _commands.bytes_used();
+    }
+
+    ~concurrent_hist_graph(
+    )
+    {
+        std::vector<const concurrent_node*> found;
+        collect_live(found);
+
+        for (size_t i = 0; i < found.size(); i++)
+            const_cast<concurrent_node*>(found[i])->~concurrent_node();
+
+        for (size_t i = 0; i < _retired_nodes.size(); i++)
+            _retired_nodes[i].second->~concurrent_node();
+
+        for (size_t i = 0; i < _retired_indexes.size(); i++)
+            delete _retired_indexes[i].second;
+
+        for (size_t i = 0; i < _entries.size(); i++)
+            delete _entries[i];
+
+        delete _index.load(boost::memory_order_relaxed);
+    }
+
+private:
+
+    concurrent_hist_graph(
+        const concurrent_hist_graph&
+    );
+
+    concurrent_hist_graph& operator =(
+        const concurrent_hist_graph&
+    );
+};
+
+}
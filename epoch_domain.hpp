@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <pthread.h>
+
+namespace h1st {
+
+/**
+ * Epoch-based reclamation for structures with a single writer and
+ * lock-free readers. Readers announce the global epoch while they are
+ * inside a read section, the writer tags every unlinked object with
+ * retire() and may free it once min_active() is greater than the tag.
+ * Each reader thread claims one slot on its first read section and
+ * keeps it until the thread exits.
+ */
+class epoch_domain
+{
+public:
+
+    typedef boost::uint64_t epoch_type;
+
+private:
+
+    struct reader_slot
+    {
+        // Zero while the owner is outside a read section
+        boost::atomic<epoch_type> epoch;
+        boost::atomic<bool> claimed;
+        size_t depth;
+        // Keep the slots of different readers in different cache lines
+        char padding[64];
+    };
+
+    boost::atomic<epoch_type> _epoch;
+    boost::atomic<size_t> _num_claimed;
+    reader_slot* _slots;
+    size_t _num_slots;
+    pthread_key_t _key;
+
+    static void release_slot(
+        void* value
+    )
+    {
+        reader_slot* slot = static_cast<reader_slot*>(value);
+
+        slot->depth = 0;
+        slot->epoch.store(0, boost::memory_order_release);
+        slot->claimed.store(false, boost::memory_order_release);
+    }
+
+    reader_slot* claim_slot(
+    )
+    {
+        for (size_t i = 0; i < _num_slots; i++)
+        {
+            bool expected = false;
+
+            if (!_slots[i].claimed.compare_exchange_strong(expected, true,
+                boost::memory_order_acq_rel))
+                continue;
+
+            size_t num_claimed = _num_claimed.load(
+                boost::memory_order_relaxed);
+
+            while (num_claimed <= i && !_num_claimed.compare_exchange_weak(
+                num_claimed, i + 1, boost::memory_order_acq_rel))
+            {
+            }
+
+            const int rc = pthread_setspecific(_key, &_slots[i]);
+
+            if (rc != 0)
+            {
+                release_slot(&_slots[i]);
+
+                EX3_THROW(thread_exception()
+                    << errno_value(rc));
+            }
+
+            return &_slots[i];
+        }
+
+        EX3_THROW(reader_limit_exception());
+    }
+
+public:
+
+    epoch_domain(
+        size_t num_slots = 256
+    ) :
+        _epoch(1),
+        _num_claimed(0),
+        _slots(new reader_slot[num_slots]),
+        _num_slots(num_slots),
+        _key()
+    {
+        for (size_t i = 0; i < _num_slots; i++)
+        {
+            _slots[i].epoch.store(0, boost::memory_order_relaxed);
+            _slots[i].claimed.store(false, boost::memory_order_relaxed);
+            _slots[i].depth = 0;
+        }
+
+        const int rc = pthread_key_create(&_key, release_slot);
+
+        if (rc != 0)
+        {
+            delete[] _slots;
+
+            EX3_THROW(thread_exception()
+                << errno_value(rc));
+        }
+    }
+
+    /**
+     * Enter a read section on the calling thread, sections nest and
+     * only the outermost one announces an epoch.
+     */
+    void enter(
+    )
+    {
+        reader_slot* slot = static_cast<reader_slot*>(
+            pthread_getspecific(_key));
+
+        if (slot == 0)
+            slot = claim_slot();
+
+        if (slot->depth++ != 0)
+            return;
+
+        // The fence pairs with the one in retire(), either the writer
+        // sees this slot as active or the reader sees every object the
+        // writer unlinked before it scanned the slots
+
+        slot->epoch.store(_epoch.load(boost::memory_order_acquire),
+            boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    }
+
+    void exit(
+    )
+    {
+        reader_slot* slot = static_cast<reader_slot*>(
+            pthread_getspecific(_key));
+
+        if (--slot->depth == 0)
+            slot->epoch.store(0, boost::memory_order_release);
+    }
+
+    /**
+     * Return the tag for the objects unlinked so far and open a new
+     * epoch. Must be called by the writer after the objects are no
+     * longer reachable from the shared structure.
+     */
+    epoch_type retire(
+    )
+    {
+        const epoch_type tag = _epoch.fetch_add(1,
+            boost::memory_order_acq_rel);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        return tag;
+    }
+
+    /**
+     * Smallest epoch announced by a reader, objects with a smaller tag
+     * can no longer be reached by any of them.
+     */
+    epoch_type min_active(
+    ) const
+    {
+        epoch_type min_epoch = _epoch.load(boost::memory_order_acquire);
+        const size_t num_claimed = _num_claimed.load(
+            boost::memory_order_acquire);
+
+        for (size_t i = 0; i < num_claimed; i++)
+        {
+            const epoch_type epoch = _slots[i].epoch.load(
+                boost::memory_order_acquire);
+
+            if (epoch != 0 && epoch < min_epoch)
+                min_epoch = epoch;
+        }
+
+        return min_epoch;
+    }
+
+    ~epoch_domain(
+    )
+    {
+        pthread_key_delete(_key);
+        delete[] _slots;
+    }
+
+private:
+
+    epoch_domain(
+        const epoch_domain&
+    );
+
+    epoch_domain& operator =(
+        const epoch_domain&
+    );
+};
+
+class epoch_guard
+{
+private:
+
+    epoch_domain* _domain;
+
+public:
+
+    epoch_guard(
+        epoch_domain& domain
+    ) :
+        _domain(&domain)
+    {
+        _domain->enter();
+    }
+
+    ~epoch_guard(
+    )
+    {
+        _domain->exit();
+    }
+
+private:
+
+    epoch_guard(
+        const epoch_guard&
+    );
+
+    epoch_guard& operator =(
+        const epoch_guard&
+    );
+};
+
+}
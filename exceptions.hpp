@@ -45,10 +45,17 @@ class h1st_exception :
 
 H1ST_MAKE_EINFO(argument_name, std::string)
 H1ST_MAKE_EINFO(input_value  , std::string)
+H1ST_MAKE_EINFO(file_name    , std::string)
+H1ST_MAKE_EINFO(errno_value  , int        )
+H1ST_MAKE_EINFO(line_number  , size_t     )
 
 H1ST_MAKE_EXCEPTION(null_value_exception       )
 H1ST_MAKE_EXCEPTION(empty_input_value_exception)
 H1ST_MAKE_EXCEPTION(empty_output_exception     )
 H1ST_MAKE_EXCEPTION(input_not_found_exception  )
+H1ST_MAKE_EXCEPTION(io_exception               )
+H1ST_MAKE_EXCEPTION(invalid_format_exception   )
+H1ST_MAKE_EXCEPTION(thread_exception           )
+H1ST_MAKE_EXCEPTION(reader_limit_exception     )
 
 }
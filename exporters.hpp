@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "output_buffer.hpp"
+#include "string_ref.hpp"
+#include "command_store.hpp"
+#include "provenance.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+
+namespace h1st {
+
+namespace detail {
+
+enum escape_style
+{
+    escape_dot,
+    escape_json
+};
+
+inline void append_escaped(
+    output_buffer& buffer,
+    const string_ref& str,
+    escape_style style
+)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const char* begin = str.begin();
+
+    for (const char* p = str.begin(); p != str.end(); p++)
+    {
+        const unsigned char c = static_cast<unsigned char>(*p);
+
+        if (c != '"' && c != '\\' && c >= 0x20)
+            continue;
+
+        // Copy the plain run in one go and escape the character
+
+        buffer.append(begin, static_cast<size_t>(p - begin));
+        begin = p + 1;
+
+        if (c == '"' || c == '\\')
+        {
+            buffer.append('\\');
+            buffer.append(*p);
+        }
+        else if (c == '\n')
+        {
+            buffer.append("\\n", 2);
+        }
+        else if (style == escape_json)
+        {
+            buffer.append("\\u00", 4);
+            buffer.append(hex[c >> 4]);
+            buffer.append(hex[c & 0xf]);
+        }
+        else
+        {
+            buffer.append(' ');
+        }
+    }
+
+    buffer.append(begin, static_cast<size_t>(str.end() - begin));
+}
+
+inline void append_escaped(
+    output_buffer& buffer,
+    const std::string& str,
+    escape_style style
+)
+{
+    append_escaped(buffer, string_ref(str), style);
+}
+
+inline void append_escaped(
+    output_buffer& buffer,
+    const path_ref& path,
+    escape_style style
+)
+{
+    append_escaped(buffer, string_ref(path.str()), style);
+}
+
+inline void append_escaped(
+    output_buffer& buffer,
+    const command_ref& command,
+    escape_style style
+)
+{
+    for (size_t i = 0; i < command.num_chunks(); i++)
+        append_escaped(buffer, command.chunk(i), style);
+}
+
+}
+
+/**
+ * Writes the nodes as a Graphviz digraph, one vertex per node labeled
+ * with its command and outputs and one edge per input labeled with the
+ * file. Nothing is kept between nodes, call close() after the last one.
+ */
+class hist_node_export_dot
+{
+private:
+
+    output_buffer* _p_buffer;
+
+public:
+
+    hist_node_export_dot(
+        output_buffer* p_buffer
+    ) :
+        _p_buffer(p_buffer)
+    {
+        if (_p_buffer == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("p_buffer"));
+        }
+
+        _p_buffer->append("digraph h1st {\n", 15);
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        _p_buffer->append("  n", 3);
+        _p_buffer->append(node->uuid());
+        _p_buffer->append(" [label=\"", 9);
+        detail::append_escaped(*_p_buffer, node->command(),
+            detail::escape_dot);
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+        {
+            _p_buffer->append("\\n", 2);
+            detail::append_escaped(*_p_buffer, node->files_out()[i],
+                detail::escape_dot);
+        }
+
+        _p_buffer->append("\"];\n", 4);
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            _p_buffer->append("  n", 3);
+            _p_buffer->append(node->nodes_in()[i].node()->uuid());
+            _p_buffer->append(" -> n", 5);
+            _p_buffer->append(node->uuid());
+            _p_buffer->append(" [label=\"", 9);
+            detail::append_escaped(*_p_buffer, node->nodes_in()[i].file(),
+                detail::escape_dot);
+            _p_buffer->append("\"];\n", 4);
+        }
+    }
+
+    void close(
+    )
+    {
+        _p_buffer->append("}\n", 2);
+        _p_buffer->flush();
+    }
+};
+
+/**
+ * Writes one JSON object per node and line:
+ * {"uuid":N,"command":"...","inputs":[{"file":"...","uuid":M}],
+ * "outputs":["..."]}
+ */
+class hist_node_export_jsonl
+{
+private:
+
+    output_buffer* _p_buffer;
+
+public:
+
+    hist_node_export_jsonl(
+        output_buffer* p_buffer
+    ) :
+        _p_buffer(p_buffer)
+    {
+        if (_p_buffer == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("p_buffer"));
+        }
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        _p_buffer->append("{\"uuid\":", 8);
+        _p_buffer->append(node->uuid());
+        _p_buffer->append(",\"command\":\"", 12);
+        detail::append_escaped(*_p_buffer, node->command(),
+            detail::escape_json);
+        _p_buffer->append("\",\"inputs\":[", 12);
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            if (i != 0)
+                _p_buffer->append(',');
+
+            _p_buffer->append("{\"file\":\"", 9);
+            detail::append_escaped(*_p_buffer, node->nodes_in()[i].file(),
+                detail::escape_json);
+            _p_buffer->append("\",\"uuid\":", 9);
+            _p_buffer->append(node->nodes_in()[i].node()->uuid());
+            _p_buffer->append('}');
+        }
+
+        _p_buffer->append("],\"outputs\":[", 13);
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+        {
+            if (i != 0)
+                _p_buffer->append(',');
+
+            _p_buffer->append('"');
+            detail::append_escaped(*_p_buffer, node->files_out()[i],
+                detail::escape_json);
+            _p_buffer->append('"');
+        }
+
+        _p_buffer->append("]}\n", 3);
+    }
+};
+
+/**
+ * Writes a condensed provenance as a Graphviz digraph, one vertex per
+ * segment labeled with the first and last commands and the outputs of
+ * the last node, and one edge per input of a segment labeled with the
+ * file.
+ */
+template <typename Node>
+void export_condensed_dot(
+    output_buffer* p_buffer,
+    const condensed_provenance<Node>& provenance
+)
+{
+    if (p_buffer == 0)
+    {
+        EX3_THROW(null_value_exception()
+            << argument_name("p_buffer"));
+    }
+
+    p_buffer->append("digraph h1st {\n", 15);
+
+    for (size_t s = 0; s < provenance.num_segments(); s++)
+    {
+        const Node& head = provenance.head(s);
+        const Node& tail = provenance.tail(s);
+        const size_t size = provenance.size(s);
+
+        p_buffer->append("  s", 3);
+        p_buffer->append(static_cast<boost::uint64_t>(s));
+        p_buffer->append(" [label=\"", 9);
+        detail::append_escaped(*p_buffer, head->command(),
+            detail::escape_dot);
+
+        if (size > 2)
+        {
+            p_buffer->append("\\n... ", 6);
+            p_buffer->append(static_cast<boost::uint64_t>(size - 2));
+            p_buffer->append(" more ...", 9);
+        }
+
+        if (size > 1)
+        {
+            p_buffer->append("\\n", 2);
+            detail::append_escaped(*p_buffer, tail->command(),
+                detail::escape_dot);
+        }
+
+        for (size_t i = 0; i < tail->files_out().size(); i++)
+        {
+            p_buffer->append("\\n", 2);
+            detail::append_escaped(*p_buffer, tail->files_out()[i],
+                detail::escape_dot);
+        }
+
+        p_buffer->append("\"];\n", 4);
+
+        for (size_t i = 0; i < provenance.num_inputs(s); i++)
+        {
+            p_buffer->append("  s", 3);
+            p_buffer->append(static_cast<boost::uint64_t>(
+                provenance.input(s, i).source));
+            p_buffer->append(" -> s", 5);
+            p_buffer->append(static_cast<boost::uint64_t>(s));
+            p_buffer->append(" [label=\"", 9);
+            detail::append_escaped(*p_buffer,
+                head->nodes_in()[provenance.input(s, i).input].file(),
+                detail::escape_dot);
+            p_buffer->append("\"];\n", 4);
+        }
+    }
+
+    p_buffer->append("}\n", 2);
+    p_buffer->flush();
+}
+
+/**
+ * Output iterator that hands every node assigned to it to a printer,
+ * so track can feed an exporter without collecting its result.
+ */
+template <typename Printer>
+class printer_iterator
+{
+private:
+
+    Printer* _p_printer;
+
+public:
+
+    typedef std::output_iterator_tag iterator_category;
+    typedef void value_type;
+    typedef void difference_type;
+    typedef void pointer;
+    typedef void reference;
+
+    printer_iterator(
+        Printer* p_printer
+    ) :
+        _p_printer(p_printer)
+    {
+    }
+
+    template <typename Node>
+    printer_iterator& operator =(
+        const Node& node
+    )
+    {
+        (*_p_printer)(node);
+        return *this;
+    }
+
+    printer_iterator& operator *(
+    )
+    {
+        return *this;
+    }
+
+    printer_iterator& operator ++(
+    )
+    {
+        return *this;
+    }
+
+    printer_iterator operator ++(
+        int
+    )
+    {
+        return *this;
+    }
+};
+
+template <typename Printer>
+printer_iterator<Printer> make_printer_iterator(
+    Printer& printer
+)
+{
+    return printer_iterator<Printer>(&printer);
+}
+
+}
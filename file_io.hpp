@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+
+namespace h1st {
+namespace detail {
+
+inline void throw_io_error(
+    const std::string& file,
+    int error
+)
+{
+    EX3_THROW(io_exception()
+        << file_name(file)
+        << errno_value(error));
+}
+
+inline void write_all(
+    int fd,
+    const char* data,
+    size_t size,
+    const std::string& file
+)
+{
+    while (size > 0)
+    {
+        const ssize_t written = ::write(fd, data, size);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            throw_io_error(file, errno);
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+}
+}
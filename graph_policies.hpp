@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "threading.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+
+namespace h1st {
+
+/**
+ * Pruning policy that destroys the released nodes as soon as they are
+ * shadowed and compacts the node vector when the holes outnumber the
+ * live nodes. This is the behavior of hist_graph.
+ *
+ * Besides should_collect, a pruning policy gives the budget of a
+ * collection, the most nodes it destroys plus slots it compacts, and
+ * the nursery, the least number of nodes pushed since the last
+ * compaction that are compacted on their own, or zero to only compact
+ * the whole graph. Nodes are unlinked as soon as they are released
+ * under every policy, so no query depends on the pruning policy except
+ * for the uuids it renumbers.
+ */
+struct eager_pruning
+{
+    bool should_collect(
+        size_t,
+        size_t
+    ) const
+    {
+        return true;
+    }
+
+    size_t budget(
+    ) const
+    {
+        return static_cast<size_t>(-1);
+    }
+
+    size_t nursery(
+    ) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * Pruning policy that keeps the released nodes allocated until at
+ * least threshold of them are waiting or collect() is called, moving
+ * the deallocation and the compaction off most pushes. Released nodes
+ * are unlinked immediately, so queries are not affected.
+ */
+class deferred_pruning
+{
+private:
+
+    size_t _threshold;
+
+public:
+
+    explicit deferred_pruning(
+        size_t threshold = 4096
+    ) :
+        _threshold(threshold)
+    {
+    }
+
+    void set_threshold(
+        size_t threshold
+    )
+    {
+        _threshold = threshold;
+    }
+
+    size_t threshold(
+    ) const
+    {
+        return _threshold;
+    }
+
+    bool should_collect(
+        size_t num_garbage,
+        size_t
+    ) const
+    {
+        return num_garbage >= _threshold;
+    }
+
+    size_t budget(
+    ) const
+    {
+        return static_cast<size_t>(-1);
+    }
+
+    size_t nursery(
+    ) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * Pruning policy that only reclaims released nodes on collect(), so
+ * the uuids of the live nodes never change on their own.
+ */
+struct no_pruning
+{
+    bool should_collect(
+        size_t,
+        size_t
+    ) const
+    {
+        return false;
+    }
+
+    size_t budget(
+    ) const
+    {
+        return static_cast<size_t>(-1);
+    }
+
+    size_t nursery(
+    ) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * Pruning policy that spreads the destruction of released nodes and
+ * the compaction over the pushes, doing at most budget units of work
+ * after each one. Since a node is released at most once and each
+ * compaction follows at least as many releases as half the slots it
+ * moves past, a budget of 4 keeps up with pushes of single nodes.
+ */
+class incremental_pruning
+{
+private:
+
+    size_t _budget;
+
+public:
+
+    explicit incremental_pruning(
+        size_t budget = 64
+    ) :
+        _budget(budget)
+    {
+    }
+
+    void set_budget(
+        size_t budget
+    )
+    {
+        _budget = budget;
+    }
+
+    bool should_collect(
+        size_t,
+        size_t
+    ) const
+    {
+        return true;
+    }
+
+    size_t budget(
+    ) const
+    {
+        return _budget;
+    }
+
+    size_t nursery(
+    ) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * Pruning policy for histories where most nodes are shadowed soon after
+ * they are pushed. Once nursery nodes were pushed since the last
+ * compaction and most of them are released, only those are compacted,
+ * so the common pause is bounded by the nursery instead of the graph.
+ * The whole graph is still compacted when the holes outnumber the live
+ * nodes, within budget units of work per push.
+ */
+class generational_pruning
+{
+private:
+
+    size_t _nursery;
+    size_t _budget;
+
+public:
+
+    explicit generational_pruning(
+        size_t nursery = 4096,
+        size_t budget = static_cast<size_t>(-1)
+    ) :
+        _nursery(nursery),
+        _budget(budget)
+    {
+    }
+
+    void set_nursery(
+        size_t nursery
+    )
+    {
+        _nursery = nursery;
+    }
+
+    void set_budget(
+        size_t budget
+    )
+    {
+        _budget = budget;
+    }
+
+    bool should_collect(
+        size_t,
+        size_t
+    ) const
+    {
+        return true;
+    }
+
+    size_t budget(
+    ) const
+    {
+        return _budget;
+    }
+
+    size_t nursery(
+    ) const
+    {
+        return _nursery;
+    }
+};
+
+/**
+ * Retention policy of a graph that only keeps the current binding of
+ * each file.
+ */
+struct no_retention
+{
+    static const bool enabled = false;
+
+    size_t per_path(
+    ) const
+    {
+        return 0;
+    }
+
+    size_t total(
+    ) const
+    {
+        return 0;
+    }
+};
+
+/**
+ * Retention policy that keeps the producers of the last per_path
+ * overwritten versions of each file, and at most total overwritten
+ * versions across all files, dropping the oldest first. Retained
+ * versions are queried as "file@vN", where N counts the bindings of
+ * the file from 1.
+ */
+class version_retention
+{
+private:
+
+    size_t _per_path;
+    size_t _total;
+
+public:
+
+    static const bool enabled = true;
+
+    explicit version_retention(
+        size_t per_path = 8,
+        size_t total = static_cast<size_t>(-1)
+    ) :
+        _per_path(per_path),
+        _total(total)
+    {
+    }
+
+    size_t per_path(
+    ) const
+    {
+        return _per_path;
+    }
+
+    size_t total(
+    ) const
+    {
+        return _total;
+    }
+};
+
+/**
+ * Id policy of a graph whose node uuids are ints, as in hist_graph.
+ */
+struct uuid32
+{
+    typedef int type;
+};
+
+/**
+ * Id policy of a graph that pushes more than 2^31 nodes between two
+ * compactions of its node vector, e.g. one that never prunes.
+ */
+struct uuid64
+{
+    typedef boost::int64_t type;
+};
+
+/**
+ * Binding kept by hist_graph::merge when several graphs bind the same
+ * path: the one of the graph merged last, or the one that was bound
+ * first, starting with the bindings of the target graph.
+ */
+enum merge_policy
+{
+    merge_last_writer,
+    merge_first_writer
+};
+
+/**
+ * Locking policy of a graph used by a single thread at a time.
+ */
+struct single_threaded
+{
+    struct guard
+    {
+        explicit guard(
+            const single_threaded&
+        )
+        {
+        }
+    };
+};
+
+/**
+ * Locking policy that serializes every public call of the graph with a
+ * recursive mutex. Nodes returned by the graph may still be released
+ * by a later push from another thread, see concurrent_hist_graph for
+ * readers that run alongside writers.
+ */
+class serialized
+{
+private:
+
+    mutable detail::mutex _mutex;
+
+public:
+
+    class guard
+    {
+    private:
+
+        detail::scoped_lock _lock;
+
+    public:
+
+        explicit guard(
+            const serialized& locking
+        ) :
+            _lock(locking._mutex)
+        {
+        }
+    };
+
+    serialized(
+    ) :
+        _mutex(true)
+    {
+    }
+};
+
+}
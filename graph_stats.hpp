@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+#include <time.h>
+
+#include <cstddef>
+
+namespace h1st {
+
+/**
+ * Operations of a hist_graph that report their latency to the stats
+ * policy.
+ */
+enum graph_operation
+{
+    op_push,
+    op_push_batch,
+    op_prune,
+    op_track,
+    op_dependents,
+    op_print,
+    num_graph_operations
+};
+
+/**
+ * Stats policy of hist_graph. Every hook is an empty inline function
+ * and the timer is an empty struct, so a graph built with it compiles
+ * to the same code as one without instrumentation.
+ */
+struct null_stats
+{
+    struct timer
+    {
+    };
+
+    timer start(
+    ) const
+    {
+        return timer();
+    }
+
+    void finish(
+        const timer&,
+        graph_operation
+    )
+    {
+    }
+
+    void add_pushed(
+        size_t
+    )
+    {
+    }
+
+    void add_released(
+    )
+    {
+    }
+
+    void add_edges(
+        size_t
+    )
+    {
+    }
+
+    void add_lookups(
+        size_t
+    )
+    {
+    }
+
+    template <typename Graph>
+    void sample(
+        const Graph&
+    )
+    {
+    }
+};
+
+/**
+ * Latency totals of one graph_operation.
+ */
+struct operation_stats
+{
+    boost::uint64_t count;
+    boost::uint64_t total_ns;
+    boost::uint64_t max_ns;
+
+    operation_stats(
+    ) :
+        count(0),
+        total_ns(0),
+        max_ns(0)
+    {
+    }
+};
+
+/**
+ * Stats policy that counts the work done by a hist_graph and times
+ * every graph_operation with the monotonic clock. The latency of each
+ * operation can also be forwarded to a hook, for example to feed the
+ * histograms of a metrics system.
+ */
+class counting_stats
+{
+public:
+
+    typedef void (*latency_hook)(
+        void* context,
+        graph_operation operation,
+        boost::uint64_t nanoseconds
+    );
+
+    struct timer
+    {
+        boost::uint64_t start_ns;
+    };
+
+private:
+
+    boost::uint64_t _nodes_pushed;
+    boost::uint64_t _nodes_released;
+    boost::uint64_t _edges_traversed;
+    boost::uint64_t _lookups;
+    size_t _peak_nodes;
+    size_t _peak_bytes;
+    operation_stats _operations[num_graph_operations];
+    latency_hook _hook;
+    void* _hook_context;
+
+    static boost::uint64_t now_ns(
+    )
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return static_cast<boost::uint64_t>(ts.tv_sec) * 1000000000u +
+            static_cast<boost::uint64_t>(ts.tv_nsec);
+    }
+
+public:
+
+    counting_stats(
+    ) :
+        _nodes_pushed(0),
+        _nodes_released(0),
+        _edges_traversed(0),
+        _lookups(0),
+        _peak_nodes(0),
+        _peak_bytes(0),
+        _operations(),
+        _hook(0),
+        _hook_context(0)
+    {
+    }
+
+    void set_hook(
+        latency_hook hook,
+        void* context
+    )
+    {
+        _hook = hook;
+        _hook_context = context;
+    }
+
+    timer start(
+    ) const
+    {
+        timer t;
+        t.start_ns = now_ns();
+        return t;
+    }
+
+    void finish(
+        const timer& t,
+        graph_operation operation
+    )
+    {
+        const boost::uint64_t elapsed = now_ns() - t.start_ns;
+        operation_stats& op = _operations[operation];
+
+        op.count++;
+        op.total_ns += elapsed;
+
+        if (elapsed > op.max_ns)
+            op.max_ns = elapsed;
+
+        if (_hook != 0)
+            _hook(_hook_context, operation, elapsed);
+    }
+
+    void add_pushed(
+        size_t count
+    )
+    {
+        _nodes_pushed += count;
+    }
+
+    void add_released(
+    )
+    {
+        _nodes_released++;
+    }
+
+    void add_edges(
+        size_t count
+    )
+    {
+        _edges_traversed += count;
+    }
+
+    void add_lookups(
+        size_t count
+    )
+    {
+        _lookups += count;
+    }
+
+    template <typename Graph>
+    void sample(
+        const Graph& graph
+    )
+    {
+        const size_t nodes = graph.num_nodes();
+        const size_t bytes = graph.bytes_used();
+
+        if (nodes > _peak_nodes)
+            _peak_nodes = nodes;
+
+        if (bytes > _peak_bytes)
+            _peak_bytes = bytes;
+    }
+
+    boost::uint64_t nodes_pushed(
+    ) const
+    {
+        return _nodes_pushed;
+    }
+
+    boost::uint64_t nodes_released(
+    ) const
+    {
+        return _nodes_released;
+    }
+
+    boost::uint64_t edges_traversed(
+    ) const
+    {
+        return _edges_traversed;
+    }
+
+    boost::uint64_t lookups(
+    ) const
+    {
+        return _lookups;
+    }
+
+    size_t peak_nodes(
+    ) const
+    {
+        return _peak_nodes;
+    }
+
+    size_t peak_bytes(
+    ) const
+    {
+        return _peak_bytes;
+    }
+
+    const operation_stats& operation(
+        graph_operation op
+    ) const
+    {
+        return _operations[op];
+    }
+
+    void reset(
+    )
+    {
+        latency_hook hook = _hook;
+        void* context = _hook_context;
+
+        *this = counting_stats();
+
+        _hook = hook;
+        _hook_context = context;
+    }
+};
+
+}
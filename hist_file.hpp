@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "snapshot.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+namespace h1st {
+
+/**
+ * Layout of a serialized graph: the header is followed by the CSR arrays
+ * of hist_csr_arrays, each starting at an 8-byte aligned offset recorded
+ * in the section table. Integers are stored in the byte order of the
+ * writer and the loader rejects files written with a different one.
+ */
+struct hist_file_header
+{
+    enum
+    {
+        uuids,
+        in_offsets,
+        in_nodes,
+        in_files,
+        out_offsets,
+        out_files,
+        command_offsets,
+        commands,
+        path_offsets,
+        paths,
+        path_hashes,
+        bindings,
+        slots,
+        num_sections
+    };
+
+    static const boost::uint32_t current_version = 1;
+    static const boost::uint32_t byte_order_mark = 0x01020304;
+
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t byte_order;
+    boost::uint32_t num_nodes;
+    boost::uint32_t num_paths;
+    boost::uint32_t num_slots;
+    boost::uint32_t tag;
+    boost::uint64_t offsets[num_sections];
+    boost::uint64_t sizes[num_sections];
+
+    static const char* magic_value(
+    )
+    {
+        return "H1STCSR";
+    }
+};
+
+namespace detail {
+
+class hist_file_writer
+{
+private:
+
+    std::ostream* _p_stream;
+    hist_file_header _header;
+    boost::uint64_t _offset;
+
+    void pad(
+    )
+    {
+        static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+        const size_t padding = static_cast<size_t>((8 - _offset % 8) % 8);
+
+        _p_stream->write(zeros, static_cast<std::streamsize>(padding));
+        _offset += padding;
+    }
+
+public:
+
+    hist_file_writer(
+        std::ostream* p_stream,
+        const hist_csr_arrays& csr,
+        boost::uint32_t tag
+    ) :
+        _p_stream(p_stream),
+        _header(),
+        _offset(sizeof(hist_file_header))
+    {
+        std::memset(&_header, 0, sizeof(_header));
+        std::memcpy(_header.magic, hist_file_header::magic_value(), 8);
+        _header.version = hist_file_header::current_version;
+        _header.byte_order = hist_file_header::byte_order_mark;
+        _header.num_nodes = csr.num_nodes;
+        _header.num_paths = csr.num_paths;
+        _header.num_slots = csr.num_slots;
+        _header.tag = tag;
+    }
+
+    template <typename T>
+    void plan(
+        int section,
+        const T*,
+        boost::uint64_t count
+    )
+    {
+        _offset += (8 - _offset % 8) % 8;
+        _header.offsets[section] = _offset;
+        _header.sizes[section] = count * sizeof(T);
+        _offset += _header.sizes[section];
+    }
+
+    void write_header(
+    )
+    {
+        _p_stream->write(reinterpret_cast<const char*>(&_header),
+            sizeof(_header));
+        _offset = sizeof(_header);
+    }
+
+    template <typename T>
+    void write(
+        const T* data,
+        boost::uint64_t count
+    )
+    {
+        // Offset arrays of an empty view have no storage but still
+        // hold the single leading zero
+
+        pad();
+
+        if (data == 0)
+        {
+            const T zero = 0;
+
+            for (boost::uint64_t i = 0; i < count; i++)
+                _p_stream->write(reinterpret_cast<const char*>(&zero),
+                    sizeof(T));
+        }
+        else
+        {
+            _p_stream->write(reinterpret_cast<const char*>(data),
+                static_cast<std::streamsize>(count * sizeof(T)));
+        }
+
+        _offset += count * sizeof(T);
+    }
+};
+
+}
+
+/**
+ * The tag is stored verbatim in the header for the application to use.
+ */
+inline void write_hist_file(
+    std::ostream& stream,
+    const hist_csr_view& view,
+    boost::uint32_t tag = 0
+)
+{
+    const hist_csr_arrays& csr = view.arrays();
+
+    const boost::uint64_t n = csr.num_nodes;
+    const boost::uint64_t p = csr.num_paths;
+    const boost::uint64_t s = csr.num_slots;
+    const boost::uint64_t num_in = n == 0 ? 0 : csr.in_offsets[n];
+    const boost::uint64_t num_out = n == 0 ? 0 : csr.out_offsets[n];
+    const boost::uint64_t num_chars = n == 0 ? 0 : csr.command_offsets[n];
+    const boost::uint64_t num_path_chars = p == 0 ? 0 : csr.path_offsets[p];
+
+    detail::hist_file_writer writer(&stream, csr, tag);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // The first pass lays the sections out, the second writes them
+
+        if (pass == 1)
+            writer.write_header();
+
+#define H1ST_SECTION(Name, Count) \
+        if (pass == 0) \
+            writer.plan(hist_file_header::Name, csr.Name, Count); \
+        else \
+            writer.write(csr.Name, Count);
+
+        H1ST_SECTION(uuids          , n             )
+        H1ST_SECTION(in_offsets     , n + 1         )
+        H1ST_SECTION(in_nodes       , num_in        )
+        H1ST_SECTION(in_files       , num_in        )
+        H1ST_SECTION(out_offsets    , n + 1         )
+        H1ST_SECTION(out_files      , num_out       )
+        H1ST_SECTION(command_offsets, n + 1         )
+        H1ST_SECTION(commands       , num_chars     )
+        H1ST_SECTION(path_offsets   , p + 1         )
+        H1ST_SECTION(paths          , num_path_chars)
+        H1ST_SECTION(path_hashes    , p             )
+        H1ST_SECTION(bindings       , p             )
+        H1ST_SECTION(slots          , s             )
+
+#undef H1ST_SECTION
+    }
+
+    if (!stream)
+    {
+        EX3_THROW(io_exception());
+    }
+}
+
+inline void write_hist_file(
+    const std::string& file,
+    const hist_csr_view& view,
+    boost::uint32_t tag = 0
+)
+{
+    std::ofstream stream(file.c_str(), std::ios::out |
+        std::ios::binary | std::ios::trunc);
+
+    if (!stream)
+    {
+        EX3_THROW(io_exception()
+            << file_name(file));
+    }
+
+    try
+    {
+        write_hist_file(stream, view, tag);
+        stream.close();
+    }
+    catch (io_exception& ex)
+    {
+        ex << file_name(file);
+        throw;
+    }
+
+    if (!stream)
+    {
+        EX3_THROW(io_exception()
+            << file_name(file));
+    }
+}
+
+/**
+ * Read-only graph mapped from a file written by write_hist_file. The
+ * arrays are used in place, so opening the file costs a header check
+ * regardless of its size and pages are loaded as queries touch them.
+ * Opening only checks that the sections fit in the file, call validate()
+ * before querying a file that may be corrupt.
+ */
+class hist_file_view :
+    public hist_csr_view
+{
+private:
+
+    std::string _file;
+    void* _data;
+    size_t _size;
+    boost::uint32_t _tag;
+
+    void check(
+        bool condition,
+        const std::string& file
+    )
+    {
+        if (!condition)
+        {
+            unmap();
+
+            EX3_THROW(invalid_format_exception()
+                << file_name(file));
+        }
+    }
+
+    template <typename T>
+    const T* section(
+        const hist_file_header& header,
+        int section,
+        boost::uint64_t count,
+        const std::string& file
+    )
+    {
+        const boost::uint64_t offset = header.offsets[section];
+        const boost::uint64_t size = header.sizes[section];
+
+        check(offset % 8 == 0 && size == count * sizeof(T) &&
+            offset <= _size && size <= _size - offset, file);
+
+        return reinterpret_cast<const T*>(
+            static_cast<const char*>(_data) + offset);
+    }
+
+    void unmap(
+    )
+    {
+        if (_data != 0)
+            ::munmap(_data, _size);
+
+        _data = 0;
+        _size = 0;
+    }
+
+public:
+
+    explicit hist_file_view(
+        const std::string& file
+    ) :
+        hist_csr_view(),
+        _file(file),
+        _data(0),
+        _size(0),
+        _tag(0)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(errno));
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(error));
+        }
+
+        if (static_cast<size_t>(st.st_size) < sizeof(hist_file_header))
+        {
+            ::close(fd);
+
+            EX3_THROW(invalid_format_exception()
+                << file_name(file));
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        _data = ::mmap(0, _size, PROT_READ, MAP_SHARED, fd, 0);
+
+        const int error = errno;
+        ::close(fd);
+
+        if (_data == MAP_FAILED)
+        {
+            _data = 0;
+
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(error));
+        }
+
+        const hist_file_header& header =
+            *static_cast<const hist_file_header*>(_data);
+
+        check(std::memcmp(header.magic, hist_file_header::magic_value(),
+            8) == 0, file);
+        check(header.version == hist_file_header::current_version, file);
+        check(header.byte_order == hist_file_header::byte_order_mark, file);
+        check(header.num_slots == 0 ||
+            (header.num_slots & (header.num_slots - 1)) == 0, file);
+        check(header.num_slots > header.num_paths ||
+            header.num_paths == 0, file);
+
+        const boost::uint64_t n = header.num_nodes;
+        const boost::uint64_t p = header.num_paths;
+
+        _tag = header.tag;
+
+        hist_csr_arrays csr;
+        csr.num_nodes = header.num_nodes;
+        csr.num_paths = header.num_paths;
+        csr.num_slots = header.num_slots;
+
+        csr.uuids = section<boost::uint32_t>(header,
+            hist_file_header::uuids, n, file);
+        csr.in_offsets = section<boost::uint32_t>(header,
+            hist_file_header::in_offsets, n + 1, file);
+        csr.out_offsets = section<boost::uint32_t>(header,
+            hist_file_header::out_offsets, n + 1, file);
+        csr.command_offsets = section<boost::uint64_t>(header,
+            hist_file_header::command_offsets, n + 1, file);
+        csr.path_offsets = section<boost::uint64_t>(header,
+            hist_file_header::path_offsets, p + 1, file);
+
+        check(csr.in_offsets[0] == 0 && csr.out_offsets[0] == 0 &&
+            csr.command_offsets[0] == 0 && csr.path_offsets[0] == 0, file);
+
+        csr.in_nodes = section<boost::uint32_t>(header,
+            hist_file_header::in_nodes, csr.in_offsets[n], file);
+        csr.in_files = section<boost::uint32_t>(header,
+            hist_file_header::in_files, csr.in_offsets[n], file);
+        csr.out_files = section<boost::uint32_t>(header,
+            hist_file_header::out_files, csr.out_offsets[n], file);
+        csr.commands = section<char>(header,
+            hist_file_header::commands, csr.command_offsets[n], file);
+        csr.paths = section<char>(header,
+            hist_file_header::paths, csr.path_offsets[p], file);
+        csr.path_hashes = section<boost::uint64_t>(header,
+            hist_file_header::path_hashes, p, file);
+        csr.bindings = section<boost::uint32_t>(header,
+            hist_file_header::bindings, p, file);
+        csr.slots = section<boost::uint32_t>(header,
+            hist_file_header::slots, header.num_slots, file);
+
+        static_cast<hist_csr_view&>(*this) = hist_csr_view(csr);
+    }
+
+    /**
+     * Range-check every offset and index of the arrays, so that queries
+     * on a truncated or corrupt file cannot read out of bounds. This
+     * reads the whole file once.
+     */
+    void validate(
+    ) const
+    {
+        const hist_csr_arrays& csr = arrays();
+        bool valid = true;
+
+        for (boost::uint32_t i = 0; i < csr.num_nodes; i++)
+        {
+            valid = valid && csr.in_offsets[i] <= csr.in_offsets[i + 1] &&
+                csr.out_offsets[i] <= csr.out_offsets[i + 1] &&
+                csr.command_offsets[i] <= csr.command_offsets[i + 1];
+
+            if (!valid)
+                break;
+
+            // Inputs come before the node, which also rules out cycles
+
+            for (boost::uint32_t j = csr.in_offsets[i];
+                j < csr.in_offsets[i + 1]; j++)
+                valid = valid && csr.in_nodes[j] < i &&
+                    csr.in_files[j] < csr.num_paths;
+
+            for (boost::uint32_t j = csr.out_offsets[i];
+                j < csr.out_offsets[i + 1]; j++)
+                valid = valid && csr.out_files[j] < csr.num_paths;
+        }
+
+        for (boost::uint32_t id = 0; valid && id < csr.num_paths; id++)
+            valid = csr.path_offsets[id] <= csr.path_offsets[id + 1] &&
+                (csr.bindings[id] == invalid_csr_index ||
+                    csr.bindings[id] < csr.num_nodes);
+
+        // Lookups stop at the first free slot, so there must be one
+
+        boost::uint32_t used = 0;
+
+        for (boost::uint32_t i = 0; valid && i < csr.num_slots; i++)
+        {
+            if (csr.slots[i] == invalid_path_id)
+                continue;
+
+            valid = csr.slots[i] < csr.num_paths;
+            used++;
+        }
+
+        if (!valid || (csr.num_slots != 0 && used >= csr.num_slots))
+        {
+            EX3_THROW(invalid_format_exception()
+                << file_name(_file));
+        }
+    }
+
+    size_t file_size(
+    ) const
+    {
+        return _size;
+    }
+
+    boost::uint32_t tag(
+    ) const
+    {
+        return _tag;
+    }
+
+    ~hist_file_view(
+    )
+    {
+        unmap();
+    }
+
+private:
+
+    hist_file_view(
+        const hist_file_view&
+    );
+
+    hist_file_view& operator =(
+        const hist_file_view&
+    );
+};
+
+}
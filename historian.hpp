@@ -20,27 +20,44 @@
 #pragma once
 
 #include "exceptions.hpp"
-
+#include "array_ref.hpp"
+#include "branch.hpp"
+#include "command_store.hpp"
+#include "graph_policies.hpp"
+#include "graph_stats.hpp"
+#include "node_arena.hpp"
+#include "path_table.hpp"
+#include "snapshot.hpp"
+#include "parallel_visit.hpp"
+#include "provenance.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <algorithm>
+#include <deque>
 #include <utility>
 #include <ostream>
 #include <string>
 #include <vector>
-#include <map>
 
 namespace h1st {
 
-class node_input
+template <typename Node>
+class basic_node_input
 {
 private:
 
-    const struct hist_node* _node;
-    std::string _file;
+    const Node* _node;
+    path_ref _file;
 
 public:
 
-    node_input(
-        const hist_node* node,
-        const std::string& file
+    basic_node_input(
+        const Node* node,
+        const path_ref& file
     ) :
         _node(node),
         _file(file)
@@ -51,14 +68,14 @@ public:
                 << argument_name("node"));
         }
 
-        if (_file.size() == 0)
+        if (_file.str().size() == 0)
         {
             EX3_THROW(empty_input_value_exception()
                 << argument_name("file"));
         }
     }
 
-    const struct hist_node* node(
+    const Node* node(
     ) const
     {
         return _node;
@@ -67,329 +84,2069 @@ public:
     const std::string& file(
     ) const
     {
-        return _file;
+        return _file.str();
+    }
+
+    path_id file_id(
+    ) const
+    {
+        return _file.id();
+    }
+};
+
+template <typename Id>
+class basic_hist_node;
+
+typedef basic_hist_node<uuid32::type> hist_node;
+
+typedef basic_node_input<hist_node> node_input;
+
+/**
+ * Mix a 64-bit value into a node key, byte by byte in the same FNV-1a
+ * sequence as path_table::hash so keys are stable across platforms.
+ */
+inline boost::uint64_t combine_key(
+    boost::uint64_t key,
+    boost::uint64_t value
+)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        key ^= (value >> (8 * i)) & 0xff;
+        key *= 1099511628211ULL;
     }
+
+    return key;
+}
+
+/**
+ * Forward edge from a node to one of its consumers. The links of a
+ * node's inputs live in the node's own block and are chained into the
+ * consumer list of each producer, so an edge is removed in O(1) when
+ * its consumer is released.
+ */
+template <typename Node>
+struct basic_consumer_link
+{
+    Node* node;
+    size_t input;
+    basic_consumer_link* prev;
+    basic_consumer_link* next;
 };
 
-class hist_node
+typedef basic_consumer_link<hist_node> consumer_link;
+
+/**
+ * Node of a basic_hist_graph, its uuid is of the type chosen by the
+ * graph's Id policy.
+ */
+template <typename Id>
+class basic_hist_node
 {
 public:
 
-    typedef std::vector<node_input> nodes_in_vector;
-    typedef std::vector<std::string> files_out_vector;
+    typedef Id uuid_type;
+    typedef basic_node_input<basic_hist_node> input_type;
+    typedef basic_consumer_link<basic_hist_node> link_type;
+    typedef array_ref<input_type> nodes_in_array;
+    typedef array_ref<path_ref> files_out_array;
 
 private:
 
-    int _uuid;
-    nodes_in_vector _nodes_in;
-    files_out_vector _files_out;
-    std::string _command;
+    Id _uuid;
+    size_t _refs;
+    boost::uint64_t _key;
+    nodes_in_array _nodes_in;
+    files_out_array _files_out;
+    const command_entry* _command;
+    link_type* _links;
+    link_type* _consumers;
 
 public:
 
-    template <typename ITO>
-    hist_node(
-        int uuid,
-        const std::string& command,
-        ITO files_out_begin,
-        ITO files_out_end
+    // The node only references its input and output arrays and its
+    // command, hist_graph places the arrays in the same arena block
+    // right after the node and interns the command in its store, so
+    // the node is trivially destructible
+
+    basic_hist_node(
+        Id uuid,
+        const command_entry* command,
+        const path_ref* files_out_begin,
+        const path_ref* files_out_end
     ) :
         _uuid(uuid),
+        _refs(0),
+        _key(0),
         _nodes_in(),
         _files_out(files_out_begin, files_out_end),
-        _command(command)
+        _command(command),
+        _links(0),
+        _consumers(0)
     {
     }
 
-    template <typename ITN, typename ITO>
-    hist_node(
-        int uuid,
-        ITN nodes_in_begin,
-        ITN nodes_in_end,
-        const std::string& command,
-        ITO files_out_begin,
-        ITO files_out_end
+    basic_hist_node(
+        Id uuid,
+        const input_type* nodes_in_begin,
+        const input_type* nodes_in_end,
+        const command_entry* command,
+        const path_ref* files_out_begin,
+        const path_ref* files_out_end,
+        link_type* links = 0
     ) :
         _uuid(uuid),
+        _refs(0),
+        _key(0),
         _nodes_in(nodes_in_begin, nodes_in_end),
         _files_out(files_out_begin, files_out_end),
-        _command(command)
+        _command(command),
+        _links(links),
+        _consumers(0)
     {
     }
 
-    const int& uuid(
+    const Id& uuid(
     ) const
     {
         return _uuid;
     }
 
-    int& uuid(
+    Id& uuid(
     )
     {
         return _uuid;
     }
 
-    const nodes_in_vector& nodes_in(
+    const size_t& refs(
+    ) const
+    {
+        return _refs;
+    }
+
+    size_t& refs(
+    )
+    {
+        return _refs;
+    }
+
+    /**
+     * Merkle key of the step: the command and, for every input, its
+     * file and the key of the node that produced it. Equal keys mean
+     * the same command ran on the same history.
+     */
+    const boost::uint64_t& key(
+    ) const
+    {
+        return _key;
+    }
+
+    boost::uint64_t& key(
+    )
+    {
+        return _key;
+    }
+
+    const nodes_in_array& nodes_in(
     ) const
     {
         return _nodes_in;
     }
 
-    const files_out_vector& files_out(
+    const files_out_array& files_out(
     ) const
     {
         return _files_out;
     }
 
-    const std::string& command(
+    command_ref command(
     ) const
     {
-        return _command;
+        return command_ref(_command);
+    }
+
+    /**
+     * One link per input, owned by this node.
+     */
+    link_type* links(
+    )
+    {
+        return _links;
+    }
+
+    /**
+     * First link of the list of nodes consuming this one.
+     */
+    const link_type* consumers(
+    ) const
+    {
+        return _consumers;
     }
 
-    virtual ~hist_node()
+    link_type*& consumers(
+    )
     {
+        return _consumers;
     }
 };
 
-class hist_graph
+class hist_step
 {
+public:
+
+    typedef std::vector<std::string> file_vector;
+
 private:
 
-    typedef std::vector<hist_node*> node_vector;
-    typedef std::map<std::string, hist_node*> file_map;
+    file_vector _files_in;
+    std::string _command;
+    file_vector _files_out;
 
-    int _uuid;
-    node_vector _nodes;
-    file_map _inputs;
+public:
 
-    const hist_node* add_node(
-        hist_node* node
-    )
+    template <typename ITO>
+    hist_step(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    ) :
+        _files_in(),
+        _command(command),
+        _files_out(files_out_begin, files_out_end)
     {
-        if (node->files_out().size() == 0)
-        {
-            EX3_THROW(empty_output_exception());
-        }
-
-        _nodes.push_back(node);
-        _uuid++;
+    }
 
-        for (size_t i = 0; i < node->files_out().size(); i++)
-            _inputs[node->files_out()[i]] = node;
+    template <typename ITF, typename ITO>
+    hist_step(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    ) :
+        _files_in(files_in_begin, files_in_end),
+        _command(command),
+        _files_out(files_out_begin, files_out_end)
+    {
+    }
 
-        prune();
+    const file_vector& files_in(
+    ) const
+    {
+        return _files_in;
+    }
 
-        return node;
+    const std::string& command(
+    ) const
+    {
+        return _command;
     }
 
-    void visit(
-        std::vector<int>& visited,
-        const hist_node* node
+    const file_vector& files_out(
     ) const
     {
-        visited[node->uuid()] = 1;
+        return _files_out;
+    }
+};
 
-        for (size_t i = 0; i < node->nodes_in().size(); i++)
-            visit(visited, node->nodes_in()[i].node());
+/**
+ * Graph of the steps that produced each file, configured at compile
+ * time by its policies:
+ *
+ * Stats receives the instrumentation hooks, see null_stats and
+ * counting_stats.
+ *
+ * Pruning decides when released nodes are destroyed and the node
+ * vector compacted, and how much of that work each push does, see
+ * eager_pruning, deferred_pruning, incremental_pruning,
+ * generational_pruning and no_pruning.
+ *
+ * Allocator provides the node blocks, see node_arena and
+ * heap_node_allocator.
+ *
+ * Locking guards every public call, see single_threaded and serialized.
+ *
+ * Retention decides how many overwritten versions of each file stay
+ * queryable as "file@vN", see no_retention and version_retention.
+ *
+ * Ids chooses the type of the node uuids, see uuid32 and uuid64.
+ */
+template <
+    typename Stats = null_stats,
+    typename Pruning = eager_pruning,
+    typename Allocator = node_arena,
+    typename Locking = single_threaded,
+    typename Retention = no_retention,
+    typename Ids = uuid32
+>
+class basic_hist_graph
+{
+public:
+
+    typedef typename Ids::type uuid_type;
+    typedef basic_hist_node<uuid_type> node_type;
+    typedef Stats stats_type;
+    typedef Pruning pruning_type;
+    typedef Allocator allocator_type;
+    typedef Locking locking_type;
+    typedef Retention retention_type;
+
+private:
+
+    typedef typename node_type::input_type input_type;
+    typedef typename node_type::link_type link_type;
+
+    typedef std::vector<node_type*> node_vector;
+    typedef std::vector<node_type*> binding_vector;
+
+    uuid_type _uuid;
+    size_t _num_released;
+    Allocator _arena;
+    command_store _commands;
+    node_vector _nodes;
+    path_table _paths;
+    binding_vector _inputs;
+    std::vector<size_t> _batch_marks;
+    size_t _batch;
+    size_t _revision;
+    mutable size_t _snapshot_revision;
+    mutable boost::shared_ptr<hist_snapshot> _snapshot;
+    mutable Stats _stats;
+    Pruning _pruning;
+    std::vector<node_type*> _garbage;
+    bool _compacting;
+    size_t _compact_read;
+    size_t _compact_write;
+    size_t _young_begin;
+    size_t _young_released;
+    mutable Locking _locking;
+    Retention _retention;
+    std::vector<boost::uint32_t> _generations;
+    boost::unordered_map<boost::uint64_t, node_type*> _versions;
+    std::deque<boost::uint64_t> _version_log;
+
+    static boost::uint64_t version_key(
+        path_id id,
+        boost::uint32_t generation
+    )
+    {
+        return (static_cast<boost::uint64_t>(id) << 32) | generation;
     }
 
-    void prune(
+    static size_t node_size(
+        size_t num_nodes_in,
+        size_t num_files_out
     )
     {
-        const size_t num_nodes = _nodes.size();
-        std::vector<int> visited(num_nodes, 0);
+        return sizeof(node_type) +
+            num_nodes_in * sizeof(input_type) +
+            num_files_out * sizeof(path_ref) +
+            num_nodes_in * sizeof(link_type);
+    }
 
-        for (file_map::const_iterator it = _inputs.begin(); it != _inputs.end(); it++)
-            visit(visited, it->second);
+    boost::uint64_t node_key(
+        const string_ref& command,
+        const std::vector<input_type>& nodes_in
+    ) const
+    {
+        boost::uint64_t key = path_table::hash(command);
 
-        _uuid = 0;
-        size_t j = 0;
-        for (size_t i = 0; i < num_nodes; i++)
+        for (size_t i = 0; i < nodes_in.size(); i++)
         {
-            std::swap(_nodes[j], _nodes[i]);
-            std::swap(visited[j], visited[i]);
+            key = combine_key(key, _paths.hash_of(nodes_in[i].file_id()));
+            key = combine_key(key, nodes_in[i].node()->key());
+        }
 
-            _nodes[j]->uuid() = _uuid;
+        return key;
+    }
 
-            if (visited[j])
-            {
-                j++;
-                _uuid++;
-            }
+    node_type* create_node(
+        const std::vector<input_type>& nodes_in,
+        const string_ref& command,
+        const std::vector<path_ref>& files_out
+    )
+    {
+        const size_t size = node_size(nodes_in.size(), files_out.size());
+        char* block = static_cast<char*>(_arena.allocate(size));
+
+        input_type* nodes_in_begin = reinterpret_cast<input_type*>(
+            block + sizeof(node_type));
+        input_type* nodes_in_end = std::uninitialized_copy(
+            nodes_in.begin(), nodes_in.end(), nodes_in_begin);
+
+        path_ref* files_out_begin = reinterpret_cast<path_ref*>(
+            nodes_in_end);
+        path_ref* files_out_end = std::uninitialized_copy(
+            files_out.begin(), files_out.end(), files_out_begin);
+
+        link_type* links = reinterpret_cast<link_type*>(
+            files_out_end);
+
+        const command_entry* entry = 0;
+
+        try
+        {
+            entry = _commands.acquire(command);
+        }
+        catch (...)
+        {
+            _arena.deallocate(block, size);
+            throw;
         }
 
-        for (size_t i = j; i < num_nodes; i++)
-            delete _nodes[i];
+        node_type* node = new (block) node_type(_uuid, nodes_in_begin,
+            nodes_in_end, entry, files_out_begin, files_out_end, links);
 
-        _nodes.resize(j);
+        node->key() = node_key(command, nodes_in);
+
+        return node;
     }
 
-    const hist_node* try_get_hist_node(
-        const std::string& file
-    ) const
+    void destroy_node(
+        node_type* node
+    )
     {
-        file_map::const_iterator it = _inputs.find(file);
-
-        if (it == _inputs.end())
-            return 0;
+        const size_t size = node_size(node->nodes_in().size(),
+            node->files_out().size());
 
-        return it->second;
+        _commands.release(node->command().entry());
+        _arena.deallocate(node, size);
     }
 
-public:
+    void reserve_nodes(
+        size_t count
+    )
+    {
+        // Reserve before the nodes are created so pushing them into
+        // the node vector cannot fail halfway through
 
-    hist_graph(
-    ) :
-        _uuid(0),
-        _nodes(),
-        _inputs()
+        if (_nodes.capacity() - _nodes.size() < count)
+            _nodes.reserve(std::max(2 * _nodes.size(), _nodes.size() + count));
+    }
+
+    void link_node(
+        node_type* node,
+        std::vector<node_type*>& shadowed
+    )
     {
+        // Each live consumer and each file binding holds one reference
+        // to a node, inputs are acquired before the outputs are rebound
+        // so a step that overwrites its own input keeps it alive
+
+        link_inputs(node);
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            bind(node->files_out()[i].id(), node, shadowed);
     }
 
-    template <typename ITF, typename ITO>
-    const hist_node* push_node(
-        ITF files_in_begin,
-        ITF files_in_end,
-        const std::string& command,
-        ITO files_out_begin,
-        ITO files_out_end
+    void link_inputs(
+        node_type* node
     )
     {
-        std::vector<node_input> nodes_in;
+        _nodes.push_back(node);
+        _uuid++;
+        _revision++;
 
-        for (ITF file_it = files_in_begin; file_it != files_in_end; file_it++)
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
         {
-            const std::string& file = *file_it;
+            node_type* input = _nodes[node->nodes_in()[i].node()->uuid()];
+            link_type* link = &node->links()[i];
 
-            file_map::const_iterator it = _inputs.find(file);
-
-            if (it == _inputs.end())
-            {
-                EX3_THROW(input_not_found_exception()
-                    << input_value(file));
-            }
+            input->refs()++;
 
-            node_input node_in(it->second, it->first);
-            nodes_in.push_back(node_in);
-        }
+            link->node = node;
+            link->input = i;
+            link->prev = 0;
+            link->next = input->consumers();
 
-        hist_node* node = new hist_node(_uuid, nodes_in.begin(),
-            nodes_in.end(), command, files_out_begin, files_out_end);
+            if (link->next != 0)
+                link->next->prev = link;
 
-        return add_node(node);
+            input->consumers() = link;
+        }
     }
 
-    template <typename ITO>
-    const hist_node* push_node(
-        const std::string& command,
-        ITO files_out_begin,
-        ITO files_out_end
+    void bind(
+        path_id id,
+        node_type* node,
+        std::vector<node_type*>& shadowed
     )
     {
-        hist_node* node = new hist_node(_uuid, command,
-            files_out_begin, files_out_end);
+        node_type*& bound = _inputs[id];
 
-        return add_node(node);
-    }
+        node->refs()++;
 
-    template <typename Printer>
-    void print(
-        Printer& printer
-    ) const
-    {
-        for (size_t i = 0; i < _nodes.size(); i++)
-            printer(_nodes[i]);
+        if (Retention::enabled)
+            retain_version(id, bound, shadowed);
+
+        if (bound != 0)
+            shadowed.push_back(bound);
+
+        bound = node;
     }
 
-    template <typename ITF, typename ITN>
-    bool track(
-        ITF files_begin,
-        ITF files_end,
-        ITN nodes_out,
-        bool ignore_missing
-    ) const
+    void retain_version(
+        path_id id,
+        node_type* previous,
+        std::vector<node_type*>& shadowed
+    )
     {
-        bool found_all = true;
+        // The producer of the overwritten version gets a reference of
+        // its own, and versions that fall out of the retention limits
+        // are released with the shadowed nodes
 
-        const size_t num_nodes = _nodes.size();
-        std::vector<int> visited(num_nodes, 0);
+        _generations.resize(_paths.size(), 0);
 
-        for (ITF file_it = files_begin; file_it != files_end; file_it++)
-        {
-            const std::string& file = *file_it;
+        const boost::uint32_t generation = _generations[id]++;
 
-            const hist_node* node_in = try_get_hist_node(file);
+        if (previous == 0)
+            return;
 
-            if (node_in == 0)
-            {
-                if (ignore_missing)
-                    continue;
+        // generation is now the number of the overwritten version
 
-                EX3_THROW(input_not_found_exception()
-                    << input_value(file));
-            }
+        previous->refs()++;
+
+        const boost::uint64_t key = version_key(id, generation);
+        _versions[key] = previous;
+        _version_log.push_back(key);
 
-            visit(visited, node_in);
+        if (generation > _retention.per_path())
+            drop_version(version_key(id, static_cast<boost::uint32_t>(
+                generation - _retention.per_path())), shadowed);
+
+        while (_versions.size() > _retention.total())
+        {
+            drop_version(_version_log.front(), shadowed);
+            _version_log.pop_front();
         }
 
-        for(size_t i = 0; i < num_nodes; i++)
+        // Versions dropped by the per-path limit leave stale keys in
+        // the log, rebuild it when they outnumber the retained ones
+
+        if (_version_log.size() > 2 * _versions.size() + 64)
         {
-            if (visited[i])
-            {
-                const hist_node* node = _nodes[i];
-                *nodes_out = node;
-                nodes_out++;
-            }
+            std::deque<boost::uint64_t> log;
+
+            for (size_t i = 0; i < _version_log.size(); i++)
+                if (_versions.count(_version_log[i]) != 0)
+                    log.push_back(_version_log[i]);
+
+            _version_log.swap(log);
         }
     }
 
-    bool has_input(
-        const std::string& file
-    ) const
+    void remap_versions(
+        const std::vector<path_id>& ids,
+        size_t num_paths
+    )
     {
-        return try_get_hist_node(file) != 0;
+        // Retained versions keep their files bound, so only the stale
+        // keys of the log can name a dropped path
+
+        std::vector<boost::uint32_t> generations(num_paths, 0);
+
+        for (size_t id = 0; id < _generations.size(); id++)
+            if (ids[id] != invalid_path_id)
+                generations[ids[id]] = _generations[id];
+
+        boost::unordered_map<boost::uint64_t, node_type*> versions;
+
+        for (typename boost::unordered_map<boost::uint64_t, node_type*>::
+            const_iterator it = _versions.begin(); it != _versions.end();
+            it++)
+            versions[remap_version(ids, it->first)] = it->second;
+
+        std::deque<boost::uint64_t> log;
+
+        for (size_t i = 0; i < _version_log.size(); i++)
+            if (_versions.count(_version_log[i]) != 0)
+                log.push_back(remap_version(ids, _version_log[i]));
+
+        _generations.swap(generations);
+        _versions.swap(versions);
+        _version_log.swap(log);
     }
 
-    virtual ~hist_graph(
+    static boost::uint64_t remap_version(
+        const std::vector<path_id>& ids,
+        boost::uint64_t key
     )
     {
-        for (size_t i = 0; i < _nodes.size(); i++)
-            delete _nodes[i];
+        return version_key(ids[static_cast<size_t>(key >> 32)],
+            static_cast<boost::uint32_t>(key));
     }
-};
-
-class hist_node_print_to_stream
-{
-private:
 
-    std::ostream* _p_stream;
+    void drop_version(
+        boost::uint64_t key,
+        std::vector<node_type*>& shadowed
+    )
+    {
+        typename boost::unordered_map<boost::uint64_t, node_type*>::iterator
+            it = _versions.find(key);
 
-public:
+        if (it == _versions.end())
+            return;
 
-    hist_node_print_to_stream(
-        std::ostream* p_stream
-    ) :
-        _p_stream(p_stream)
-    {
-        if (_p_stream == 0)
-        {
-            EX3_THROW(null_value_exception()
-                << argument_name("p_stream"));
-        }
+        shadowed.push_back(it->second);
+        _versions.erase(it);
     }
 
-    void operator ()(
-        const hist_node* node
-    )
+    const node_type* find_version(
+        const std::string& file,
+        path_id& id
+    ) const
     {
-        for (size_t i = 0; i < node->nodes_in().size(); i++)
-        {
-            const node_input& input = node->nodes_in()[i];
+        // Parse "file@vN", N counts the bindings of the file from 1
 
+        id = invalid_path_id;
+
+        const size_t at = file.rfind("@v");
+
+        if (at == std::string::npos || at + 2 == file.size() ||
+            file.size() - at > 12)
+            return 0;
+
+        boost::uint64_t generation = 0;
+
+        for (size_t i = at + 2; i < file.size(); i++)
+        {
+            if (file[i] < '0' || file[i] > '9')
+                return 0;
+
+            generation = 10 * generation +
+                static_cast<boost::uint64_t>(file[i] - '0');
+        }
+
+        const path_id base = _paths.find(string_ref(file.data(), at));
+
+        if (base == invalid_path_id || base >= _generations.size() ||
+            generation == 0 || generation > _generations[base])
+            return 0;
+
+        id = base;
+
+        if (generation == _generations[base])
+            return _inputs[base];
+
+        typename boost::unordered_map<boost::uint64_t, node_type*>::
+            const_iterator it = _versions.find(version_key(base,
+                static_cast<boost::uint32_t>(generation)));
+
+        return it == _versions.end() ? 0 : it->second;
+    }
+
+    const node_type* add_node(
+        node_type* node
+    )
+    {
+        std::vector<node_type*> shadowed;
+        link_node(node, shadowed);
+        _stats.add_pushed(1);
+
+        release_all(shadowed);
+
+        return node;
+    }
+
+    template <typename Node>
+    bool same_node(
+        const node_type* node,
+        const Node* other,
+        const std::string& command,
+        const std::vector<input_type>& nodes_in
+    ) const
+    {
+        if (node->nodes_in().size() != nodes_in.size() ||
+            node->files_out().size() != other->files_out().size() ||
+            !(node->command() == command))
+            return false;
+
+        for (size_t i = 0; i < nodes_in.size(); i++)
+            if (node->nodes_in()[i].node() != nodes_in[i].node() ||
+                node->nodes_in()[i].file_id() != nodes_in[i].file_id())
+                return false;
+
+        for (size_t i = 0; i < other->files_out().size(); i++)
+            if (node->files_out()[i].str() != other->files_out()[i].str())
+                return false;
+
+        return true;
+    }
+
+    template <typename Graph>
+    size_t merge_graph(
+        const Graph& graph,
+        merge_policy policy,
+        boost::unordered_map<boost::uint64_t, node_type*>& index,
+        bool add_to_index,
+        std::vector<node_type*>& shadowed
+    )
+    {
+        // Live nodes are visited in uuid order, so the inputs of a node
+        // are merged before it. Created nodes hold one reference in
+        // shadowed until the end of the merge, so the ones left without
+        // a binding or a consumer are released by the single prune
+
+        typedef typename Graph::node_type other_type;
+
+        std::vector<const other_type*> nodes;
+        detail::node_collector<other_type> collector(&nodes);
+        graph.print(collector);
+
+        if (nodes.empty())
+            return 0;
+
+        std::vector<node_type*> merged(static_cast<size_t>(
+            nodes.back()->uuid()) + 1, static_cast<node_type*>(0));
+        std::vector<path_id> path_ids(graph.paths().size(), invalid_path_id);
+
+        std::vector<input_type> nodes_in;
+        std::vector<path_ref> files_out;
+        size_t num_created = 0;
+
+        const uuid_type first_uuid = _uuid;
+
+        reserve_nodes(nodes.size());
+
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            const other_type* other = nodes[n];
+            const std::string command = other->command().str();
+
+            // A node with an input created from this graph cannot have a
+            // duplicate, so only the others are looked up
+
+            bool created_input = false;
+
+            nodes_in.clear();
+
+            for (size_t i = 0; i < other->nodes_in().size(); i++)
+            {
+                node_type* input = merged[static_cast<size_t>(
+                    other->nodes_in()[i].node()->uuid())];
+
+                created_input = created_input || input->uuid() >= first_uuid;
+
+                nodes_in.push_back(input_type(input, _paths.ref(merge_path(
+                    graph, other->nodes_in()[i].file_id(), path_ids))));
+            }
+
+            files_out.clear();
+
+            for (size_t i = 0; i < other->files_out().size(); i++)
+                files_out.push_back(_paths.ref(merge_path(graph,
+                    other->files_out()[i].id(), path_ids)));
+
+            node_type* node = 0;
+
+            if (!created_input)
+            {
+                typename boost::unordered_map<boost::uint64_t, node_type*>::
+                    iterator it = index.find(node_key(command, nodes_in));
+
+                if (it != index.end() &&
+                    same_node(it->second, other, command, nodes_in))
+                    node = it->second;
+            }
+
+            if (node == 0)
+            {
+                node = create_node(nodes_in, command, files_out);
+                link_inputs(node);
+
+                node->refs()++;
+                shadowed.push_back(node);
+
+                if (add_to_index)
+                    index[node->key()] = node;
+
+                num_created++;
+            }
+
+            merged[static_cast<size_t>(other->uuid())] = node;
+
+            for (size_t i = 0; i < files_out.size(); i++)
+            {
+                const path_id id = files_out[i].id();
+
+                if (graph.binding(other->files_out()[i].id()) != other ||
+                    _inputs[id] == node ||
+                    (policy == merge_first_writer && _inputs[id] != 0))
+                    continue;
+
+                bind(id, node, shadowed);
+            }
+        }
+
+        return num_created;
+    }
+
+    template <typename Graph>
+    path_id merge_path(
+        const Graph& graph,
+        path_id id,
+        std::vector<path_id>& path_ids
+    )
+    {
+        // Each path of the other graph is interned once
+
+        path_id& merged = path_ids[id];
+
+        if (merged == invalid_path_id)
+        {
+            _stats.add_lookups(1);
+
+            merged = _paths.intern(string_ref(graph.paths().str(id)));
+            grow_paths();
+        }
+
+        return merged;
+    }
+
+    void release_all(
+        const std::vector<node_type*>& shadowed
+    )
+    {
+        const typename Stats::timer timer = _stats.start();
+
+        for (size_t i = 0; i < shadowed.size(); i++)
+            release(shadowed[i]);
+
+        if (_pruning.should_collect(_garbage.size(), num_live_nodes()))
+            collect_garbage(false);
+
+        _stats.finish(timer, op_prune);
+        _stats.sample(*this);
+    }
+
+    void collect_garbage(
+        bool force
+    )
+    {
+        // Destroying a node and moving the compaction past a slot cost
+        // one unit each of the budget of the pruning policy, a forced
+        // collection runs to completion
+
+        size_t budget = force ? static_cast<size_t>(-1) : _pruning.budget();
+
+        while (!_garbage.empty() && budget != 0)
+        {
+            destroy_node(_garbage.back());
+            _garbage.pop_back();
+            budget--;
+        }
+
+        if (_compacting)
+            compact(budget);
+
+        if (!_compacting && start_compaction(force))
+            compact(budget);
+    }
+
+    size_t num_live_nodes(
+    ) const
+    {
+        return _nodes.size() - _num_released;
+    }
+
+    void visit(
+        std::vector<bool>& visited,
+        std::vector<const node_type*>& pending,
+        const node_type* node
+    ) const
+    {
+        // Iterative depth-first walk, nodes are marked when they are
+        // pushed so every node and edge is expanded at most once
+
+        if (visited[node->uuid()])
+            return;
+
+        visited[node->uuid()] = true;
+        pending.push_back(node);
+
+        while (!pending.empty())
+        {
+            const node_type* next = pending.back();
+            pending.pop_back();
+
+            _stats.add_edges(next->nodes_in().size());
+
+            for (size_t i = 0; i < next->nodes_in().size(); i++)
+            {
+                const node_type* input = next->nodes_in()[i].node();
+
+                if (!visited[input->uuid()])
+                {
+                    visited[input->uuid()] = true;
+                    pending.push_back(input);
+                }
+            }
+        }
+    }
+
+    void visit_consumers(
+        boost::unordered_set<const node_type*>& visited,
+        std::vector<std::pair<const node_type*, const link_type*> >& pending,
+        std::vector<const node_type*>& finished,
+        const node_type* node
+    ) const
+    {
+        // Iterative depth-first walk over the consumer lists, a node is
+        // finished after all of its consumers so the reversed sequence
+        // is a topological order of the affected nodes
+
+        if (!visited.insert(node).second)
+            return;
+
+        pending.push_back(std::make_pair(node, node->consumers()));
+
+        while (!pending.empty())
+        {
+            const link_type* link = pending.back().second;
+
+            if (link == 0)
+            {
+                finished.push_back(pending.back().first);
+                pending.pop_back();
+                continue;
+            }
+
+            pending.back().second = link->next;
+            _stats.add_edges(1);
+
+            if (visited.insert(link->node).second)
+                pending.push_back(std::make_pair(link->node,
+                    link->node->consumers()));
+        }
+    }
+
+    void release(
+        node_type* node
+    )
+    {
+        std::vector<node_type*> pending(1, node);
+
+        while (!pending.empty())
+        {
+            node_type* dead = pending.back();
+            pending.pop_back();
+
+            if (--dead->refs() != 0)
+                continue;
+
+            for (size_t i = 0; i < dead->nodes_in().size(); i++)
+            {
+                node_type* input = _nodes[dead->nodes_in()[i].node()->uuid()];
+                link_type* link = &dead->links()[i];
+
+                if (link->prev != 0)
+                    link->prev->next = link->next;
+                else
+                    input->consumers() = link->next;
+
+                if (link->next != 0)
+                    link->next->prev = link->prev;
+
+                pending.push_back(input);
+            }
+
+            // The node is unreachable from now on, the pruning policy
+            // decides when its block is returned to the allocator
+
+            _nodes[dead->uuid()] = 0;
+            _num_released++;
+
+            if (static_cast<size_t>(dead->uuid()) >= _young_begin)
+                _young_released++;
+            _stats.add_released();
+
+            _garbage.push_back(dead);
+        }
+    }
+
+    bool start_compaction(
+        bool force
+    )
+    {
+        // Released nodes leave holes in the node vector, the whole of it
+        // is compacted when the holes outnumber the live nodes so the
+        // renumbering is amortized over the pushes that created them.
+        // With a nursery, the nodes pushed since the last compaction are
+        // compacted on their own when most of them are holes, and every
+        // compaction promotes the nodes it moves past out of the nursery
+
+        const size_t num_nodes = _nodes.size();
+        const size_t num_young = num_nodes - _young_begin;
+        const size_t nursery = _pruning.nursery();
+
+        if (force || 2 * _num_released > num_nodes)
+            _compact_read = 0;
+        else if (nursery != 0 && num_young >= nursery &&
+            2 * _young_released > num_young)
+            _compact_read = _young_begin;
+        else
+            return false;
+
+        _compact_write = _compact_read;
+        _compacting = true;
+
+        return true;
+    }
+
+    void compact(
+        size_t& budget
+    )
+    {
+        // Nodes move down to the write cursor keeping their order, and
+        // the ones ahead of the read cursor keep their old uuids, so a
+        // uuid is the index of its node at every step. Nodes pushed in
+        // the meantime are appended past the read cursor
+
+        bool moved = false;
+
+        while (_compact_read < _nodes.size() && budget != 0)
+        {
+            node_type* node = _nodes[_compact_read];
+
+            if (node != 0)
+            {
+                if (_compact_write != _compact_read)
+                {
+                    _nodes[_compact_write] = node;
+                    _nodes[_compact_read] = 0;
+                    node->uuid() = static_cast<uuid_type>(_compact_write);
+                    moved = true;
+                }
+
+                _compact_write++;
+            }
+
+            _compact_read++;
+            budget--;
+        }
+
+        if (moved)
+            _revision++;
+
+        if (_compact_read < _nodes.size())
+            return;
+
+        _num_released -= _nodes.size() - _compact_write;
+        _nodes.resize(_compact_write);
+        _uuid = static_cast<uuid_type>(_compact_write);
+
+        _young_begin = _compact_write;
+        _young_released = 0;
+        _compacting = false;
+    }
+
+    const node_type* try_get_hist_node(
+        const std::string& file
+    ) const
+    {
+        path_id id;
+        return find_binding(file, id);
+    }
+
+    const node_type* find_binding(
+        const std::string& file,
+        path_id& id
+    ) const
+    {
+        _stats.add_lookups(1);
+
+        id = _paths.find(file);
+
+        if (id != invalid_path_id && _inputs[id] != 0)
+            return _inputs[id];
+
+        return Retention::enabled ? find_version(file, id) : 0;
+    }
+
+    template <typename ITO>
+    void intern_files_out(
+        ITO files_out_begin,
+        ITO files_out_end,
+        std::vector<path_ref>& files_out
+    )
+    {
+        if (files_out_begin == files_out_end)
+        {
+            EX3_THROW(empty_output_exception());
+        }
+
+        for (ITO file_it = files_out_begin; file_it != files_out_end; file_it++)
+            files_out.push_back(_paths.ref(_paths.intern(*file_it)));
+
+        grow_paths();
+    }
+
+    /**
+     * Keep the arrays indexed by path id as long as the path table.
+     */
+    void grow_paths(
+    )
+    {
+        _inputs.resize(_paths.size(), 0);
+        _batch_marks.resize(_paths.size(), 0);
+    }
+
+    template <typename ITF>
+    void resolve_files_in(
+        ITF files_in_begin,
+        ITF files_in_end,
+        std::vector<input_type>& nodes_in
+    ) const
+    {
+        for (ITF file_it = files_in_begin; file_it != files_in_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            _stats.add_lookups(1);
+
+            const path_id id = _paths.find(file);
+
+            if (id == invalid_path_id || _inputs[id] == 0)
+            {
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            input_type node_in(_inputs[id], _paths.ref(id));
+            nodes_in.push_back(node_in);
+        }
+    }
+
+public:
+
+    basic_hist_graph(
+        command_store::encoding encoding = command_store::encoding_plain,
+        const Pruning& pruning = Pruning(),
+        const Retention& retention = Retention()
+    ) :
+        _uuid(0),
+        _num_released(0),
+        _arena(),
+        _commands(encoding),
+        _nodes(),
+        _paths(),
+        _inputs(),
+        _batch_marks(),
+        _batch(0),
+        _revision(0),
+        _snapshot_revision(static_cast<size_t>(-1)),
+        _snapshot(),
+        _stats(),
+        _pruning(pruning),
+        _garbage(),
+        _compacting(false),
+        _compact_read(0),
+        _compact_write(0),
+        _young_begin(0),
+        _young_released(0),
+        _locking(),
+        _retention(retention),
+        _generations(),
+        _versions(),
+        _version_log()
+    {
+    }
+
+    template <typename ITF, typename ITO>
+    const node_type* push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        std::vector<input_type> nodes_in;
+        resolve_files_in(files_in_begin, files_in_end, nodes_in);
+
+        std::vector<path_ref> files_out;
+        intern_files_out(files_out_begin, files_out_end, files_out);
+
+        reserve_nodes(1);
+
+        const node_type* node = add_node(create_node(nodes_in, command,
+            files_out));
+
+        _stats.finish(timer, op_push);
+
+        return node;
+    }
+
+    template <typename ITO>
+    const node_type* push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        std::vector<path_ref> files_out;
+        intern_files_out(files_out_begin, files_out_end, files_out);
+
+        reserve_nodes(1);
+
+        const node_type* node = add_node(create_node(
+            std::vector<input_type>(), command, files_out));
+
+        _stats.finish(timer, op_push);
+
+        return node;
+    }
+
+    /**
+     * Push a range of steps as if each one was pushed in order, but
+     * validate all of them before any node is created and release the
+     * nodes shadowed by the batch in a single pass at the end. Inputs
+     * are resolved against the outputs of earlier steps in the range
+     * first and then against the graph. The steps must provide
+     * files_in(), command() and files_out() like hist_step and the
+     * range is traversed twice. If the batch is rejected the graph is
+     * left unchanged, although its output paths remain interned until
+     * compact_paths is called.
+     */
+    template <typename ITS>
+    size_t push_batch(
+        ITS steps_begin,
+        ITS steps_end
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        // Paths bound by earlier steps of the batch are stamped with the
+        // batch number instead of being bound, so the validation does
+        // not touch the bindings
+
+        const typename Stats::timer timer = _stats.start();
+
+        std::vector<path_id> resolved;
+        size_t num_steps = 0;
+
+        _batch++;
+
+        for (ITS step_it = steps_begin; step_it != steps_end; step_it++)
+        {
+            for (size_t i = 0; i < step_it->files_in().size(); i++)
+            {
+                const std::string& file = step_it->files_in()[i];
+
+                _stats.add_lookups(1);
+
+                const path_id id = _paths.find(file);
+
+                if (id == invalid_path_id ||
+                    (_inputs[id] == 0 && _batch_marks[id] != _batch))
+                {
+                    EX3_THROW(input_not_found_exception()
+                        << input_value(file));
+                }
+
+                resolved.push_back(id);
+            }
+
+            if (step_it->files_out().size() == 0)
+            {
+                EX3_THROW(empty_output_exception());
+            }
+
+            for (size_t i = 0; i < step_it->files_out().size(); i++)
+            {
+                const path_id id = _paths.intern(step_it->files_out()[i]);
+
+                grow_paths();
+                _batch_marks[id] = _batch;
+
+                resolved.push_back(id);
+            }
+
+            num_steps++;
+        }
+
+        std::vector<node_type*> shadowed;
+        std::vector<input_type> nodes_in;
+        std::vector<path_ref> files_out;
+        std::vector<path_id>::const_iterator id_it = resolved.begin();
+
+        reserve_nodes(num_steps);
+
+        for (ITS step_it = steps_begin; step_it != steps_end; step_it++)
+        {
+            nodes_in.clear();
+
+            for (size_t i = 0; i < step_it->files_in().size(); i++, id_it++)
+                nodes_in.push_back(input_type(_inputs[*id_it],
+                    _paths.ref(*id_it)));
+
+            files_out.clear();
+
+            for (size_t i = 0; i < step_it->files_out().size(); i++, id_it++)
+                files_out.push_back(_paths.ref(*id_it));
+
+            link_node(create_node(nodes_in, step_it->command(), files_out),
+                shadowed);
+        }
+
+        _stats.add_pushed(num_steps);
+
+        release_all(shadowed);
+
+        _stats.finish(timer, op_push_batch);
+
+        return num_steps;
+    }
+
+    /**
+     * Push a range of steps like push_batch, but resolve each input
+     * through sources(), the position in the range of the step that
+     * produced it, instead of through the bindings. This rebuilds a
+     * printed graph where a file may have been rebound after it was
+     * read, so the steps only need files_in(), sources(), command() and
+     * files_out() that compare and convert like string_ref.
+     */
+    template <typename ITS>
+    size_t push_linked_batch(
+        ITS steps_begin,
+        ITS steps_end
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        // The ids of the outputs of each step are interned during the
+        // validation and followed by the ids of its inputs in resolved,
+        // the outputs of a step start at offsets[step]
+
+        const typename Stats::timer timer = _stats.start();
+
+        std::vector<path_id> resolved;
+        std::vector<size_t> offsets;
+        std::vector<size_t> num_out;
+
+        for (ITS step_it = steps_begin; step_it != steps_end; step_it++)
+        {
+            const size_t num_steps = offsets.size();
+
+            offsets.push_back(resolved.size());
+            num_out.push_back(step_it->files_out().size());
+
+            if (step_it->files_out().size() == 0)
+            {
+                EX3_THROW(empty_output_exception());
+            }
+
+            for (size_t i = 0; i < step_it->files_out().size(); i++)
+            {
+                resolved.push_back(_paths.intern(step_it->files_out()[i]));
+                grow_paths();
+            }
+
+            if (step_it->sources().size() != step_it->files_in().size())
+            {
+                EX3_THROW(invalid_format_exception());
+            }
+
+            for (size_t i = 0; i < step_it->files_in().size(); i++)
+            {
+                const size_t source = step_it->sources()[i];
+
+                _stats.add_lookups(1);
+
+                const path_id id = _paths.find(step_it->files_in()[i]);
+
+                if (source >= num_steps || id == invalid_path_id ||
+                    std::find(&resolved[offsets[source]],
+                        &resolved[offsets[source]] + num_out[source], id) ==
+                        &resolved[offsets[source]] + num_out[source])
+                {
+                    EX3_THROW(input_not_found_exception()
+                        << input_value(string_ref(
+                            step_it->files_in()[i]).str()));
+                }
+
+                resolved.push_back(id);
+            }
+        }
+
+        const size_t num_steps = offsets.size();
+
+        std::vector<node_type*> created;
+        std::vector<node_type*> shadowed;
+        std::vector<input_type> nodes_in;
+        std::vector<path_ref> files_out;
+        std::vector<path_id>::const_iterator id_it = resolved.begin();
+
+        reserve_nodes(num_steps);
+        created.reserve(num_steps);
+
+        for (ITS step_it = steps_begin; step_it != steps_end; step_it++)
+        {
+            files_out.clear();
+
+            for (size_t i = 0; i < step_it->files_out().size(); i++, id_it++)
+                files_out.push_back(_paths.ref(*id_it));
+
+            nodes_in.clear();
+
+            for (size_t i = 0; i < step_it->files_in().size(); i++, id_it++)
+                nodes_in.push_back(input_type(
+                    created[step_it->sources()[i]], _paths.ref(*id_it)));
+
+            node_type* node = create_node(nodes_in, step_it->command(),
+                files_out);
+
+            link_node(node, shadowed);
+            created.push_back(node);
+        }
+
+        _stats.add_pushed(num_steps);
+
+        release_all(shadowed);
+
+        _stats.finish(timer, op_push_batch);
+
+        return num_steps;
+    }
+
+    /**
+     * Unify other graphs into this one in a single pass over their live
+     * nodes, followed by a single release of the nodes that lost every
+     * binding. A node with the same command, inputs and outputs as a
+     * node already in the graph is merged into it, and policy decides
+     * which binding wins when several graphs bind the same path. The
+     * range holds pointers to the graphs, which may be of any type with
+     * the interface of basic_hist_graph, and returns the number of
+     * nodes created.
+     *
+     * Merging is not commutative under either policy, but it is
+     * associative, so shards can be merged pairwise in parallel into
+     * separate graphs and the results merged in shard order.
+     */
+    template <typename ITG>
+    size_t merge(
+        ITG graphs_begin,
+        ITG graphs_end,
+        merge_policy policy = merge_last_writer
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        // The nodes created from the last graph are not indexed
+
+        size_t num_nodes = _nodes.size();
+        size_t num_last = 0;
+
+        for (ITG graph_it = graphs_begin; graph_it != graphs_end; graph_it++)
+        {
+            num_nodes += num_last;
+            num_last = (*graph_it)->num_nodes();
+        }
+
+        boost::unordered_map<boost::uint64_t, node_type*> index;
+        index.reserve(num_nodes);
+
+        for (size_t i = 0; i < _nodes.size(); i++)
+            if (_nodes[i] != 0)
+                index[_nodes[i]->key()] = _nodes[i];
+
+        std::vector<node_type*> shadowed;
+        size_t num_created = 0;
+
+        for (ITG graph_it = graphs_begin; graph_it != graphs_end; )
+        {
+            ITG next_it = graph_it;
+            next_it++;
+
+            num_created += merge_graph(**graph_it, policy, index,
+                next_it != graphs_end, shadowed);
+
+            graph_it = next_it;
+        }
+
+        _revision++;
+        _stats.add_pushed(num_created);
+
+        release_all(shadowed);
+
+        _stats.finish(timer, op_push_batch);
+
+        return num_created;
+    }
+
+    template <typename Graph>
+    size_t merge(
+        const Graph& other,
+        merge_policy policy = merge_last_writer
+    )
+    {
+        const Graph* graphs = &other;
+        return merge(&graphs, &graphs + 1, policy);
+    }
+
+    template <typename Printer>
+    void print(
+        Printer& printer
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        for (size_t i = 0; i < _nodes.size(); i++)
+            if (_nodes[i] != 0)
+                printer(_nodes[i]);
+
+        _stats.finish(timer, op_print);
+    }
+
+    template <typename ITF, typename ITN>
+    bool track(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        bool found_all = true;
+
+        const size_t num_nodes = _nodes.size();
+        std::vector<bool> visited(num_nodes, false);
+        std::vector<const node_type*> pending;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const node_type* node_in = try_get_hist_node(file);
+
+            if (node_in == 0)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            visit(visited, pending, node_in);
+        }
+
+        for(size_t i = 0; i < num_nodes; i++)
+        {
+            if (visited[i])
+            {
+                const node_type* node = _nodes[i];
+                *nodes_out = node;
+                nodes_out++;
+            }
+        }
+
+        _stats.finish(timer, op_track);
+
+        return found_all;
+    }
+
+    /**
+     * Same as track, but the ancestors are marked by num_threads threads
+     * sharing one atomic bitmap. The output is emitted in the same uuid
+     * order, so it is identical to the output of track. Threads are
+     * started per call and only once the walk outgrows the calling
+     * thread, see parallel_visitor.
+     */
+    template <typename ITF, typename ITN>
+    bool track_parallel(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing,
+        size_t num_threads
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        if (num_threads <= 1)
+            return track(files_begin, files_end, nodes_out, ignore_missing);
+
+        const typename Stats::timer timer = _stats.start();
+
+        bool found_all = true;
+
+        std::vector<const node_type*> roots;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const node_type* node_in = try_get_hist_node(file);
+
+            if (node_in == 0)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            roots.push_back(node_in);
+        }
+
+        const size_t num_nodes = _nodes.size();
+        parallel_visitor<node_type> visitor(num_nodes);
+        visitor.run(roots.begin(), roots.end(), num_threads);
+
+        _stats.add_edges(visitor.num_edges());
+
+        for (size_t i = visitor.next(0); i < num_nodes; i = visitor.next(i + 1))
+        {
+            const node_type* node = _nodes[i];
+            *nodes_out = node;
+            nodes_out++;
+        }
+
+        _stats.finish(timer, op_track);
+
+        return found_all;
+    }
+
+    /**
+     * Lazy alternative to track that yields the ancestors of the files
+     * newest first and only expands the nodes actually consumed.
+     */
+    template <typename ITF>
+    provenance_range<node_type> ancestors(
+        ITF files_begin,
+        ITF files_end,
+        bool ignore_missing
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        provenance_range<node_type> range;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const node_type* node_in = try_get_hist_node(file);
+
+            if (node_in == 0)
+            {
+                if (ignore_missing)
+                {
+                    range.set_found_all(false);
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            range.add_root(node_in);
+        }
+
+        return range;
+    }
+
+    /**
+     * Output every node that must be rerun if the given files change:
+     * the nodes that read them from their current producers and all
+     * nodes downstream of those. Nodes are emitted in a valid rebuild
+     * order, every node after the affected nodes it consumes, and the
+     * cost is proportional to the number of affected nodes and edges.
+     */
+    template <typename ITF, typename ITN>
+    bool dependents(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        const typename Stats::timer timer = _stats.start();
+
+        bool found_all = true;
+
+        boost::unordered_set<const node_type*> visited;
+        std::vector<std::pair<const node_type*, const link_type*> >
+            pending;
+        std::vector<const node_type*> finished;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            path_id id;
+            const node_type* node_in = find_binding(file, id);
+
+            if (node_in == 0)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            for (const link_type* link = node_in->consumers(); link != 0;
+                link = link->next)
+            {
+                _stats.add_edges(1);
+
+                if (link->node->nodes_in()[link->input].file_id() == id)
+                    visit_consumers(visited, pending, finished, link->node);
+            }
+        }
+
+        for (size_t i = finished.size(); i > 0; i--)
+        {
+            *nodes_out = finished[i - 1];
+            nodes_out++;
+        }
+
+        _stats.finish(timer, op_dependents);
+
+        return found_all;
+    }
+
+    /**
+     * Key the node would get if the step was pushed now, the inputs
+     * must be bound.
+     */
+    template <typename ITF>
+    boost::uint64_t step_key(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        std::vector<input_type> nodes_in;
+        resolve_files_in(files_in_begin, files_in_end, nodes_in);
+
+        return node_key(command, nodes_in);
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return try_get_hist_node(file) != 0;
+    }
+
+    const path_table& paths(
+    ) const
+    {
+        return _paths;
+    }
+
+    const node_type* binding(
+        path_id file
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return _inputs[file];
+    }
+
+    /**
+     * Read-optimized CSR copy of the graph, rebuilt on the first call
+     * after the graph is modified. A copy still shared by a branch is
+     * left alone and a new one is built instead.
+     */
+    const hist_snapshot& snapshot(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        if (_snapshot_revision != _revision)
+        {
+            if (_snapshot.unique())
+                _snapshot->assign(*this);
+            else
+                _snapshot.reset(new hist_snapshot(*this));
+
+            _snapshot_revision = _revision;
+        }
+
+        return *_snapshot;
+    }
+
+    /**
+     * Copy-on-write branch sharing the snapshot of the graph, see
+     * hist_branch. Forking an unmodified graph again reuses the same
+     * snapshot and costs O(1), but the first fork after the graph is
+     * modified rebuilds the snapshot in O(N) for N nodes. To explore
+     * what-ifs while the graph keeps growing, fork the graph once and
+     * fork further from the branch.
+     */
+    hist_branch fork(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        snapshot();
+
+        return hist_branch(_snapshot);
+    }
+
+    const command_store& commands(
+    ) const
+    {
+        return _commands;
+    }
+
+    size_t bytes_used(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return _arena.bytes_used() + _commands.bytes_used();
+    }
+
+    size_t num_nodes(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return num_live_nodes();
+    }
+
+    /**
+     * Return the blocks of all released nodes to the allocator and
+     * compact the node vector, renumbering the live nodes.
+     */
+    void collect(
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        collect_garbage(true);
+    }
+
+    /**
+     * Collect the released nodes, then rebuild the path table with only
+     * the paths still referenced by a node or a binding, renumbering
+     * them in their current order. Return how many paths were dropped.
+     * Path ids obtained before the call are invalidated.
+     */
+    size_t compact_paths(
+    )
+    {
+        const typename Locking::guard guard(_locking);
+
+        collect_garbage(true);
+
+        std::vector<bool> used(_paths.size(), false);
+
+        for (size_t id = 0; id < _inputs.size(); id++)
+            used[id] = _inputs[id] != 0;
+
+        for (size_t i = 0; i < _nodes.size(); i++)
+        {
+            const node_type* node = _nodes[i];
+
+            for (size_t j = 0; j < node->nodes_in().size(); j++)
+                used[node->nodes_in()[j].file_id()] = true;
+
+            for (size_t j = 0; j < node->files_out().size(); j++)
+                used[node->files_out()[j].id()] = true;
+        }
+
+        path_table paths;
+        std::vector<path_id> ids(_paths.size(), invalid_path_id);
+
+        for (size_t id = 0; id < used.size(); id++)
+            if (used[id])
+                ids[id] = paths.intern(string_ref(_paths.str(
+                    static_cast<path_id>(id))));
+
+        const size_t num_dropped = _paths.size() - paths.size();
+
+        if (num_dropped == 0)
+            return 0;
+
+        // The nodes point into the old table, so every path they hold is
+        // replaced before the old table is released
+
+        for (size_t i = 0; i < _nodes.size(); i++)
+        {
+            node_type* node = _nodes[i];
+
+            for (size_t j = 0; j < node->nodes_in().size(); j++)
+            {
+                const input_type& input = node->nodes_in()[j];
+
+                const_cast<input_type&>(input) = input_type(input.node(),
+                    paths.ref(ids[input.file_id()]));
+            }
+
+            for (size_t j = 0; j < node->files_out().size(); j++)
+            {
+                const path_ref& file = node->files_out()[j];
+
+                const_cast<path_ref&>(file) = paths.ref(ids[file.id()]);
+            }
+        }
+
+        binding_vector inputs(paths.size(), 0);
+
+        for (size_t id = 0; id < _inputs.size(); id++)
+            if (_inputs[id] != 0)
+                inputs[ids[id]] = _inputs[id];
+
+        if (Retention::enabled)
+            remap_versions(ids, paths.size());
+
+        _paths.swap(paths);
+        _inputs.swap(inputs);
+        _batch_marks.assign(_paths.size(), 0);
+        _revision++;
+
+        return num_dropped;
+    }
+
+    size_t num_garbage(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return _garbage.size();
+    }
+
+    const Pruning& pruning(
+    ) const
+    {
+        return _pruning;
+    }
+
+    const Retention& retention(
+    ) const
+    {
+        return _retention;
+    }
+
+    /**
+     * Number of times the file has been bound, which is also the
+     * version number of its current binding. Only counted when the
+     * Retention policy is enabled, otherwise always zero.
+     */
+    size_t generation(
+        const std::string& file
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        const path_id id = _paths.find(file);
+
+        return id < _generations.size() ? _generations[id] : 0;
+    }
+
+    size_t num_retained_versions(
+    ) const
+    {
+        const typename Locking::guard guard(_locking);
+
+        return _versions.size();
+    }
+
+    Pruning& pruning(
+    )
+    {
+        return _pruning;
+    }
+
+    const Stats& stats(
+    ) const
+    {
+        return _stats;
+    }
+
+    Stats& stats(
+    )
+    {
+        return _stats;
+    }
+
+    virtual ~basic_hist_graph(
+    )
+    {
+        // Nodes are trivially destructible, an allocator that owns its
+        // blocks frees them in bulk along with the commands
+
+        if (!Allocator::owns_blocks)
+        {
+            for (size_t i = 0; i < _garbage.size(); i++)
+                destroy_node(_garbage[i]);
+
+            for (size_t i = 0; i < _nodes.size(); i++)
+                if (_nodes[i] != 0)
+                    destroy_node(_nodes[i]);
+        }
+    }
+};
+
+typedef basic_hist_graph<> hist_graph;
+
+class hist_node_print_to_stream
+{
+private:
+
+    std::ostream* _p_stream;
+
+public:
+
+    hist_node_print_to_stream(
+        std::ostream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+        if (_p_stream == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("p_stream"));
+        }
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
             (*_p_stream)
-                << input.file() << "("
-                << input.node()->uuid() << ") ";
+                << node->nodes_in()[i].file() << "("
+                << node->nodes_in()[i].node()->uuid() << ") ";
         }
 
         (*_p_stream) << node->command() << " ";
@@ -401,7 +2158,7 @@ public:
                 << node->uuid() << ") ";
         }
 
-        (*_p_stream) << std::endl;
+        (*_p_stream) << '\n';
     }
 };
 
@@ -0,0 +1,694 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "historian.hpp"
+#include "hist_file.hpp"
+#include "file_io.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+struct journal_options
+{
+    enum durability_level
+    {
+        // Records reach the OS when a group is full, nothing is synced
+        // before the journal is closed or compacted
+        durability_none,
+        // Every full group is written and synced with one fdatasync
+        durability_group,
+        // Every record is written and synced before push_node returns
+        durability_always
+    };
+
+    durability_level durability;
+    size_t group_records;
+    size_t group_bytes;
+    size_t compact_records;
+
+    journal_options(
+    ) :
+        durability(durability_group),
+        group_records(64),
+        group_bytes(1 << 20),
+        compact_records(0)
+    {
+    }
+};
+
+namespace detail {
+
+inline void sync_file(
+    const std::string& file,
+    bool directory
+)
+{
+    const int fd = ::open(file.c_str(), directory ? O_RDONLY : O_WRONLY);
+
+    if (fd < 0)
+        throw_io_error(file, errno);
+
+    if (::fsync(fd) != 0)
+    {
+        const int error = errno;
+        ::close(fd);
+        throw_io_error(file, error);
+    }
+
+    ::close(fd);
+}
+
+inline std::string directory_of(
+    const std::string& file
+)
+{
+    const size_t slash = file.rfind('/');
+
+    if (slash == std::string::npos)
+        return ".";
+
+    if (slash == 0)
+        return "/";
+
+    return file.substr(0, slash);
+}
+
+inline bool file_exists(
+    const std::string& file
+)
+{
+    struct stat st;
+    return ::stat(file.c_str(), &st) == 0;
+}
+
+}
+
+/**
+ * Append-only log of pushed nodes. Each record is a payload size and a
+ * checksum followed by the input paths, command and output paths of one
+ * node, all length-prefixed. Records are encoded into a buffer and
+ * written to the file in groups according to the durability level.
+ */
+class hist_journal
+{
+private:
+
+    struct header
+    {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t byte_order;
+        boost::uint32_t epoch;
+        boost::uint32_t reserved;
+    };
+
+    static const boost::uint32_t current_version = 1;
+    static const boost::uint32_t byte_order_mark = 0x01020304;
+
+    std::string _file;
+    journal_options _options;
+    int _fd;
+    boost::uint32_t _epoch;
+    std::vector<char> _buffer;
+    size_t _group_records;
+
+    static const char* magic_value(
+    )
+    {
+        return "H1STJRN";
+    }
+
+    static boost::uint32_t checksum(
+        const char* data,
+        size_t size
+    )
+    {
+        return static_cast<boost::uint32_t>(path_table::hash(data, size));
+    }
+
+    static void put(
+        std::vector<char>& buffer,
+        boost::uint32_t value
+    )
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+    }
+
+    static void put(
+        std::vector<char>& buffer,
+        const char* data,
+        size_t size
+    )
+    {
+        put(buffer, static_cast<boost::uint32_t>(size));
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    static bool get(
+        const char*& p,
+        const char* end,
+        boost::uint32_t& value
+    )
+    {
+        if (static_cast<size_t>(end - p) < sizeof(value))
+            return false;
+
+        std::memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+
+        return true;
+    }
+
+    static bool get(
+        const char*& p,
+        const char* end,
+        std::string& value
+    )
+    {
+        boost::uint32_t size;
+
+        if (!get(p, end, size) || static_cast<size_t>(end - p) < size)
+            return false;
+
+        value.assign(p, size);
+        p += size;
+
+        return true;
+    }
+
+    int create(
+        const std::string& file,
+        boost::uint32_t epoch
+    )
+    {
+        const int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0)
+            detail::throw_io_error(file, errno);
+
+        header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, magic_value(), 8);
+        h.version = current_version;
+        h.byte_order = byte_order_mark;
+        h.epoch = epoch;
+
+        try
+        {
+            detail::write_all(fd, reinterpret_cast<const char*>(&h),
+                sizeof(h), file);
+
+            if (::fsync(fd) != 0)
+                detail::throw_io_error(file, errno);
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+
+        return fd;
+    }
+
+    void commit(
+        bool sync
+    )
+    {
+        if (!_buffer.empty())
+        {
+            detail::write_all(_fd, &_buffer[0], _buffer.size(), _file);
+            _buffer.clear();
+        }
+
+        _group_records = 0;
+
+        if (sync && ::fdatasync(_fd) != 0)
+            detail::throw_io_error(_file, errno);
+    }
+
+public:
+
+    /**
+     * Open a journal, creating it with the given epoch if it does not
+     * exist yet.
+     */
+    hist_journal(
+        const std::string& file,
+        const journal_options& options = journal_options(),
+        boost::uint32_t epoch = 0
+    ) :
+        _file(file),
+        _options(options),
+        _fd(-1),
+        _epoch(epoch),
+        _buffer(),
+        _group_records(0)
+    {
+        if (!detail::file_exists(_file))
+        {
+            _fd = create(_file, _epoch);
+            detail::sync_file(detail::directory_of(_file), true);
+            return;
+        }
+
+        _fd = ::open(_file.c_str(), O_RDWR);
+
+        if (_fd < 0)
+            detail::throw_io_error(_file, errno);
+
+        header h;
+        const ssize_t size = ::pread(_fd, &h, sizeof(h), 0);
+
+        if (size != static_cast<ssize_t>(sizeof(h)) ||
+            std::memcmp(h.magic, magic_value(), 8) != 0 ||
+            h.version != current_version ||
+            h.byte_order != byte_order_mark)
+        {
+            ::close(_fd);
+
+            EX3_THROW(invalid_format_exception()
+                << file_name(_file));
+        }
+
+        _epoch = h.epoch;
+
+        if (::lseek(_fd, 0, SEEK_END) < 0)
+        {
+            const int error = errno;
+            ::close(_fd);
+            detail::throw_io_error(_file, error);
+        }
+    }
+
+    const std::string& file(
+    ) const
+    {
+        return _file;
+    }
+
+    const journal_options& options(
+    ) const
+    {
+        return _options;
+    }
+
+    boost::uint32_t epoch(
+    ) const
+    {
+        return _epoch;
+    }
+
+    /**
+     * Push every record of the journal into a graph and return how many
+     * were replayed. A torn or corrupt tail left by a crash is cut off
+     * so new records are appended after the last valid one.
+     */
+    template <typename Graph>
+    size_t replay(
+        Graph& graph
+    )
+    {
+        commit(false);
+
+        const off_t end = ::lseek(_fd, 0, SEEK_END);
+
+        if (end < 0)
+            detail::throw_io_error(_file, errno);
+
+        std::vector<char> data(static_cast<size_t>(end) - sizeof(header));
+        size_t read = 0;
+
+        while (read < data.size())
+        {
+            const ssize_t n = ::pread(_fd, &data[read], data.size() - read,
+                static_cast<off_t>(sizeof(header) + read));
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n <= 0)
+                detail::throw_io_error(_file, n < 0 ? errno : EIO);
+
+            read += static_cast<size_t>(n);
+        }
+
+        const char* p = data.empty() ? 0 : &data[0];
+        const char* data_end = p + data.size();
+        const char* valid_end = p;
+
+        std::string command;
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        size_t num_records = 0;
+
+        while (p != data_end)
+        {
+            boost::uint32_t size;
+            boost::uint32_t sum;
+
+            if (!get(p, data_end, size) || !get(p, data_end, sum) ||
+                static_cast<size_t>(data_end - p) < size ||
+                checksum(p, size) != sum)
+                break;
+
+            const char* record_end = p + size;
+
+            boost::uint32_t num_in;
+            boost::uint32_t num_out;
+
+            if (!get(p, record_end, num_in) || !get(p, record_end, num_out) ||
+                !get(p, record_end, command))
+                break;
+
+            bool valid = true;
+
+            files_in.resize(num_in);
+            for (boost::uint32_t i = 0; valid && i < num_in; i++)
+                valid = get(p, record_end, files_in[i]);
+
+            files_out.resize(num_out);
+            for (boost::uint32_t i = 0; valid && i < num_out; i++)
+                valid = get(p, record_end, files_out[i]);
+
+            if (!valid || p != record_end)
+                break;
+
+            graph.push_node(files_in.begin(), files_in.end(),
+                command, files_out.begin(), files_out.end());
+
+            valid_end = p;
+            num_records++;
+        }
+
+        const off_t valid_size = static_cast<off_t>(sizeof(header) +
+            static_cast<size_t>(valid_end - (data.empty() ? 0 : &data[0])));
+
+        if (valid_size != end)
+        {
+            if (::ftruncate(_fd, valid_size) != 0 ||
+                ::lseek(_fd, 0, SEEK_END) < 0 ||
+                ::fsync(_fd) != 0)
+                detail::throw_io_error(_file, errno);
+        }
+
+        return num_records;
+    }
+
+    template <typename Node>
+    void append(
+        const Node* node
+    )
+    {
+        const size_t begin = _buffer.size();
+
+        put(_buffer, 0);
+        put(_buffer, 0);
+        put(_buffer, static_cast<boost::uint32_t>(node->nodes_in().size()));
+        put(_buffer, static_cast<boost::uint32_t>(node->files_out().size()));
+        put(_buffer, static_cast<boost::uint32_t>(node->command().size()));
+        _buffer.insert(_buffer.end(), node->command().begin(),
+            node->command().end());
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            const std::string& file = node->nodes_in()[i].file();
+            put(_buffer, file.data(), file.size());
+        }
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+        {
+            const std::string& file = node->files_out()[i].str();
+            put(_buffer, file.data(), file.size());
+        }
+
+        const size_t payload = begin + 2 * sizeof(boost::uint32_t);
+        const boost::uint32_t size = static_cast<boost::uint32_t>(
+            _buffer.size() - payload);
+        const boost::uint32_t sum = checksum(&_buffer[payload], size);
+
+        std::memcpy(&_buffer[begin], &size, sizeof(size));
+        std::memcpy(&_buffer[begin + sizeof(size)], &sum, sizeof(sum));
+
+        _group_records++;
+
+        if (_options.durability == journal_options::durability_always)
+        {
+            commit(true);
+        }
+        else if (_group_records >= _options.group_records ||
+            _buffer.size() >= _options.group_bytes)
+        {
+            commit(_options.durability ==
+                journal_options::durability_group);
+        }
+    }
+
+    void flush(
+    )
+    {
+        commit(false);
+    }
+
+    void sync(
+    )
+    {
+        commit(true);
+    }
+
+    /**
+     * Atomically replace the journal with an empty one of a new epoch.
+     * Records still buffered are dropped, the caller must have saved
+     * them elsewhere first.
+     */
+    void reset(
+        boost::uint32_t epoch
+    )
+    {
+        const std::string tmp = _file + ".tmp";
+        const int fd = create(tmp, epoch);
+
+        if (::rename(tmp.c_str(), _file.c_str()) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            detail::throw_io_error(_file, error);
+        }
+
+        ::close(_fd);
+
+        _fd = fd;
+        _epoch = epoch;
+        _buffer.clear();
+        _group_records = 0;
+
+        if (::lseek(_fd, 0, SEEK_END) < 0)
+            detail::throw_io_error(_file, errno);
+
+        detail::sync_file(detail::directory_of(_file), true);
+    }
+
+    ~hist_journal(
+    )
+    {
+        try
+        {
+            commit(_options.durability !=
+                journal_options::durability_none);
+        }
+        catch (...)
+        {
+        }
+
+        ::close(_fd);
+    }
+
+private:
+
+    hist_journal(
+        const hist_journal&
+    );
+
+    hist_journal& operator =(
+        const hist_journal&
+    );
+};
+
+/**
+ * Graph whose pushes are recorded in a journal next to a compacted
+ * snapshot, base.journal and base.snapshot. Opening it loads the
+ * snapshot and replays the journal on top of it. Compaction writes a
+ * snapshot tagged with the next epoch before resetting the journal to
+ * that epoch, so a crash in between leaves a journal one epoch behind
+ * the snapshot, which is then known to be already applied.
+ */
+class journaled_hist_graph
+{
+private:
+
+    std::string _snapshot_file;
+    boost::uint32_t _snapshot_epoch;
+    hist_graph _graph;
+    hist_journal _journal;
+    size_t _num_records;
+
+    boost::uint32_t load_snapshot(
+    )
+    {
+        if (detail::file_exists(_snapshot_file))
+        {
+            hist_file_view view(_snapshot_file);
+            view.restore(_graph);
+
+            _snapshot_epoch = view.tag();
+        }
+
+        return _snapshot_epoch;
+    }
+
+    const hist_node* record(
+        const hist_node* node
+    )
+    {
+        _journal.append(node);
+        _num_records++;
+
+        if (_journal.options().compact_records != 0 &&
+            _num_records >= _journal.options().compact_records)
+            compact();
+
+        return node;
+    }
+
+public:
+
+    journaled_hist_graph(
+        const std::string& base,
+        const journal_options& options = journal_options()
+    ) :
+        _snapshot_file(base + ".snapshot"),
+        _snapshot_epoch(0),
+        _graph(),
+        _journal(base + ".journal", options, load_snapshot()),
+        _num_records(0)
+    {
+        const boost::uint32_t epoch = _snapshot_epoch;
+
+        if (_journal.epoch() == epoch)
+        {
+            _num_records = _journal.replay(_graph);
+        }
+        else if (_journal.epoch() + 1 == epoch)
+        {
+            _journal.reset(epoch);
+        }
+        else
+        {
+            EX3_THROW(invalid_format_exception()
+                << file_name(_journal.file()));
+        }
+    }
+
+    template <typename ITF, typename ITO>
+    const hist_node* push_node(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        return record(_graph.push_node(files_in_begin, files_in_end,
+            command, files_out_begin, files_out_end));
+    }
+
+    template <typename ITO>
+    const hist_node* push_node(
+        const std::string& command,
+        ITO files_out_begin,
+        ITO files_out_end
+    )
+    {
+        return record(_graph.push_node(command,
+            files_out_begin, files_out_end));
+    }
+
+    const hist_graph& graph(
+    ) const
+    {
+        return _graph;
+    }
+
+    size_t num_records(
+    ) const
+    {
+        return _num_records;
+    }
+
+    void sync(
+    )
+    {
+        _journal.sync();
+    }
+
+    void compact(
+    )
+    {
+        const boost::uint32_t epoch = _journal.epoch() + 1;
+        const std::string tmp = _snapshot_file + ".tmp";
+
+        write_hist_file(tmp, _graph.snapshot(), epoch);
+        detail::sync_file(tmp, false);
+
+        if (::rename(tmp.c_str(), _snapshot_file.c_str()) != 0)
+            detail::throw_io_error(_snapshot_file, errno);
+
+        detail::sync_file(detail::directory_of(_snapshot_file), true);
+
+        _journal.reset(epoch);
+        _num_records = 0;
+    }
+
+private:
+
+    journaled_hist_graph(
+        const journaled_hist_graph&
+    );
+
+    journaled_hist_graph& operator =(
+        const journaled_hist_graph&
+    );
+};
+
+}
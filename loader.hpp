@@ -0,0 +1,963 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "array_ref.hpp"
+#include "historian.hpp"
+#include "string_ref.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+namespace detail {
+
+class mapped_file
+{
+private:
+
+    void* _data;
+    size_t _size;
+
+    mapped_file(
+        const mapped_file&
+    );
+
+    mapped_file& operator =(
+        const mapped_file&
+    );
+
+public:
+
+    explicit mapped_file(
+        const std::string& file
+    ) :
+        _data(0),
+        _size(0)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(errno));
+        }
+
+        struct stat st;
+
+        if (::fstat(fd, &st) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(error));
+        }
+
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        _data = ::mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        const int error = errno;
+        ::close(fd);
+
+        if (_data == MAP_FAILED)
+        {
+            _data = 0;
+
+            EX3_THROW(io_exception()
+                << file_name(file)
+                << errno_value(error));
+        }
+
+        ::madvise(_data, _size, MADV_SEQUENTIAL);
+    }
+
+    const char* data(
+    ) const
+    {
+        return static_cast<const char*>(_data);
+    }
+
+    size_t size(
+    ) const
+    {
+        return _size;
+    }
+
+    ~mapped_file(
+    )
+    {
+        if (_data != 0)
+            ::munmap(_data, _size);
+    }
+};
+
+/**
+ * Step handed to hist_graph::push_linked_batch, every member refers to
+ * the arrays of the linked_steps that created it.
+ */
+class linked_step
+{
+private:
+
+    array_ref<string_ref> _files_in;
+    array_ref<size_t> _sources;
+    string_ref _command;
+    array_ref<string_ref> _files_out;
+
+public:
+
+    linked_step(
+        array_ref<string_ref> files_in,
+        array_ref<size_t> sources,
+        string_ref command,
+        array_ref<string_ref> files_out
+    ) :
+        _files_in(files_in),
+        _sources(sources),
+        _command(command),
+        _files_out(files_out)
+    {
+    }
+
+    const array_ref<string_ref>& files_in(
+    ) const
+    {
+        return _files_in;
+    }
+
+    const array_ref<size_t>& sources(
+    ) const
+    {
+        return _sources;
+    }
+
+    const string_ref& command(
+    ) const
+    {
+        return _command;
+    }
+
+    const array_ref<string_ref>& files_out(
+    ) const
+    {
+        return _files_out;
+    }
+};
+
+/**
+ * Collects the parsed nodes in flat arrays so loading a graph costs a
+ * few amortized allocations instead of several per node. The strings
+ * point into the parsed data, or into _unescaped when they had to be
+ * rewritten.
+ */
+class linked_steps
+{
+private:
+
+    struct record
+    {
+        size_t first_string;
+        size_t num_in;
+        size_t num_out;
+        size_t first_source;
+    };
+
+    typedef boost::unordered_map<boost::uint64_t, size_t> uuid_map;
+
+    std::vector<string_ref> _strings;
+    std::vector<size_t> _sources;
+    std::vector<string_ref> _commands;
+    std::vector<record> _records;
+    std::deque<std::string> _unescaped;
+    uuid_map _steps;
+
+    std::vector<string_ref> _files_in;
+    std::vector<string_ref> _files_out;
+
+    linked_steps(
+        const linked_steps&
+    );
+
+    linked_steps& operator =(
+        const linked_steps&
+    );
+
+public:
+
+    linked_steps(
+    ) :
+        _strings(),
+        _sources(),
+        _commands(),
+        _records(),
+        _unescaped(),
+        _steps(),
+        _files_in(),
+        _files_out()
+    {
+    }
+
+    string_ref keep(
+        const std::string& str
+    )
+    {
+        _unescaped.push_back(str);
+        return string_ref(_unescaped.back());
+    }
+
+    bool add_input(
+        const string_ref& file,
+        boost::uint64_t uuid
+    )
+    {
+        // The file must be an output of the node, which also keeps the
+        // printed format from taking a command word for an input
+
+        uuid_map::const_iterator it = _steps.find(uuid);
+
+        if (it == _steps.end())
+            return false;
+
+        const record& r = _records[it->second];
+        const string_ref* out = &_strings[r.first_string + r.num_in];
+
+        if (std::find(out, out + r.num_out, file) == out + r.num_out)
+            return false;
+
+        _files_in.push_back(file);
+        _sources.push_back(it->second);
+
+        return true;
+    }
+
+    void add_output(
+        const string_ref& file
+    )
+    {
+        _files_out.push_back(file);
+    }
+
+    bool end_step(
+        boost::uint64_t uuid,
+        const string_ref& command
+    )
+    {
+        if (_files_out.empty() || !_steps.insert(
+            std::make_pair(uuid, _records.size())).second)
+        {
+            _sources.resize(_sources.size() - _files_in.size());
+            _files_in.clear();
+            _files_out.clear();
+            return false;
+        }
+
+        record r;
+        r.first_string = _strings.size();
+        r.num_in = _files_in.size();
+        r.num_out = _files_out.size();
+        r.first_source = _sources.size() - _files_in.size();
+
+        _strings.insert(_strings.end(), _files_in.begin(), _files_in.end());
+        _strings.insert(_strings.end(), _files_out.begin(), _files_out.end());
+        _commands.push_back(command);
+        _records.push_back(r);
+
+        _files_in.clear();
+        _files_out.clear();
+
+        return true;
+    }
+
+    template <typename Graph>
+    size_t push(
+        Graph& graph
+    ) const
+    {
+        std::vector<linked_step> steps;
+        steps.reserve(_records.size());
+
+        const string_ref* strings = _strings.empty() ? 0 : &_strings[0];
+        const size_t* sources = _sources.empty() ? 0 : &_sources[0];
+
+        for (size_t i = 0; i < _records.size(); i++)
+        {
+            const record& r = _records[i];
+            const string_ref* in = strings + r.first_string;
+            const size_t* source = sources + r.first_source;
+
+            steps.push_back(linked_step(
+                array_ref<string_ref>(in, in + r.num_in),
+                array_ref<size_t>(source, source + r.num_in),
+                _commands[i],
+                array_ref<string_ref>(in + r.num_in,
+                    in + r.num_in + r.num_out)));
+        }
+
+        return graph.push_linked_batch(steps.begin(), steps.end());
+    }
+};
+
+inline bool parse_uint(
+    const char* begin,
+    const char* end,
+    boost::uint64_t& value
+)
+{
+    if (begin == end || end - begin > 19)
+        return false;
+
+    value = 0;
+
+    for (const char* p = begin; p != end; p++)
+    {
+        if (*p < '0' || *p > '9')
+            return false;
+
+        value = 10 * value + static_cast<boost::uint64_t>(*p - '0');
+    }
+
+    return true;
+}
+
+/**
+ * Split a "file(uuid)" token of the printed format.
+ */
+inline bool parse_printed_file(
+    const string_ref& token,
+    string_ref& file,
+    boost::uint64_t& uuid
+)
+{
+    if (token.size() < 4 || token[token.size() - 1] != ')')
+        return false;
+
+    const char* close = token.end() - 1;
+    const char* open = close;
+
+    while (open != token.begin() && open[-1] >= '0' && open[-1] <= '9')
+        open--;
+
+    if (open == token.begin() || open[-1] != '(' ||
+        !parse_uint(open, close, uuid))
+        return false;
+
+    file = string_ref(token.begin(), static_cast<size_t>(open - 1 -
+        token.begin()));
+
+    return !file.empty();
+}
+
+inline bool parse_printed_line(
+    const char* begin,
+    const char* end,
+    std::vector<string_ref>& tokens,
+    linked_steps& steps
+)
+{
+    // A line is "in(M) ... command out(N) ... " and the command may
+    // contain spaces, so the outputs are taken from the back while they
+    // share the uuid of the last one and the inputs from the front
+    // while they name a node already loaded, leaving the command as
+    // whatever is between them
+
+    if (end != begin && end[-1] == ' ')
+        end--;
+
+    tokens.clear();
+
+    for (const char* p = begin; ; )
+    {
+        const char* space = static_cast<const char*>(
+            std::memchr(p, ' ', static_cast<size_t>(end - p)));
+
+        if (space == 0)
+        {
+            tokens.push_back(string_ref(p, static_cast<size_t>(end - p)));
+            break;
+        }
+
+        tokens.push_back(string_ref(p, static_cast<size_t>(space - p)));
+        p = space + 1;
+    }
+
+    string_ref file;
+    boost::uint64_t uuid = 0;
+    boost::uint64_t file_uuid;
+
+    size_t first_out = tokens.size();
+
+    while (first_out > 1 &&
+        parse_printed_file(tokens[first_out - 1], file, file_uuid) &&
+        (first_out == tokens.size() || file_uuid == uuid))
+    {
+        uuid = file_uuid;
+        first_out--;
+    }
+
+    if (first_out == tokens.size())
+        return false;
+
+    size_t first_command = 0;
+
+    while (first_command + 1 < first_out &&
+        parse_printed_file(tokens[first_command], file, file_uuid) &&
+        steps.add_input(file, file_uuid))
+    {
+        first_command++;
+    }
+
+    for (size_t i = first_out; i < tokens.size(); i++)
+    {
+        parse_printed_file(tokens[i], file, file_uuid);
+        steps.add_output(file);
+    }
+
+    const char* command_begin = tokens[first_command].begin();
+    const char* command_end = tokens[first_out - 1].end();
+
+    return steps.end_step(uuid, string_ref(command_begin,
+        static_cast<size_t>(command_end - command_begin)));
+}
+
+class jsonl_parser
+{
+private:
+
+    const char* _p;
+    const char* _end;
+    linked_steps* _p_steps;
+    std::string _buffer;
+
+    void skip_space(
+    )
+    {
+        while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\r'))
+            _p++;
+    }
+
+    bool expect(
+        char c
+    )
+    {
+        skip_space();
+
+        if (_p == _end || *_p != c)
+            return false;
+
+        _p++;
+        return true;
+    }
+
+    bool peek(
+        char c
+    )
+    {
+        skip_space();
+        return _p != _end && *_p == c;
+    }
+
+    static void append_utf8(
+        std::string& str,
+        boost::uint32_t code
+    )
+    {
+        if (code < 0x80)
+        {
+            str += static_cast<char>(code);
+        }
+        else if (code < 0x800)
+        {
+            str += static_cast<char>(0xc0 | (code >> 6));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            str += static_cast<char>(0xe0 | (code >> 12));
+            str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            str += static_cast<char>(0xf0 | (code >> 18));
+            str += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    bool parse_hex4(
+        boost::uint32_t& code
+    )
+    {
+        if (_end - _p < 4)
+            return false;
+
+        code = 0;
+
+        for (int i = 0; i < 4; i++, _p++)
+        {
+            const char c = *_p;
+            code <<= 4;
+
+            if (c >= '0' && c <= '9')
+                code |= static_cast<boost::uint32_t>(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                code |= static_cast<boost::uint32_t>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                code |= static_cast<boost::uint32_t>(c - 'A' + 10);
+            else
+                return false;
+        }
+
+        return true;
+    }
+
+    bool parse_escaped(
+        std::string& str
+    )
+    {
+        // _p is past the opening quote, copy until the closing one
+
+        str.clear();
+
+        while (_p != _end)
+        {
+            const char c = *_p++;
+
+            if (c == '"')
+                return true;
+
+            if (c != '\\')
+            {
+                str += c;
+                continue;
+            }
+
+            if (_p == _end)
+                return false;
+
+            const char e = *_p++;
+            boost::uint32_t code;
+
+            switch (e)
+            {
+            case '"': case '\\': case '/': str += e; break;
+            case 'b': str += '\b'; break;
+            case 'f': str += '\f'; break;
+            case 'n': str += '\n'; break;
+            case 'r': str += '\r'; break;
+            case 't': str += '\t'; break;
+            case 'u':
+                if (!parse_hex4(code))
+                    return false;
+
+                if (code >= 0xd800 && code < 0xdc00)
+                {
+                    boost::uint32_t low;
+
+                    if (_end - _p < 2 || _p[0] != '\\' || _p[1] != 'u')
+                        return false;
+
+                    _p += 2;
+
+                    if (!parse_hex4(low) || low < 0xdc00 || low >= 0xe000)
+                        return false;
+
+                    code = 0x10000 + ((code - 0xd800) << 10) +
+                        (low - 0xdc00);
+                }
+
+                append_utf8(str, code);
+                break;
+            default:
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    bool parse_string(
+        string_ref& str
+    )
+    {
+        if (!expect('"'))
+            return false;
+
+        const char* quote = static_cast<const char*>(
+            std::memchr(_p, '"', static_cast<size_t>(_end - _p)));
+
+        if (quote == 0)
+            return false;
+
+        if (std::memchr(_p, '\\', static_cast<size_t>(quote - _p)) == 0)
+        {
+            str = string_ref(_p, static_cast<size_t>(quote - _p));
+            _p = quote + 1;
+            return true;
+        }
+
+        if (!parse_escaped(_buffer))
+            return false;
+
+        str = _p_steps->keep(_buffer);
+        return true;
+    }
+
+    bool parse_uint(
+        boost::uint64_t& value
+    )
+    {
+        skip_space();
+
+        const char* begin = _p;
+
+        while (_p != _end && *_p >= '0' && *_p <= '9')
+            _p++;
+
+        return detail::parse_uint(begin, _p, value);
+    }
+
+    bool parse_key(
+        string_ref& key
+    )
+    {
+        return parse_string(key) && expect(':');
+    }
+
+    bool parse_input(
+    )
+    {
+        string_ref key;
+        string_ref file;
+        boost::uint64_t uuid = 0;
+        bool has_file = false;
+        bool has_uuid = false;
+
+        if (!expect('{'))
+            return false;
+
+        do
+        {
+            if (!parse_key(key))
+                return false;
+
+            if (key == "file" && !has_file)
+                has_file = parse_string(file);
+            else if (key == "uuid" && !has_uuid)
+                has_uuid = parse_uint(uuid);
+            else
+                return false;
+        }
+        while (expect(','));
+
+        return expect('}') && has_file && has_uuid &&
+            _p_steps->add_input(file, uuid);
+    }
+
+    bool parse_inputs(
+    )
+    {
+        if (!expect('['))
+            return false;
+
+        if (peek(']'))
+            return expect(']');
+
+        do
+        {
+            if (!parse_input())
+                return false;
+        }
+        while (expect(','));
+
+        return expect(']');
+    }
+
+    bool parse_outputs(
+    )
+    {
+        string_ref file;
+
+        if (!expect('['))
+            return false;
+
+        if (peek(']'))
+            return expect(']');
+
+        do
+        {
+            if (!parse_string(file))
+                return false;
+
+            _p_steps->add_output(file);
+        }
+        while (expect(','));
+
+        return expect(']');
+    }
+
+public:
+
+    jsonl_parser(
+        linked_steps* p_steps
+    ) :
+        _p(0),
+        _end(0),
+        _p_steps(p_steps),
+        _buffer()
+    {
+    }
+
+    bool parse_line(
+        const char* begin,
+        const char* end
+    )
+    {
+        _p = begin;
+        _end = end;
+
+        string_ref key;
+        string_ref command;
+        boost::uint64_t uuid = 0;
+        bool has_uuid = false;
+        bool has_command = false;
+        bool has_inputs = false;
+        bool has_outputs = false;
+        bool valid = expect('{');
+
+        while (valid)
+        {
+            if (!parse_key(key))
+                valid = false;
+            else if (key == "uuid" && !has_uuid)
+                valid = has_uuid = parse_uint(uuid);
+            else if (key == "command" && !has_command)
+                valid = has_command = parse_string(command);
+            else if (key == "inputs" && !has_inputs)
+                valid = has_inputs = parse_inputs();
+            else if (key == "outputs" && !has_outputs)
+                valid = has_outputs = parse_outputs();
+            else
+                valid = false;
+
+            if (!expect(','))
+                break;
+        }
+
+        valid = valid && expect('}') && has_uuid && has_command;
+
+        skip_space();
+
+        // end_step also discards the files of an invalid line
+
+        return _p_steps->end_step(uuid, command) && valid && _p == _end;
+    }
+};
+
+template <typename Graph, typename LineParser>
+size_t load_lines(
+    Graph& graph,
+    const char* data,
+    size_t size,
+    LineParser& parse,
+    linked_steps& steps,
+    const std::string& file
+)
+{
+    const char* end = data + size;
+    size_t line = 0;
+
+    for (const char* p = data; p != end; )
+    {
+        const char* newline = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
+
+        const char* line_end = newline == 0 ? end : newline;
+
+        line++;
+
+        if (line_end != p && !parse(p, line_end))
+        {
+            if (file.empty())
+            {
+                EX3_THROW(invalid_format_exception()
+                    << line_number(line));
+            }
+            else
+            {
+                EX3_THROW(invalid_format_exception()
+                    << file_name(file)
+                    << line_number(line));
+            }
+        }
+
+        p = newline == 0 ? end : newline + 1;
+    }
+
+    return steps.push(graph);
+}
+
+class printed_line_parser
+{
+private:
+
+    linked_steps* _p_steps;
+    std::vector<string_ref> _tokens;
+
+public:
+
+    printed_line_parser(
+        linked_steps* p_steps
+    ) :
+        _p_steps(p_steps),
+        _tokens()
+    {
+    }
+
+    bool operator ()(
+        const char* begin,
+        const char* end
+    )
+    {
+        return parse_printed_line(begin, end, _tokens, *_p_steps);
+    }
+};
+
+class jsonl_line_parser
+{
+private:
+
+    jsonl_parser _parser;
+
+public:
+
+    jsonl_line_parser(
+        linked_steps* p_steps
+    ) :
+        _parser(p_steps)
+    {
+    }
+
+    bool operator ()(
+        const char* begin,
+        const char* end
+    )
+    {
+        return _parser.parse_line(begin, end);
+    }
+};
+
+}
+
+/**
+ * Push the nodes written by hist_node_print_to_stream or
+ * hist_node_print_buffered into a graph in a single batch and return
+ * how many were loaded. Inputs are linked by the uuids in the text, so
+ * files rebound after they were read are restored, and the loaded
+ * nodes get new uuids. The format does not quote commands, a command
+ * that starts with a word like "file(uuid)" naming an output of a
+ * loaded node or that ends with one carrying the uuid of its own node
+ * is misread, use the JSON lines export when commands are arbitrary.
+ */
+template <typename Graph>
+size_t load_printed_graph(
+    Graph& graph,
+    const char* data,
+    size_t size
+)
+{
+    detail::linked_steps steps;
+    detail::printed_line_parser parse(&steps);
+
+    return detail::load_lines(graph, data, size, parse, steps,
+        std::string());
+}
+
+template <typename Graph>
+size_t load_printed_graph(
+    Graph& graph,
+    const std::string& file
+)
+{
+    detail::mapped_file mapped(file);
+    detail::linked_steps steps;
+    detail::printed_line_parser parse(&steps);
+
+    return detail::load_lines(graph, mapped.data(), mapped.size(), parse,
+        steps, file);
+}
+
+/**
+ * Push the nodes written by hist_node_export_jsonl into a graph, like
+ * load_printed_graph.
+ */
+template <typename Graph>
+size_t load_jsonl_graph(
+    Graph& graph,
+    const char* data,
+    size_t size
+)
+{
+    detail::linked_steps steps;
+    detail::jsonl_line_parser parse(&steps);
+
+    return detail::load_lines(graph, data, size, parse, steps,
+        std::string());
+}
+
+template <typename Graph>
+size_t load_jsonl_graph(
+    Graph& graph,
+    const std::string& file
+)
+{
+    detail::mapped_file mapped(file);
+    detail::linked_steps steps;
+    detail::jsonl_line_parser parse(&steps);
+
+    return detail::load_lines(graph, mapped.data(), mapped.size(), parse,
+        steps, file);
+}
+
+}
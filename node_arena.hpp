@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace h1st {
+
+class node_arena
+{
+private:
+
+    typedef std::vector<void*> block_vector;
+
+    static const size_t slab_size = 64 * 1024;
+    static const size_t granularity = 16;
+    static const size_t num_fine_classes = 64;
+    static const size_t num_classes = num_fine_classes + 48;
+
+    // Blocks up to 1KiB are rounded up to 16 bytes, larger blocks to the
+    // next power of two. Freed blocks are chained through their first
+    // word into a free list per size class and reused before the
+    // current slab is bumped. Blocks larger than a slab get one of their
+    // own, so the whole arena is released by freeing its slabs
+
+    block_vector _slabs;
+    block_vector _free;
+    char* _top;
+    char* _end;
+    size_t _bytes_used;
+    size_t _bytes_reserved;
+
+    static size_t size_class(
+        size_t size
+    )
+    {
+        if (size <= num_fine_classes * granularity)
+            return size == 0 ? 0 : (size - 1) / granularity;
+
+        size_t c = num_fine_classes;
+        size_t s = 2 * num_fine_classes * granularity;
+
+        while (s < size)
+        {
+            s *= 2;
+            c++;
+        }
+
+        return c;
+    }
+
+    static size_t class_size(
+        size_t c
+    )
+    {
+        if (c < num_fine_classes)
+            return (c + 1) * granularity;
+
+        return (2 * num_fine_classes * granularity) << (c - num_fine_classes);
+    }
+
+    void* allocate_slab(
+        size_t size
+    )
+    {
+        _slabs.push_back(0);
+
+        try
+        {
+            _slabs.back() = ::operator new(size);
+        }
+        catch (...)
+        {
+            _slabs.pop_back();
+            throw;
+        }
+
+        _bytes_reserved += size;
+
+        return _slabs.back();
+    }
+
+public:
+
+    // The blocks still allocated are released with the arena, so a
+    // graph does not need to free its nodes one by one
+
+    static const bool owns_blocks = true;
+
+    node_arena(
+    ) :
+        _slabs(),
+        _free(num_classes, static_cast<void*>(0)),
+        _top(0),
+        _end(0),
+        _bytes_used(0),
+        _bytes_reserved(0)
+    {
+    }
+
+    void* allocate(
+        size_t size
+    )
+    {
+        const size_t c = size_class(size);
+        const size_t block_size = class_size(c);
+
+        void* block = _free[c];
+
+        if (block != 0)
+        {
+            _free[c] = *static_cast<void**>(block);
+        }
+        else if (block_size > slab_size)
+        {
+            block = allocate_slab(block_size);
+        }
+        else
+        {
+            if (static_cast<size_t>(_end - _top) < block_size)
+            {
+                _top = static_cast<char*>(allocate_slab(slab_size));
+                _end = _top + slab_size;
+            }
+
+            block = _top;
+            _top += block_size;
+        }
+
+        _bytes_used += block_size;
+
+        return block;
+    }
+
+    void deallocate(
+        void* block,
+        size_t size
+    )
+    {
+        const size_t c = size_class(size);
+
+        *static_cast<void**>(block) = _free[c];
+        _free[c] = block;
+
+        _bytes_used -= class_size(c);
+    }
+
+    size_t bytes_used(
+    ) const
+    {
+        return _bytes_used;
+    }
+
+    size_t bytes_reserved(
+    ) const
+    {
+        return _bytes_reserved;
+    }
+
+    ~node_arena(
+    )
+    {
+        for (size_t i = 0; i < _slabs.size(); i++)
+            ::operator delete(_slabs[i]);
+    }
+
+private:
+
+    node_arena(
+        const node_arena&
+    );
+
+    node_arena& operator =(
+        const node_arena&
+    );
+};
+
+/**
+ * Node allocator that takes every block from the global heap, for
+ * comparison with node_arena or when the nodes should be visible to a
+ * heap checker. The owner must deallocate every block it allocated.
+ */
+class heap_node_allocator
+{
+private:
+
+    size_t _bytes_used;
+
+    heap_node_allocator(
+        const heap_node_allocator&
+    );
+
+    heap_node_allocator& operator =(
+        const heap_node_allocator&
+    );
+
+public:
+
+    static const bool owns_blocks = false;
+
+    heap_node_allocator(
+    ) :
+        _bytes_used(0)
+    {
+    }
+
+    void* allocate(
+        size_t size
+    )
+    {
+        void* block = ::operator new(size);
+        _bytes_used += size;
+        return block;
+    }
+
+    void deallocate(
+        void* block,
+        size_t size
+    )
+    {
+        ::operator delete(block);
+        _bytes_used -= size;
+    }
+
+    size_t bytes_used(
+    ) const
+    {
+        return _bytes_used;
+    }
+
+    size_t bytes_reserved(
+    ) const
+    {
+        return _bytes_used;
+    }
+};
+
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "file_io.hpp"
+#include "path_table.hpp"
+#include "string_ref.hpp"
+#include "command_store.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Append-only character buffer that is written to a file descriptor or
+ * a stream only when it fills up or is flushed, so the output reaches
+ * the sink in large chunks. Integers are formatted by hand instead of
+ * going through the locale-aware iostream machinery.
+ */
+class output_buffer
+{
+private:
+
+    std::vector<char> _data;
+    size_t _size;
+    int _fd;
+    std::ostream* _p_stream;
+
+    void reserve(
+        size_t size
+    )
+    {
+        if (_data.size() - _size < size)
+        {
+            flush();
+
+            if (_data.size() < size)
+                _data.resize(size);
+        }
+    }
+
+public:
+
+    static const size_t default_capacity = 1 << 16;
+
+    output_buffer(
+        int fd,
+        size_t capacity = default_capacity
+    ) :
+        _data(capacity == 0 ? 1 : capacity),
+        _size(0),
+        _fd(fd),
+        _p_stream(0)
+    {
+        if (_fd < 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("fd"));
+        }
+    }
+
+    output_buffer(
+        std::ostream* p_stream,
+        size_t capacity = default_capacity
+    ) :
+        _data(capacity == 0 ? 1 : capacity),
+        _size(0),
+        _fd(-1),
+        _p_stream(p_stream)
+    {
+        if (_p_stream == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("p_stream"));
+        }
+    }
+
+    void append(
+        const char* data,
+        size_t size
+    )
+    {
+        if (size >= _data.size())
+        {
+            // Too large to be worth copying, write it through
+
+            flush();
+            write(data, size);
+            return;
+        }
+
+        reserve(size);
+        std::memcpy(&_data[_size], data, size);
+        _size += size;
+    }
+
+    void append(
+        char c
+    )
+    {
+        reserve(1);
+        _data[_size++] = c;
+    }
+
+    void append(
+        const std::string& str
+    )
+    {
+        append(str.data(), str.size());
+    }
+
+    void append(
+        const string_ref& str
+    )
+    {
+        append(str.data(), str.size());
+    }
+
+    void append(
+        const path_ref& path
+    )
+    {
+        append(path.str());
+    }
+
+    void append(
+        const command_ref& command
+    )
+    {
+        for (size_t i = 0; i < command.num_chunks(); i++)
+            append(command.chunk(i));
+    }
+
+    void append(
+        boost::uint64_t value
+    )
+    {
+        char digits[20];
+        size_t n = 0;
+
+        do
+        {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        while (value != 0);
+
+        reserve(n);
+
+        while (n > 0)
+            _data[_size++] = digits[--n];
+    }
+
+    void append(
+        boost::uint32_t value
+    )
+    {
+        append(static_cast<boost::uint64_t>(value));
+    }
+
+    void append(
+        boost::int64_t value
+    )
+    {
+        if (value < 0)
+        {
+            append('-');
+            append(0 - static_cast<boost::uint64_t>(value));
+        }
+        else
+        {
+            append(static_cast<boost::uint64_t>(value));
+        }
+    }
+
+    void append(
+        int value
+    )
+    {
+        append(static_cast<boost::int64_t>(value));
+    }
+
+    void write(
+        const char* data,
+        size_t size
+    )
+    {
+        if (_p_stream == 0)
+        {
+            detail::write_all(_fd, data, size, std::string());
+            return;
+        }
+
+        _p_stream->write(data, static_cast<std::streamsize>(size));
+
+        if (!*_p_stream)
+        {
+            EX3_THROW(io_exception());
+        }
+    }
+
+    void flush(
+    )
+    {
+        if (_size == 0)
+            return;
+
+        const size_t size = _size;
+        _size = 0;
+
+        write(&_data[0], size);
+    }
+
+    size_t size(
+    ) const
+    {
+        return _size;
+    }
+
+    ~output_buffer(
+    )
+    {
+        // Callers that need to see write errors flush explicitly
+
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+private:
+
+    output_buffer(
+        const output_buffer&
+    );
+
+    output_buffer& operator =(
+        const output_buffer&
+    );
+};
+
+/**
+ * Same format as hist_node_print_to_stream, written through an
+ * output_buffer and without flushing after every node.
+ */
+class hist_node_print_buffered
+{
+private:
+
+    output_buffer* _p_buffer;
+
+public:
+
+    hist_node_print_buffered(
+        output_buffer* p_buffer
+    ) :
+        _p_buffer(p_buffer)
+    {
+        if (_p_buffer == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("p_buffer"));
+        }
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            _p_buffer->append(node->nodes_in()[i].file());
+            _p_buffer->append('(');
+            _p_buffer->append(node->nodes_in()[i].node()->uuid());
+            _p_buffer->append(") ", 2);
+        }
+
+        _p_buffer->append(node->command());
+        _p_buffer->append(' ');
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+        {
+            _p_buffer->append(node->files_out()[i]);
+            _p_buffer->append('(');
+            _p_buffer->append(node->uuid());
+            _p_buffer->append(") ", 2);
+        }
+
+        _p_buffer->append('\n');
+    }
+};
+
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "threading.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Marks every ancestor of a set of root nodes using several threads.
+ * The nodes must expose nodes_in() and a uuid() below num_nodes. Each
+ * thread walks depth-first from its own stack and the first thread to
+ * set a node's bit in the shared bitmap expands it. Threads with a deep
+ * stack hand half of it to a shared pool whenever another thread is
+ * waiting for work, and the walk ends when every thread is waiting.
+ *
+ * Threads are created and joined by every run, which costs tens of
+ * microseconds, so run first walks serial_budget nodes on the calling
+ * thread and only starts the others if the walk is not over by then.
+ */
+template <typename Node>
+class parallel_visitor
+{
+private:
+
+    typedef boost::uint64_t word_type;
+
+    static const size_t word_bits = 64;
+    static const size_t share_threshold = 32;
+    static const size_t serial_budget = 4096;
+
+    size_t _num_nodes;
+    size_t _num_words;
+    boost::atomic<word_type>* _visited;
+    detail::mutex _mutex;
+    detail::condition _cond;
+    std::vector<const Node*> _shared;
+    size_t _num_threads;
+    size_t _num_waiting;
+    boost::atomic<size_t> _num_hungry;
+    bool _done;
+    bool _failed;
+    boost::exception_ptr _error;
+    size_t _num_edges;
+
+    static size_t lowest_bit(
+        word_type word
+    )
+    {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctzll(word));
+#else
+        size_t bit = 0;
+
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            bit++;
+        }
+
+        return bit;
+#endif
+    }
+
+    static void* run_worker(
+        void* arg
+    )
+    {
+        static_cast<parallel_visitor*>(arg)->work();
+        return 0;
+    }
+
+    bool mark(
+        const Node* node
+    )
+    {
+        const size_t index = static_cast<size_t>(node->uuid());
+        const word_type bit = static_cast<word_type>(1) << (index % word_bits);
+        boost::atomic<word_type>& word = _visited[index / word_bits];
+
+        if ((word.load(boost::memory_order_relaxed) & bit) != 0)
+            return false;
+
+        return (word.fetch_or(bit, boost::memory_order_relaxed) & bit) == 0;
+    }
+
+    bool take(
+        std::vector<const Node*>& local
+    )
+    {
+        detail::scoped_lock lock(_mutex);
+
+        while (_shared.empty() && !_done)
+        {
+            if (++_num_waiting == _num_threads)
+            {
+                _done = true;
+                _cond.notify_all();
+                return false;
+            }
+
+            _num_hungry.fetch_add(1, boost::memory_order_relaxed);
+            _cond.wait(_mutex);
+            _num_hungry.fetch_sub(1, boost::memory_order_relaxed);
+
+            _num_waiting--;
+        }
+
+        if (_done)
+            return false;
+
+        const size_t count = std::max<size_t>(1,
+            _shared.size() / _num_threads);
+
+        local.insert(local.end(), _shared.end() - count, _shared.end());
+        _shared.resize(_shared.size() - count);
+
+        return true;
+    }
+
+    void share(
+        std::vector<const Node*>& local
+    )
+    {
+        // The bottom of the stack holds the oldest nodes, which are the
+        // most likely to lead to large unexplored subgraphs
+
+        const size_t count = local.size() / 2;
+
+        detail::scoped_lock lock(_mutex);
+
+        _shared.insert(_shared.end(), local.begin(), local.begin() + count);
+        local.erase(local.begin(), local.begin() + count);
+
+        _cond.notify_all();
+    }
+
+    size_t expand(
+        std::vector<const Node*>& local
+    )
+    {
+        const Node* next = local.back();
+        local.pop_back();
+
+        const size_t num_inputs = next->nodes_in().size();
+
+        for (size_t i = 0; i < num_inputs; i++)
+        {
+            const Node* input = next->nodes_in()[i].node();
+
+            if (mark(input))
+                local.push_back(input);
+        }
+
+        return num_inputs;
+    }
+
+    void walk(
+        std::vector<const Node*>& local,
+        size_t& num_edges
+    )
+    {
+        while (!local.empty() || take(local))
+        {
+            num_edges += expand(local);
+
+            if (local.size() > share_threshold &&
+                _num_hungry.load(boost::memory_order_relaxed) != 0)
+                share(local);
+        }
+    }
+
+    void work(
+    )
+    {
+        size_t num_edges = 0;
+
+        try
+        {
+            std::vector<const Node*> local;
+            walk(local, num_edges);
+        }
+        catch (...)
+        {
+            // Stop the other threads, the caller rethrows the first
+            // exception after joining
+
+            detail::scoped_lock lock(_mutex);
+
+            if (!_failed)
+                _error = boost::current_exception();
+
+            _failed = true;
+            _done = true;
+            _cond.notify_all();
+        }
+
+        detail::scoped_lock lock(_mutex);
+        _num_edges += num_edges;
+    }
+
+public:
+
+    parallel_visitor(
+        size_t num_nodes
+    ) :
+        _num_nodes(num_nodes),
+        _num_words((num_nodes + word_bits - 1) / word_bits),
+        _visited(new boost::atomic<word_type>[_num_words]),
+        _mutex(),
+        _cond(),
+        _shared(),
+        _num_threads(1),
+        _num_waiting(0),
+        _num_hungry(0),
+        _done(false),
+        _failed(false),
+        _error(),
+        _num_edges(0)
+    {
+        for (size_t i = 0; i < _num_words; i++)
+            _visited[i].store(0, boost::memory_order_relaxed);
+    }
+
+    /**
+     * Mark the roots and all their ancestors using the calling thread
+     * and up to num_threads - 1 additional threads. An exception thrown
+     * by a node on any thread is rethrown here once every thread ended.
+     */
+    template <typename ITN>
+    void run(
+        ITN roots_begin,
+        ITN roots_end,
+        size_t num_threads
+    )
+    {
+        std::vector<const Node*> local;
+
+        for (ITN root_it = roots_begin; root_it != roots_end; root_it++)
+            if (mark(*root_it))
+                local.push_back(*root_it);
+
+        for (size_t i = 0; i < serial_budget && !local.empty(); i++)
+            _num_edges += expand(local);
+
+        if (local.empty())
+            return;
+
+        _shared.swap(local);
+
+        std::vector<pthread_t> threads;
+        threads.reserve(num_threads);
+
+        {
+            // Workers block on the lock until the final number of threads
+            // is known, so a failed pthread_create cannot stall the walk
+
+            detail::scoped_lock lock(_mutex);
+
+            for (size_t i = 1; i < num_threads; i++)
+            {
+                pthread_t thread;
+
+                if (pthread_create(&thread, 0, run_worker, this) != 0)
+                    break;
+
+                threads.push_back(thread);
+            }
+
+            _num_threads = threads.size() + 1;
+        }
+
+        work();
+
+        for (size_t i = 0; i < threads.size(); i++)
+            pthread_join(threads[i], 0);
+
+        if (_failed)
+            boost::rethrow_exception(_error);
+    }
+
+    /**
+     * Return the first visited index at or after index, or num_nodes.
+     */
+    size_t next(
+        size_t index
+    ) const
+    {
+        while (index < _num_nodes)
+        {
+            const word_type word = _visited[index / word_bits].load(
+                boost::memory_order_relaxed) >> (index % word_bits);
+
+            if (word != 0)
+                return index + lowest_bit(word);
+
+            index = (index / word_bits + 1) * word_bits;
+        }
+
+        return _num_nodes;
+    }
+
+    /**
+     * Number of input edges followed by every thread of the last run.
+     */
+    size_t num_edges(
+    ) const
+    {
+        return _num_edges;
+    }
+
+    ~parallel_visitor(
+    )
+    {
+        delete[] _visited;
+    }
+
+private:
+
+    parallel_visitor(
+        const parallel_visitor&
+    );
+
+    parallel_visitor& operator =(
+        const parallel_visitor&
+    );
+};
+
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "string_ref.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace h1st {
+
+typedef boost::uint32_t path_id;
+
+const path_id invalid_path_id = static_cast<path_id>(-1);
+
+class path_ref
+{
+private:
+
+    const std::string* _str;
+    path_id _id;
+
+public:
+
+    path_ref(
+        path_id id,
+        const std::string* str
+    ) :
+        _str(str),
+        _id(id)
+    {
+        if (_str == 0)
+        {
+            EX3_THROW(null_value_exception()
+                << argument_name("str"));
+        }
+    }
+
+    path_id id(
+    ) const
+    {
+        return _id;
+    }
+
+    const std::string& str(
+    ) const
+    {
+        return *_str;
+    }
+};
+
+inline std::ostream& operator <<(
+    std::ostream& stream,
+    const path_ref& path
+)
+{
+    return stream << path.str();
+}
+
+/**
+ * Interned set of the paths of a graph. Ids are dense and stable: a
+ * path is never removed or renumbered, so the table and the arrays the
+ * graph indexes by path id grow with every distinct path ever seen.
+ * Bindings are never removed either, so this only wastes memory on the
+ * paths interned by pushes that were then rejected. The graph drops
+ * those by rebuilding its table, see basic_hist_graph::compact_paths.
+ */
+class path_table
+{
+private:
+
+    typedef std::deque<std::string> path_deque;
+    typedef std::vector<boost::uint64_t> hash_vector;
+    typedef std::vector<path_id> slot_vector;
+
+    // Paths live in a deque so references to them stay valid as the
+    // table grows, the open-addressing slots store path ids and probe
+    // linearly, comparing the precomputed hashes before the strings
+
+    path_deque _paths;
+    hash_vector _hashes;
+    slot_vector _slots;
+
+    size_t find_slot(
+        const string_ref& path,
+        boost::uint64_t hash
+    ) const
+    {
+        const size_t mask = _slots.size() - 1;
+
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            const path_id id = _slots[i];
+
+            if (id == invalid_path_id)
+                return i;
+
+            if (_hashes[id] == hash && string_ref(_paths[id]) == path)
+                return i;
+        }
+    }
+
+    void grow(
+    )
+    {
+        const size_t num_slots = _slots.size() == 0 ? 16 : 2 * _slots.size();
+        const size_t mask = num_slots - 1;
+
+        slot_vector slots(num_slots, invalid_path_id);
+
+        for (size_t id = 0; id < _paths.size(); id++)
+        {
+            size_t i = static_cast<size_t>(_hashes[id]) & mask;
+
+            while (slots[i] != invalid_path_id)
+                i = (i + 1) & mask;
+
+            slots[i] = static_cast<path_id>(id);
+        }
+
+        _slots.swap(slots);
+    }
+
+public:
+
+    static boost::uint64_t hash(
+        const char* data,
+        size_t size
+    )
+    {
+        // 64-bit FNV-1a, the value is part of the on-disk formats so it
+        // must not depend on the platform or on std::hash
+
+        boost::uint64_t h = 14695981039346656037ULL;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 1099511628211ULL;
+        }
+
+        return h;
+    }
+
+    static boost::uint64_t hash(
+        const string_ref& path
+    )
+    {
+        return hash(path.data(), path.size());
+    }
+
+    path_table(
+    ) :
+        _paths(),
+        _hashes(),
+        _slots()
+    {
+    }
+
+    path_id find(
+        const string_ref& path
+    ) const
+    {
+        if (_slots.size() == 0)
+            return invalid_path_id;
+
+        return _slots[find_slot(path, hash(path))];
+    }
+
+    path_id intern(
+        const string_ref& path
+    )
+    {
+        const boost::uint64_t h = hash(path);
+
+        if (4 * (_paths.size() + 1) > 3 * _slots.size())
+            grow();
+
+        const size_t slot = find_slot(path, h);
+
+        if (_slots[slot] == invalid_path_id)
+        {
+            _slots[slot] = static_cast<path_id>(_paths.size());
+            _paths.push_back(path.str());
+            _hashes.push_back(h);
+        }
+
+        return _slots[slot];
+    }
+
+    path_ref ref(
+        path_id id
+    ) const
+    {
+        return path_ref(id, &_paths[id]);
+    }
+
+    const std::string& str(
+        path_id id
+    ) const
+    {
+        return _paths[id];
+    }
+
+    boost::uint64_t hash_of(
+        path_id id
+    ) const
+    {
+        return _hashes[id];
+    }
+
+    size_t size(
+    ) const
+    {
+        return _paths.size();
+    }
+
+    void swap(
+        path_table& other
+    )
+    {
+        _paths.swap(other._paths);
+        _hashes.swap(other._hashes);
+        _slots.swap(other._slots);
+    }
+};
+
+}
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Lazy range over the ancestors of a set of nodes in reverse
+ * topological order, i.e. by decreasing uuid. Pending nodes are kept
+ * in a max-heap keyed on the uuid and only the nodes reached so far are
+ * remembered, so stopping early costs O(k log k) for the k nodes
+ * discovered instead of a pass over the whole graph. Since every input
+ * has a smaller uuid than its consumers, a node is yielded only after
+ * every consumer that leads to it. The range is invalidated by any
+ * modification of the graph.
+ */
+template <typename Node>
+class provenance_range
+{
+public:
+
+    class iterator
+    {
+    private:
+
+        provenance_range* _range;
+
+    public:
+
+        typedef std::input_iterator_tag iterator_category;
+        typedef const Node* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Node* const* pointer;
+        typedef const Node* const& reference;
+
+        iterator(
+            provenance_range* range = 0
+        ) :
+            _range(range != 0 && !range->empty() ? range : 0)
+        {
+        }
+
+        reference operator *(
+        ) const
+        {
+            return _range->front();
+        }
+
+        iterator& operator ++(
+        )
+        {
+            _range->pop();
+
+            if (_range->empty())
+                _range = 0;
+
+            return *this;
+        }
+
+        iterator operator ++(
+            int
+        )
+        {
+            iterator it(*this);
+            ++(*this);
+            return it;
+        }
+
+        bool operator ==(
+            const iterator& other
+        ) const
+        {
+            return _range == other._range;
+        }
+
+        bool operator !=(
+            const iterator& other
+        ) const
+        {
+            return _range != other._range;
+        }
+    };
+
+private:
+
+    std::vector<const Node*> _heap;
+    boost::unordered_set<const Node*> _seen;
+    bool _found_all;
+
+    static bool uuid_less(
+        const Node* a,
+        const Node* b
+    )
+    {
+        return a->uuid() < b->uuid();
+    }
+
+    void discover(
+        const Node* node
+    )
+    {
+        if (!_seen.insert(node).second)
+            return;
+
+        _heap.push_back(node);
+        std::push_heap(_heap.begin(), _heap.end(), uuid_less);
+    }
+
+public:
+
+    provenance_range(
+    ) :
+        _heap(),
+        _seen(),
+        _found_all(true)
+    {
+    }
+
+    /**
+     * Add a node to the starting set. All roots must be added before
+     * the first node is consumed.
+     */
+    void add_root(
+        const Node* node
+    )
+    {
+        discover(node);
+    }
+
+    void set_found_all(
+        bool found_all
+    )
+    {
+        _found_all = found_all;
+    }
+
+    /**
+     * False when a requested file was missing and ignored.
+     */
+    bool found_all(
+    ) const
+    {
+        return _found_all;
+    }
+
+    bool empty(
+    ) const
+    {
+        return _heap.empty();
+    }
+
+    const Node* const& front(
+    ) const
+    {
+        return _heap.front();
+    }
+
+    /**
+     * Consume the front node and make its inputs pending.
+     */
+    void pop(
+    )
+    {
+        const Node* node = _heap.front();
+
+        std::pop_heap(_heap.begin(), _heap.end(), uuid_less);
+        _heap.pop_back();
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+            discover(node->nodes_in()[i].node());
+    }
+
+    /**
+     * Number of nodes reached so far, yielded or pending.
+     */
+    size_t num_discovered(
+    ) const
+    {
+        return _seen.size();
+    }
+
+    iterator begin(
+    )
+    {
+        return iterator(this);
+    }
+
+    iterator end(
+    )
+    {
+        return iterator();
+    }
+};
+
+/**
+ * Compact form of the output of track. Maximal chains where every node
+ * but the first has a single producer and every node but the last has a
+ * single consumer among the tracked nodes are collapsed into segments,
+ * and the edges between segments join the last node of one segment to
+ * an input of the first node of another. Node is the type track emits,
+ * e.g. const hist_node* or hist_csr_node, and the nodes must be given
+ * in the order track emits them. Inputs outside the given nodes are
+ * left out. Building it takes time linear in the nodes and edges.
+ */
+template <typename Node>
+class condensed_provenance
+{
+public:
+
+    /**
+     * Input of the first node of a segment, the file it reads is
+     * head(segment)->nodes_in()[input].file().
+     */
+    struct segment_edge
+    {
+        size_t source;
+        size_t input;
+    };
+
+private:
+
+    std::vector<Node> _nodes;
+    std::vector<size_t> _segments;
+    std::vector<size_t> _member_offsets;
+    std::vector<size_t> _members;
+    std::vector<size_t> _edge_offsets;
+    std::vector<segment_edge> _edges;
+
+public:
+
+    template <typename ITN>
+    condensed_provenance(
+        ITN nodes_begin,
+        ITN nodes_end
+    ) :
+        _nodes(nodes_begin, nodes_end),
+        _segments(_nodes.size()),
+        _member_offsets(1, 0),
+        _members(_nodes.size()),
+        _edge_offsets(1, 0),
+        _edges()
+    {
+        const size_t n = _nodes.size();
+        const size_t none = static_cast<size_t>(-1);
+
+        boost::unordered_map<boost::uint64_t, size_t> index;
+        index.reserve(n);
+
+        for (size_t i = 0; i < n; i++)
+            index[static_cast<boost::uint64_t>(_nodes[i]->uuid())] = i;
+
+        // Distinct producers of each node, a node reading several files
+        // from the same producer still has a single one
+
+        std::vector<size_t> producer(n, none);
+        std::vector<size_t> num_producers(n, 0);
+        std::vector<size_t> num_consumers(n, 0);
+        std::vector<size_t> stamp(n, none);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < _nodes[i]->nodes_in().size(); j++)
+            {
+                const boost::unordered_map<boost::uint64_t, size_t>::
+                    const_iterator it = index.find(static_cast<
+                        boost::uint64_t>(_nodes[i]->nodes_in()[j].node()->
+                            uuid()));
+
+                if (it == index.end() || stamp[it->second] == i)
+                    continue;
+
+                stamp[it->second] = i;
+                producer[i] = it->second;
+                num_producers[i]++;
+                num_consumers[it->second]++;
+            }
+        }
+
+        // Nodes come after their producers, so a node either extends the
+        // segment of its only producer or starts a new one, and segments
+        // are numbered in topological order
+
+        std::vector<size_t> sizes;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (num_producers[i] == 1 && num_consumers[producer[i]] == 1)
+            {
+                _segments[i] = _segments[producer[i]];
+                sizes[_segments[i]]++;
+                continue;
+            }
+
+            _segments[i] = sizes.size();
+            sizes.push_back(1);
+
+            for (size_t j = 0; j < _nodes[i]->nodes_in().size(); j++)
+            {
+                const boost::unordered_map<boost::uint64_t, size_t>::
+                    const_iterator it = index.find(static_cast<
+                        boost::uint64_t>(_nodes[i]->nodes_in()[j].node()->
+                            uuid()));
+
+                if (it == index.end() || stamp[it->second] == n + i)
+                    continue;
+
+                stamp[it->second] = n + i;
+
+                segment_edge edge;
+                edge.source = _segments[it->second];
+                edge.input = j;
+                _edges.push_back(edge);
+            }
+
+            _edge_offsets.push_back(_edges.size());
+        }
+
+        for (size_t s = 0; s < sizes.size(); s++)
+            _member_offsets.push_back(_member_offsets.back() + sizes[s]);
+
+        std::vector<size_t> next(_member_offsets.begin(),
+            _member_offsets.end() - 1);
+
+        for (size_t i = 0; i < n; i++)
+            _members[next[_segments[i]]++] = i;
+    }
+
+    /**
+     * Drop the edges between segments that are implied by a longer path,
+     * keeping the same reachability. This runs a search over the
+     * ancestors of each segment, so it costs up to the number of
+     * segments times the number of edges and is meant for the condensed
+     * graph rather than the raw history.
+     */
+    void reduce(
+    )
+    {
+        const size_t num = num_segments();
+        const size_t none = static_cast<size_t>(-1);
+
+        std::vector<size_t> mark(num, none);
+        std::vector<size_t> pending;
+        std::vector<size_t> offsets(1, 0);
+        std::vector<segment_edge> edges;
+
+        for (size_t s = 0; s < num; s++)
+        {
+            // Mark every segment reachable from an input through at
+            // least one more edge
+
+            for (size_t e = _edge_offsets[s]; e < _edge_offsets[s + 1]; e++)
+                pending.push_back(_edges[e].source);
+
+            while (!pending.empty())
+            {
+                const size_t next = pending.back();
+                pending.pop_back();
+
+                for (size_t e = _edge_offsets[next];
+                    e < _edge_offsets[next + 1]; e++)
+                {
+                    const size_t source = _edges[e].source;
+
+                    if (mark[source] != s)
+                    {
+                        mark[source] = s;
+                        pending.push_back(source);
+                    }
+                }
+            }
+
+            for (size_t e = _edge_offsets[s]; e < _edge_offsets[s + 1]; e++)
+                if (mark[_edges[e].source] != s)
+                    edges.push_back(_edges[e]);
+
+            offsets.push_back(edges.size());
+        }
+
+        _edge_offsets.swap(offsets);
+        _edges.swap(edges);
+    }
+
+    size_t num_nodes(
+    ) const
+    {
+        return _nodes.size();
+    }
+
+    size_t num_segments(
+    ) const
+    {
+        return _member_offsets.size() - 1;
+    }
+
+    size_t num_edges(
+    ) const
+    {
+        return _edges.size();
+    }
+
+    /**
+     * Number of nodes collapsed into the segment.
+     */
+    size_t size(
+        size_t segment
+    ) const
+    {
+        return _member_offsets[segment + 1] - _member_offsets[segment];
+    }
+
+    /**
+     * The nodes of a segment from the first to the last, each one the
+     * only consumer of the previous.
+     */
+    const Node& node(
+        size_t segment,
+        size_t i
+    ) const
+    {
+        return _nodes[_members[_member_offsets[segment] + i]];
+    }
+
+    const Node& head(
+        size_t segment
+    ) const
+    {
+        return node(segment, 0);
+    }
+
+    const Node& tail(
+        size_t segment
+    ) const
+    {
+        return node(segment, size(segment) - 1);
+    }
+
+    size_t segment_of(
+        size_t i
+    ) const
+    {
+        return _segments[i];
+    }
+
+    size_t num_inputs(
+        size_t segment
+    ) const
+    {
+        return _edge_offsets[segment + 1] - _edge_offsets[segment];
+    }
+
+    const segment_edge& input(
+        size_t segment,
+        size_t i
+    ) const
+    {
+        return _edges[_edge_offsets[segment] + i];
+    }
+};
+
+}
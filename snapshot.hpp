@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+#include "graph_policies.hpp"
+#include "path_table.hpp"
+#include "string_ref.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace h1st {
+
+/**
+ * Raw arrays of a graph in compressed sparse row form. Node indices are
+ * dense and in topological order, the inputs of node i are the entries
+ * [in_offsets[i], in_offsets[i + 1]) of in_nodes and in_files, and the
+ * outputs are [out_offsets[i], out_offsets[i + 1]) of out_files. Strings
+ * are stored back to back in blobs delimited by offset arrays. Paths are
+ * found through an open-addressing table of path ids probed with the
+ * path_table hash.
+ */
+struct hist_csr_arrays
+{
+    boost::uint32_t num_nodes;
+    boost::uint32_t num_paths;
+    boost::uint32_t num_slots;
+
+    const boost::uint32_t* uuids;
+    const boost::uint32_t* in_offsets;
+    const boost::uint32_t* in_nodes;
+    const boost::uint32_t* in_files;
+    const boost::uint32_t* out_offsets;
+    const boost::uint32_t* out_files;
+    const boost::uint64_t* command_offsets;
+    const char* commands;
+    const boost::uint64_t* path_offsets;
+    const char* paths;
+    const boost::uint64_t* path_hashes;
+    const boost::uint32_t* bindings;
+    const boost::uint32_t* slots;
+};
+
+const boost::uint32_t invalid_csr_index = static_cast<boost::uint32_t>(-1);
+
+class hist_csr_node;
+
+class hist_csr_input
+{
+private:
+
+    const hist_csr_arrays* _csr;
+    boost::uint32_t _edge;
+
+public:
+
+    hist_csr_input(
+        const hist_csr_arrays* csr,
+        boost::uint32_t edge
+    ) :
+        _csr(csr),
+        _edge(edge)
+    {
+    }
+
+    inline hist_csr_node node(
+    ) const;
+
+    path_id file_id(
+    ) const
+    {
+        return _csr->in_files[_edge];
+    }
+
+    string_ref file(
+    ) const
+    {
+        const path_id id = file_id();
+        const boost::uint64_t begin = _csr->path_offsets[id];
+        const boost::uint64_t end = _csr->path_offsets[id + 1];
+
+        return string_ref(_csr->paths + begin,
+            static_cast<size_t>(end - begin));
+    }
+};
+
+class hist_csr_inputs
+{
+private:
+
+    const hist_csr_arrays* _csr;
+    boost::uint32_t _begin;
+    boost::uint32_t _end;
+
+public:
+
+    hist_csr_inputs(
+        const hist_csr_arrays* csr,
+        boost::uint32_t begin,
+        boost::uint32_t end
+    ) :
+        _csr(csr),
+        _begin(begin),
+        _end(end)
+    {
+    }
+
+    size_t size(
+    ) const
+    {
+        return _end - _begin;
+    }
+
+    hist_csr_input operator [](
+        size_t i
+    ) const
+    {
+        return hist_csr_input(_csr,
+            _begin + static_cast<boost::uint32_t>(i));
+    }
+};
+
+class hist_csr_outputs
+{
+private:
+
+    const hist_csr_arrays* _csr;
+    boost::uint32_t _begin;
+    boost::uint32_t _end;
+
+public:
+
+    hist_csr_outputs(
+        const hist_csr_arrays* csr,
+        boost::uint32_t begin,
+        boost::uint32_t end
+    ) :
+        _csr(csr),
+        _begin(begin),
+        _end(end)
+    {
+    }
+
+    size_t size(
+    ) const
+    {
+        return _end - _begin;
+    }
+
+    path_id id(
+        size_t i
+    ) const
+    {
+        return _csr->out_files[_begin + i];
+    }
+
+    string_ref operator [](
+        size_t i
+    ) const
+    {
+        const path_id file = id(i);
+        const boost::uint64_t begin = _csr->path_offsets[file];
+        const boost::uint64_t end = _csr->path_offsets[file + 1];
+
+        return string_ref(_csr->paths + begin,
+            static_cast<size_t>(end - begin));
+    }
+};
+
+/**
+ * Lightweight handle to a node of a CSR graph. It exposes the same
+ * accessors as hist_node and overloads operator-> so printers written
+ * for const hist_node* work on it unchanged.
+ */
+class hist_csr_node
+{
+private:
+
+    const hist_csr_arrays* _csr;
+    boost::uint32_t _index;
+
+public:
+
+    hist_csr_node(
+        const hist_csr_arrays* csr,
+        boost::uint32_t index
+    ) :
+        _csr(csr),
+        _index(index)
+    {
+    }
+
+    const hist_csr_node* operator ->(
+    ) const
+    {
+        return this;
+    }
+
+    boost::uint32_t index(
+    ) const
+    {
+        return _index;
+    }
+
+    uuid64::type uuid(
+    ) const
+    {
+        return _csr->uuids[_index];
+    }
+
+    hist_csr_inputs nodes_in(
+    ) const
+    {
+        return hist_csr_inputs(_csr, _csr->in_offsets[_index],
+            _csr->in_offsets[_index + 1]);
+    }
+
+    hist_csr_outputs files_out(
+    ) const
+    {
+        return hist_csr_outputs(_csr, _csr->out_offsets[_index],
+            _csr->out_offsets[_index + 1]);
+    }
+
+    string_ref command(
+    ) const
+    {
+        const boost::uint64_t begin = _csr->command_offsets[_index];
+        const boost::uint64_t end = _csr->command_offsets[_index + 1];
+
+        return string_ref(_csr->commands + begin,
+            static_cast<size_t>(end - begin));
+    }
+};
+
+inline hist_csr_node hist_csr_input::node(
+) const
+{
+    return hist_csr_node(_csr, _csr->in_nodes[_edge]);
+}
+
+/**
+ * Read-only queries over CSR arrays, shared by in-memory snapshots and
+ * by graphs mapped from disk.
+ */
+class hist_csr_view
+{
+private:
+
+    hist_csr_arrays _csr;
+
+    path_id find_path(
+        const std::string& file
+    ) const
+    {
+        if (_csr.num_slots == 0)
+            return invalid_path_id;
+
+        const boost::uint64_t hash = path_table::hash(file);
+        const boost::uint32_t mask = _csr.num_slots - 1;
+
+        for (boost::uint32_t i = static_cast<boost::uint32_t>(hash) & mask; ;
+            i = (i + 1) & mask)
+        {
+            const path_id id = _csr.slots[i];
+
+            if (id == invalid_path_id)
+                return invalid_path_id;
+
+            if (_csr.path_hashes[id] == hash &&
+                string_ref(file) == path(id))
+                return id;
+        }
+    }
+
+public:
+
+    hist_csr_view(
+    )
+    {
+        _csr.num_nodes = 0;
+        _csr.num_paths = 0;
+        _csr.num_slots = 0;
+    }
+
+    explicit hist_csr_view(
+        const hist_csr_arrays& csr
+    ) :
+        _csr(csr)
+    {
+    }
+
+    const hist_csr_arrays& arrays(
+    ) const
+    {
+        return _csr;
+    }
+
+    size_t num_nodes(
+    ) const
+    {
+        return _csr.num_nodes;
+    }
+
+    size_t num_paths(
+    ) const
+    {
+        return _csr.num_paths;
+    }
+
+    hist_csr_node node(
+        size_t index
+    ) const
+    {
+        return hist_csr_node(&_csr, static_cast<boost::uint32_t>(index));
+    }
+
+    string_ref path(
+        path_id id
+    ) const
+    {
+        const boost::uint64_t begin = _csr.path_offsets[id];
+        const boost::uint64_t end = _csr.path_offsets[id + 1];
+
+        return string_ref(_csr.paths + begin,
+            static_cast<size_t>(end - begin));
+    }
+
+    boost::uint32_t binding(
+        const std::string& file
+    ) const
+    {
+        const path_id id = find_path(file);
+
+        if (id == invalid_path_id)
+            return invalid_csr_index;
+
+        return _csr.bindings[id];
+    }
+
+    bool has_input(
+        const std::string& file
+    ) const
+    {
+        return binding(file) != invalid_csr_index;
+    }
+
+    template <typename Printer>
+    void print(
+        Printer& printer
+    ) const
+    {
+        for (boost::uint32_t i = 0; i < _csr.num_nodes; i++)
+            printer(hist_csr_node(&_csr, i));
+    }
+
+    /**
+     * Push every node into a graph in index order. Indices follow the
+     * original push order, so each input resolves to the same producer
+     * it had when the view was taken.
+     */
+    template <typename Graph>
+    void restore(
+        Graph& graph
+    ) const
+    {
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        for (boost::uint32_t i = 0; i < _csr.num_nodes; i++)
+        {
+            const hist_csr_node node(&_csr, i);
+
+            files_in.resize(node.nodes_in().size());
+            for (size_t j = 0; j < files_in.size(); j++)
+            {
+                const string_ref file = node.nodes_in()[j].file();
+                files_in[j].assign(file.data(), file.size());
+            }
+
+            files_out.resize(node.files_out().size());
+            for (size_t j = 0; j < files_out.size(); j++)
+            {
+                const string_ref file = node.files_out()[j];
+                files_out[j].assign(file.data(), file.size());
+            }
+
+            graph.push_node(files_in.begin(), files_in.end(),
+                node.command().str(), files_out.begin(), files_out.end());
+        }
+    }
+
+    template <typename ITF, typename ITN>
+    bool track(
+        ITF files_begin,
+        ITF files_end,
+        ITN nodes_out,
+        bool ignore_missing
+    ) const
+    {
+        bool found_all = true;
+
+        std::vector<bool> visited(_csr.num_nodes, false);
+        std::vector<boost::uint32_t> pending;
+
+        for (ITF file_it = files_begin; file_it != files_end; file_it++)
+        {
+            const std::string& file = *file_it;
+
+            const boost::uint32_t index = binding(file);
+
+            if (index == invalid_csr_index)
+            {
+                if (ignore_missing)
+                {
+                    found_all = false;
+                    continue;
+                }
+
+                EX3_THROW(input_not_found_exception()
+                    << input_value(file));
+            }
+
+            if (visited[index])
+                continue;
+
+            visited[index] = true;
+            pending.push_back(index);
+
+            while (!pending.empty())
+            {
+                const boost::uint32_t next = pending.back();
+                pending.pop_back();
+
+                const boost::uint32_t end = _csr.in_offsets[next + 1];
+
+                for (boost::uint32_t e = _csr.in_offsets[next]; e < end; e++)
+                {
+                    const boost::uint32_t input = _csr.in_nodes[e];
+
+                    if (!visited[input])
+                    {
+                        visited[input] = true;
+                        pending.push_back(input);
+                    }
+                }
+            }
+        }
+
+        for (boost::uint32_t i = 0; i < _csr.num_nodes; i++)
+        {
+            if (visited[i])
+            {
+                *nodes_out = hist_csr_node(&_csr, i);
+                nodes_out++;
+            }
+        }
+
+        return found_all;
+    }
+};
+
+namespace detail {
+
+template <typename Node>
+class node_collector
+{
+private:
+
+    std::vector<const Node*>* _nodes;
+
+public:
+
+    node_collector(
+        std::vector<const Node*>* nodes
+    ) :
+        _nodes(nodes)
+    {
+    }
+
+    void operator ()(
+        const Node* node
+    )
+    {
+        _nodes->push_back(node);
+    }
+};
+
+}
+
+/**
+ * Owning CSR copy of a graph, see hist_graph::snapshot.
+ */
+class hist_snapshot :
+    public hist_csr_view
+{
+private:
+
+    std::vector<boost::uint32_t> _uuids;
+    std::vector<boost::uint32_t> _in_offsets;
+    std::vector<boost::uint32_t> _in_nodes;
+    std::vector<boost::uint32_t> _in_files;
+    std::vector<boost::uint32_t> _out_offsets;
+    std::vector<boost::uint32_t> _out_files;
+    std::vector<boost::uint64_t> _command_offsets;
+    std::vector<char> _commands;
+    std::vector<boost::uint64_t> _path_offsets;
+    std::vector<char> _paths;
+    std::vector<boost::uint64_t> _path_hashes;
+    std::vector<boost::uint32_t> _bindings;
+    std::vector<boost::uint32_t> _slots;
+
+    template <typename T>
+    static const T* data(
+        const std::vector<T>& v
+    )
+    {
+        return v.empty() ? 0 : &v[0];
+    }
+
+public:
+
+    hist_snapshot(
+    ) :
+        hist_csr_view()
+    {
+    }
+
+    template <typename Graph>
+    explicit hist_snapshot(
+        const Graph& graph
+    ) :
+        hist_csr_view()
+    {
+        assign(graph);
+    }
+
+    template <typename Graph>
+    void assign(
+        const Graph& graph
+    )
+    {
+        typedef typename Graph::node_type node_type;
+
+        std::vector<const node_type*> nodes;
+        detail::node_collector<node_type> collector(&nodes);
+        graph.print(collector);
+
+        const path_table& paths = graph.paths();
+        const size_t num_paths = paths.size();
+
+        size_t num_uuids = 0;
+        for (size_t i = 0; i < nodes.size(); i++)
+            num_uuids = std::max(num_uuids,
+                static_cast<size_t>(nodes[i]->uuid()) + 1);
+
+        std::vector<boost::uint32_t> index_of(num_uuids, invalid_csr_index);
+
+        _uuids.clear();
+        _in_offsets.assign(1, 0);
+        _in_nodes.clear();
+        _in_files.clear();
+        _out_offsets.assign(1, 0);
+        _out_files.clear();
+        _command_offsets.assign(1, 0);
+        _commands.clear();
+
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const node_type* node = nodes[i];
+
+            index_of[static_cast<size_t>(node->uuid())] =
+                static_cast<boost::uint32_t>(i);
+            _uuids.push_back(static_cast<boost::uint32_t>(node->uuid()));
+
+            for (size_t j = 0; j < node->nodes_in().size(); j++)
+            {
+                _in_nodes.push_back(index_of[static_cast<size_t>(
+                    node->nodes_in()[j].node()->uuid())]);
+                _in_files.push_back(node->nodes_in()[j].file_id());
+            }
+
+            for (size_t j = 0; j < node->files_out().size(); j++)
+                _out_files.push_back(node->files_out()[j].id());
+
+            _commands.insert(_commands.end(), node->command().begin(),
+                node->command().end());
+
+            _in_offsets.push_back(static_cast<boost::uint32_t>(
+                _in_nodes.size()));
+            _out_offsets.push_back(static_cast<boost::uint32_t>(
+                _out_files.size()));
+            _command_offsets.push_back(_commands.size());
+        }
+
+        size_t num_slots = 16;
+        while (3 * num_slots < 4 * num_paths)
+            num_slots *= 2;
+
+        const size_t mask = num_slots - 1;
+
+        _path_offsets.assign(1, 0);
+        _paths.clear();
+        _path_hashes.clear();
+        _bindings.clear();
+        _slots.assign(num_slots, invalid_path_id);
+
+        for (size_t id = 0; id < num_paths; id++)
+        {
+            const std::string& path = paths.str(static_cast<path_id>(id));
+            const node_type* bound = graph.binding(
+                static_cast<path_id>(id));
+
+            _paths.insert(_paths.end(), path.begin(), path.end());
+            _path_offsets.push_back(_paths.size());
+            _path_hashes.push_back(paths.hash_of(static_cast<path_id>(id)));
+            _bindings.push_back(bound == 0 ? invalid_csr_index :
+                index_of[static_cast<size_t>(bound->uuid())]);
+
+            size_t slot = static_cast<size_t>(_path_hashes.back()) & mask;
+
+            while (_slots[slot] != invalid_path_id)
+                slot = (slot + 1) & mask;
+
+            _slots[slot] = static_cast<path_id>(id);
+        }
+
+        hist_csr_arrays csr;
+        csr.num_nodes = static_cast<boost::uint32_t>(nodes.size());
+        csr.num_paths = static_cast<boost::uint32_t>(num_paths);
+        csr.num_slots = static_cast<boost::uint32_t>(num_slots);
+        csr.uuids = data(_uuids);
+        csr.in_offsets = data(_in_offsets);
+        csr.in_nodes = data(_in_nodes);
+        csr.in_files = data(_in_files);
+        csr.out_offsets = data(_out_offsets);
+        csr.out_files = data(_out_files);
+        csr.command_offsets = data(_command_offsets);
+        csr.commands = data(_commands);
+        csr.path_offsets = data(_path_offsets);
+        csr.paths = data(_paths);
+        csr.path_hashes = data(_path_hashes);
+        csr.bindings = data(_bindings);
+        csr.slots = data(_slots);
+
+        static_cast<hist_csr_view&>(*this) = hist_csr_view(csr);
+    }
+
+private:
+
+    hist_snapshot(
+        const hist_snapshot&
+    );
+
+    hist_snapshot& operator =(
+        const hist_snapshot&
+    );
+};
+
+}
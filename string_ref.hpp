@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace h1st {
+
+class string_ref
+{
+private:
+
+    const char* _data;
+    size_t _size;
+
+public:
+
+    typedef const char* const_iterator;
+
+    string_ref(
+    ) :
+        _data(""),
+        _size(0)
+    {
+    }
+
+    string_ref(
+        const char* data,
+        size_t size
+    ) :
+        _data(data),
+        _size(size)
+    {
+    }
+
+    string_ref(
+        const char* str
+    ) :
+        _data(str),
+        _size(std::strlen(str))
+    {
+    }
+
+    string_ref(
+        const std::string& str
+    ) :
+        _data(str.data()),
+        _size(str.size())
+    {
+    }
+
+    const char* data(
+    ) const
+    {
+        return _data;
+    }
+
+    size_t size(
+    ) const
+    {
+        return _size;
+    }
+
+    bool empty(
+    ) const
+    {
+        return _size == 0;
+    }
+
+    const_iterator begin(
+    ) const
+    {
+        return _data;
+    }
+
+    const_iterator end(
+    ) const
+    {
+        return _data + _size;
+    }
+
+    char operator [](
+        size_t i
+    ) const
+    {
+        return _data[i];
+    }
+
+    std::string str(
+    ) const
+    {
+        return std::string(_data, _size);
+    }
+
+    int compare(
+        const string_ref& other
+    ) const
+    {
+        const int c = std::memcmp(_data, other._data,
+            std::min(_size, other._size));
+
+        if (c != 0)
+            return c;
+
+        return _size < other._size ? -1 : _size > other._size ? 1 : 0;
+    }
+};
+
+inline bool operator ==(
+    const string_ref& a,
+    const string_ref& b
+)
+{
+    return a.size() == b.size() &&
+        std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator !=(
+    const string_ref& a,
+    const string_ref& b
+)
+{
+    return !(a == b);
+}
+
+inline bool operator <(
+    const string_ref& a,
+    const string_ref& b
+)
+{
+    return a.compare(b) < 0;
+}
+
+inline std::ostream& operator <<(
+    std::ostream& stream,
+    const string_ref& str
+)
+{
+    return stream.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+}
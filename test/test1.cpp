@@ -73,9 +73,11 @@ TEST(TestInvalidPrinter, NullStream)
  */
 TEST(TestInvalidNodeInput, NullHist)
 {
+    h1st::path_table paths;
+
     try
     {
-        h1st::node_input ni(0, "test");
+        h1st::node_input ni(0, paths.ref(paths.intern("test")));
 
         FAIL() << "node_input constructor did not throw any exception!";
     }
@@ -100,17 +102,19 @@ TEST(TestInvalidNodeInput, NullHist)
  */
 TEST(TestInvalidNodeInput, EmptyInput)
 {
-    const std::string file = "out.txt";
-    const std::string* files_out_begin = &file;
-    const std::string* files_out_end = files_out_begin + 1;
+    h1st::path_table paths;
+
+    const h1st::path_ref file = paths.ref(paths.intern("out.txt"));
+    const h1st::path_ref* files_out_begin = &file;
+    const h1st::path_ref* files_out_end = files_out_begin + 1;
 
     try
     {
-        h1st::hist_node node(0, "", files_out_begin, files_out_end);
+        h1st::hist_node node(0, 0, files_out_begin, files_out_end);
 
         try
         {
-            h1st::node_input ni(&node, "");
+            h1st::node_input ni(&node, paths.ref(paths.intern("")));
 
             FAIL() << "node_input constructor did not throw any exception!";
         }
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class print_commands
+{
+private:
+
+    std::ostream* _p_stream;
+
+public:
+
+    print_commands(
+        std::ostream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+    }
+
+    void operator ()(
+        const h1st::hist_node* node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            (*_p_stream)
+                << node->nodes_in()[i].file() << "("
+                << node->nodes_in()[i].node()->command() << ") ";
+        }
+
+        (*_p_stream) << node->command() << " ";
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            (*_p_stream) << node->files_out()[i] << " ";
+
+        (*_p_stream) << "\n";
+    }
+};
+
+/**
+ *
+ */
+std::string dump(
+    const h1st::hist_graph& graph
+)
+{
+    std::stringstream ss;
+    print_commands printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+std::vector<h1st::hist_step> make_steps(
+    int first,
+    int last
+)
+{
+    std::vector<h1st::hist_step> steps;
+
+    for (int i = first; i < last; i++)
+    {
+        std::stringstream ss_cmd;
+        ss_cmd << "command " << i;
+
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        for (int j = 1; j <= 2 && i - j >= 0; j++)
+        {
+            std::stringstream ss;
+            ss << "out." << ((i - j) % 5) << ".txt";
+            files_in.push_back(ss.str());
+        }
+
+        std::stringstream ss_out;
+        ss_out << "out." << (i % 5) << ".txt";
+        files_out.push_back(ss_out.str());
+
+        steps.push_back(h1st::hist_step(files_in.begin(), files_in.end(),
+            ss_cmd.str(), files_out.begin(), files_out.end()));
+    }
+
+    return steps;
+}
+
+/**
+ *
+ */
+TEST(TestBatch, SameAsSequential)
+{
+    const std::vector<h1st::hist_step> steps = make_steps(0, 100);
+
+    h1st::hist_graph sequential;
+
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        ASSERT_NO_THROW(sequential.push_node(
+            steps[i].files_in().begin(), steps[i].files_in().end(),
+            steps[i].command(),
+            steps[i].files_out().begin(), steps[i].files_out().end()));
+    }
+
+    h1st::hist_graph batched;
+
+    ASSERT_EQ(40, batched.push_batch(steps.begin(), steps.begin() + 40));
+    ASSERT_EQ(60, batched.push_batch(steps.begin() + 40, steps.end()));
+
+    ASSERT_EQ(dump(sequential), dump(batched));
+}
+
+/**
+ *
+ */
+TEST(TestBatch, Overwrite)
+{
+    std::vector<std::string> files(1, "out.txt");
+    std::vector<h1st::hist_step> steps;
+
+    steps.push_back(h1st::hist_step("command 1", files.begin(), files.end()));
+    steps.push_back(h1st::hist_step("command 2", files.begin(), files.end()));
+    steps.push_back(h1st::hist_step(files.begin(), files.end(),
+        "command 3", files.begin(), files.end()));
+    steps.push_back(h1st::hist_step("command 4", files.begin(), files.end()));
+    steps.push_back(h1st::hist_step(files.begin(), files.end(),
+        "command 5", files.begin(), files.end()));
+
+    h1st::hist_graph graph;
+
+    ASSERT_NO_THROW(graph.push_batch(steps.begin(), steps.end()));
+
+    ASSERT_EQ("command 4 out.txt \nout.txt(command 4) command 5 out.txt \n",
+        dump(graph));
+}
+
+/**
+ *
+ */
+TEST(TestBatch, Atomic)
+{
+    std::vector<h1st::hist_step> steps = make_steps(0, 10);
+
+    h1st::hist_graph graph;
+
+    ASSERT_NO_THROW(graph.push_batch(steps.begin(), steps.begin() + 5));
+
+    const std::string expected = dump(graph);
+
+    std::vector<std::string> files_in(1, "missing.txt");
+    std::vector<std::string> files_out(1, "out.9.txt");
+
+    steps.push_back(h1st::hist_step(files_in.begin(), files_in.end(),
+        "command", files_out.begin(), files_out.end()));
+
+    try
+    {
+        graph.push_batch(steps.begin() + 5, steps.end());
+
+        FAIL() << "graph.push_batch did not throw any exception!";
+    }
+    catch (
+        const h1st::input_not_found_exception& ex
+    )
+    {
+        const std::string* iname;
+        iname = boost::get_error_info<h1st::input_value>(ex);
+
+        ASSERT_NE((void*)0, iname);
+        ASSERT_STREQ("missing.txt", iname->c_str());
+    }
+
+    steps.pop_back();
+    steps.push_back(h1st::hist_step("command", files_out.begin(),
+        files_out.begin()));
+
+    ASSERT_THROW(graph.push_batch(steps.begin() + 5, steps.end()),
+        h1st::empty_output_exception);
+
+    ASSERT_EQ(expected, dump(graph));
+    ASSERT_FALSE(graph.has_input("out.9.txt"));
+}
+
+}
@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/concurrent.hpp>
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class print_commands
+{
+private:
+
+    std::ostream* _p_stream;
+
+public:
+
+    print_commands(
+        std::ostream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            (*_p_stream)
+                << node->nodes_in()[i].file() << "("
+                << node->nodes_in()[i].node()->command() << ") ";
+        }
+
+        (*_p_stream) << node->command() << " ";
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            (*_p_stream) << node->files_out()[i] << " ";
+
+        (*_p_stream) << "\n";
+    }
+};
+
+/**
+ *
+ */
+template <typename Graph>
+std::string dump(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    print_commands printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+void push_steps(
+    Graph& graph,
+    int num_steps
+)
+{
+    for (int i = 0; i < num_steps; i++)
+    {
+        std::stringstream command;
+        command << "cmd" << i;
+
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        if (i % 3 != 0)
+            files_in.push_back(i % 2 == 0 ? "a" : "b");
+
+        files_out.push_back(i % 2 == 0 ? "b" : "a");
+
+        if (i % 5 == 0)
+            files_out.push_back("c");
+
+        if (files_in.empty() || !graph.has_input(files_in[0]))
+            graph.push_node(command.str(), files_out.begin(), files_out.end());
+        else
+            graph.push_node(files_in.begin(), files_in.end(), command.str(),
+                files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentMatchesGraph)
+{
+    h1st::hist_graph graph;
+    h1st::concurrent_hist_graph concurrent;
+
+    push_steps(graph, 100);
+    push_steps(concurrent, 100);
+
+    EXPECT_EQ(dump(graph), dump(concurrent));
+    EXPECT_EQ(100u, concurrent.revision());
+
+    const char* files[] = {"a", "c"};
+
+    std::vector<const h1st::hist_node*> expected;
+    std::vector<const h1st::concurrent_node*> tracked;
+
+    graph.track(files, files + 2, std::back_inserter(expected), false);
+    concurrent.track(files, files + 2, std::back_inserter(tracked), false);
+
+    ASSERT_EQ(expected.size(), tracked.size());
+
+    for (size_t i = 0; i < tracked.size(); i++)
+        EXPECT_EQ(expected[i]->command(), tracked[i]->command());
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentMissingInput)
+{
+    h1st::concurrent_hist_graph graph;
+
+    std::vector<std::string> files(1, "x");
+
+    graph.push_node("make_x", files.begin(), files.end());
+
+    EXPECT_TRUE(graph.has_input("x"));
+    EXPECT_FALSE(graph.has_input("y"));
+
+    const char* missing[] = {"x", "y"};
+    std::vector<const h1st::concurrent_node*> tracked;
+
+    try
+    {
+        graph.track(missing, missing + 2, std::back_inserter(tracked), false);
+
+        FAIL() << "track did not throw any exception!";
+    }
+    catch (const h1st::input_not_found_exception& e)
+    {
+        const std::string* input = boost::get_error_info<
+            h1st::input_value>(e);
+
+        ASSERT_TRUE(input != 0);
+        EXPECT_EQ("y", *input);
+    }
+
+    EXPECT_FALSE(graph.track(missing, missing + 2,
+        std::back_inserter(tracked), true));
+    ASSERT_EQ(1u, tracked.size());
+
+    std::vector<std::string> out(1, "z");
+
+    EXPECT_THROW(graph.push_node(missing + 1, missing + 2, "make_z",
+        out.begin(), out.end()), h1st::input_not_found_exception);
+    EXPECT_THROW(graph.push_node("make_z", out.end(), out.end()),
+        h1st::empty_output_exception);
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentDeferredReclaim)
+{
+    h1st::concurrent_hist_graph graph;
+
+    std::vector<std::string> files(1, "x");
+
+    graph.push_node("old_x", files.begin(), files.end());
+
+    {
+        h1st::concurrent_hist_graph::read_section section(graph);
+
+        std::vector<const h1st::concurrent_node*> tracked;
+        graph.track(files.begin(), files.end(),
+            std::back_inserter(tracked), false);
+
+        ASSERT_EQ(1u, tracked.size());
+
+        graph.push_node("new_x", files.begin(), files.end());
+
+        // The shadowed node is still readable inside the section
+
+        EXPECT_EQ(1u, graph.reclaim());
+        EXPECT_EQ("old_x", tracked[0]->command());
+    }
+
+    EXPECT_EQ(0u, graph.reclaim());
+    EXPECT_EQ("new_x x \n", dump(graph));
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentSharedCommands)
+{
+    h1st::concurrent_hist_graph graph;
+
+    std::vector<std::string> x(1, "x");
+    std::vector<std::string> y(1, "y");
+
+    const h1st::concurrent_node* node_x = graph.push_node("touch",
+        x.begin(), x.end());
+    const h1st::concurrent_node* node_y = graph.push_node("touch",
+        y.begin(), y.end());
+
+    EXPECT_EQ("touch", node_x->command());
+    EXPECT_EQ(node_x->command().entry(), node_y->command().entry());
+
+    graph.push_node("rm", x.begin(), x.end());
+    graph.push_node("rm", y.begin(), y.end());
+
+    EXPECT_EQ(0u, graph.reclaim());
+    EXPECT_EQ("rm x \nrm y \n", dump(graph));
+}
+
+/**
+ *
+ */
+struct reader_context
+{
+    h1st::concurrent_hist_graph* graph;
+    int num_queries;
+    int num_errors;
+};
+
+/**
+ *
+ */
+void* run_reader(
+    void* arg
+)
+{
+    reader_context* context = static_cast<reader_context*>(arg);
+
+    for (int i = 0; i < context->num_queries; i++)
+    {
+        std::stringstream file;
+        file << "f" << (i % 64);
+
+        const std::string name = file.str();
+
+        h1st::concurrent_hist_graph::read_section section(*context->graph);
+
+        std::vector<const h1st::concurrent_node*> tracked;
+        context->graph->track(&name, &name + 1,
+            std::back_inserter(tracked), true);
+
+        // Every node must come after its inputs and still be intact
+
+        for (size_t j = 0; j < tracked.size(); j++)
+        {
+            const h1st::concurrent_node* node = tracked[j];
+
+            if (node->command().empty() || node->files_out().empty())
+                context->num_errors++;
+
+            for (size_t k = 0; k < node->nodes_in().size(); k++)
+                if (node->nodes_in()[k].node()->uuid() >= node->uuid())
+                    context->num_errors++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentReadersAndWriter)
+{
+    const int num_readers = 4;
+
+    h1st::concurrent_hist_graph graph;
+
+    std::vector<pthread_t> threads(num_readers);
+    std::vector<reader_context> contexts(num_readers);
+
+    for (int i = 0; i < num_readers; i++)
+    {
+        contexts[i].graph = &graph;
+        contexts[i].num_queries = 2000;
+        contexts[i].num_errors = 0;
+
+        ASSERT_EQ(0, pthread_create(&threads[i], 0, run_reader,
+            &contexts[i]));
+    }
+
+    std::vector<std::string> files_in(1);
+    std::vector<std::string> files_out(1);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        std::stringstream file_in;
+        std::stringstream file_out;
+
+        file_in << "f" << ((i + 63) % 64);
+        file_out << "f" << (i % 64);
+
+        files_in[0] = file_in.str();
+        files_out[0] = file_out.str();
+
+        // Restart the chain every few steps so old nodes get released
+
+        if (i % 8 != 0 && graph.has_input(files_in[0]))
+            graph.push_node(files_in.begin(), files_in.end(), "step",
+                files_out.begin(), files_out.end());
+        else
+            graph.push_node("step", files_out.begin(), files_out.end());
+    }
+
+    for (int i = 0; i < num_readers; i++)
+    {
+        ASSERT_EQ(0, pthread_join(threads[i], 0));
+        EXPECT_EQ(0, contexts[i].num_errors);
+    }
+
+    EXPECT_EQ(0u, graph.reclaim());
+}
+
+/**
+ *
+ */
+void* run_query(
+    void* arg
+)
+{
+    h1st::concurrent_hist_graph* graph =
+        static_cast<h1st::concurrent_hist_graph*>(arg);
+
+    try
+    {
+        graph->has_input("x");
+    }
+    catch (const h1st::reader_limit_exception&)
+    {
+        return arg;
+    }
+
+    return 0;
+}
+
+/**
+ *
+ */
+TEST(HistorianTest, ConcurrentReaderLimit)
+{
+    h1st::concurrent_hist_graph graph(1);
+
+    EXPECT_FALSE(graph.has_input("x"));
+
+    pthread_t thread;
+    void* result = 0;
+
+    ASSERT_EQ(0, pthread_create(&thread, 0, run_query, &graph));
+    ASSERT_EQ(0, pthread_join(thread, &result));
+
+    EXPECT_EQ(&graph, result);
+}
+
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/graph_policies.hpp>
+#include <h1st/historian.hpp>
+#include <h1st/parallel_visit.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+std::string file_name(
+    int index
+)
+{
+    std::stringstream ss;
+    ss << "file" << index;
+    return ss.str();
+}
+
+/**
+ *
+ */
+void make_random_dag(
+    h1st::hist_graph& graph,
+    int num_files,
+    int num_steps
+)
+{
+    unsigned int seed = 12345;
+
+    for (int i = 0; i < num_files; i++)
+    {
+        std::vector<std::string> files_out(1, file_name(i));
+        graph.push_node("source", files_out.begin(), files_out.end());
+    }
+
+    for (int i = 0; i < num_steps; i++)
+    {
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        for (int j = 0; j < 3; j++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            files_in.push_back(file_name(static_cast<int>(
+                (seed >> 8) % static_cast<unsigned int>(num_files))));
+        }
+
+        seed = seed * 1103515245u + 12345u;
+        files_out.push_back(file_name(static_cast<int>(
+            (seed >> 8) % static_cast<unsigned int>(num_files))));
+
+        graph.push_node(files_in.begin(), files_in.end(), "step",
+            files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, MatchesTrack)
+{
+    h1st::hist_graph graph;
+    make_random_dag(graph, 500, 20000);
+
+    std::vector<std::string> files;
+    for (int i = 0; i < 500; i += 7)
+        files.push_back(file_name(i));
+
+    std::vector<const h1st::hist_node*> expected;
+    graph.track(files.begin(), files.end(),
+        std::back_inserter(expected), false);
+
+    const size_t num_threads[] = {1, 2, 4, 16};
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        std::vector<const h1st::hist_node*> nodes;
+        ASSERT_TRUE(graph.track_parallel(files.begin(), files.end(),
+            std::back_inserter(nodes), false, num_threads[i]));
+
+        EXPECT_EQ(expected, nodes);
+    }
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, DeepChain)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_name(0));
+
+    graph.push_node("command", files_out.begin(), files_out.end());
+
+    for (int i = 1; i < 100000; i++)
+    {
+        files_in.swap(files_out);
+        files_out.assign(1, file_name(i));
+
+        graph.push_node(files_in.begin(), files_in.end(), "command",
+            files_out.begin(), files_out.end());
+    }
+
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track_parallel(files_out.begin(), files_out.end(),
+        std::back_inserter(nodes), false, 4);
+
+    ASSERT_EQ(100000, nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++)
+        ASSERT_EQ(static_cast<int>(i), nodes[i]->uuid());
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, CountsEdges)
+{
+    h1st::basic_hist_graph<h1st::counting_stats> graph;
+
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_name(0));
+
+    graph.push_node("command", files_out.begin(), files_out.end());
+
+    for (int i = 1; i < 20000; i++)
+    {
+        files_in.assign(1, file_name(i - 1));
+        files_in.push_back(file_name(i / 2));
+        files_out.assign(1, file_name(i));
+
+        graph.push_node(files_in.begin(), files_in.end(), "command",
+            files_out.begin(), files_out.end());
+    }
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    graph.track(files_out.begin(), files_out.end(),
+        std::back_inserter(nodes), false);
+
+    const size_t edges = graph.stats().edges_traversed();
+
+    ASSERT_EQ(2u * 19999u, edges);
+
+    graph.stats().reset();
+    nodes.clear();
+
+    graph.track_parallel(files_out.begin(), files_out.end(),
+        std::back_inserter(nodes), false, 4);
+
+    ASSERT_EQ(20000u, nodes.size());
+    ASSERT_EQ(edges, graph.stats().edges_traversed());
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, MissingInput)
+{
+    h1st::hist_graph graph;
+    make_random_dag(graph, 10, 100);
+
+    std::vector<std::string> files;
+    files.push_back(file_name(3));
+    files.push_back("missing");
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    ASSERT_THROW(graph.track_parallel(files.begin(), files.end(),
+        std::back_inserter(nodes), false, 4),
+        h1st::input_not_found_exception);
+
+    ASSERT_FALSE(graph.track_parallel(files.begin(), files.end(),
+        std::back_inserter(nodes), true, 4));
+
+    std::vector<const h1st::hist_node*> expected;
+    graph.track(files.begin(), files.begin() + 1,
+        std::back_inserter(expected), false);
+
+    ASSERT_EQ(expected, nodes);
+}
+
+struct chain_node;
+
+/**
+ *
+ */
+struct chain_input
+{
+    const chain_node* input;
+
+    const chain_node* node(
+    ) const
+    {
+        return input;
+    }
+};
+
+/**
+ * Node of a chain that throws when the walk reaches the broken node
+ */
+struct chain_node
+{
+    int index;
+    int broken;
+    std::vector<chain_input> inputs;
+
+    int uuid(
+    ) const
+    {
+        return index;
+    }
+
+    const std::vector<chain_input>& nodes_in(
+    ) const
+    {
+        if (index == broken)
+            throw std::domain_error("broken node");
+
+        return inputs;
+    }
+};
+
+/**
+ *
+ */
+void make_chain(
+    std::vector<chain_node>& nodes,
+    int broken
+)
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        nodes[i].index = static_cast<int>(i);
+        nodes[i].broken = broken;
+
+        if (i > 0)
+        {
+            chain_input input = { &nodes[i - 1] };
+            nodes[i].inputs.push_back(input);
+        }
+    }
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, WorkerException)
+{
+    std::vector<chain_node> nodes(100000);
+    make_chain(nodes, 10);
+
+    const chain_node* root = &nodes.back();
+
+    h1st::parallel_visitor<chain_node> visitor(nodes.size());
+
+    ASSERT_THROW(visitor.run(&root, &root + 1, 4), std::domain_error);
+}
+
+/**
+ *
+ */
+TEST(TestParallelTrack, SmallWalk)
+{
+    std::vector<chain_node> nodes(100);
+    make_chain(nodes, -1);
+
+    const chain_node* root = &nodes[50];
+
+    h1st::parallel_visitor<chain_node> visitor(nodes.size());
+    visitor.run(&root, &root + 1, 4);
+
+    ASSERT_EQ(0u, visitor.next(0));
+    ASSERT_EQ(50u, visitor.next(50));
+    ASSERT_EQ(100u, visitor.next(51));
+}
+
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+std::string file_name(
+    int index
+)
+{
+    std::stringstream ss;
+    ss << "file" << index;
+    return ss.str();
+}
+
+/**
+ *
+ */
+void make_chain(
+    h1st::hist_graph& graph,
+    int length
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_name(0));
+
+    graph.push_node("command 0", files_out.begin(), files_out.end());
+
+    for (int i = 1; i < length; i++)
+    {
+        std::stringstream command;
+        command << "command " << i;
+
+        files_in.swap(files_out);
+        files_out.assign(1, file_name(i));
+
+        graph.push_node(files_in.begin(), files_in.end(), command.str(),
+            files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ *
+ */
+TEST(TestProvenance, ReverseOfTrack)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_out(1, "a");
+    graph.push_node("make_a", files_out.begin(), files_out.end());
+    files_out[0] = "b";
+    graph.push_node("make_b", files_out.begin(), files_out.end());
+    files_out[0] = "c";
+    graph.push_node("make_c", files_out.begin(), files_out.end());
+
+    const char* in_d[] = {"a", "b"};
+    const char* in_e[] = {"c", "a"};
+    const char* in_f[] = {"d", "e"};
+
+    files_out[0] = "d";
+    graph.push_node(in_d, in_d + 2, "make_d",
+        files_out.begin(), files_out.end());
+    files_out[0] = "e";
+    graph.push_node(in_e, in_e + 2, "make_e",
+        files_out.begin(), files_out.end());
+    files_out[0] = "f";
+    graph.push_node(in_f, in_f + 2, "make_f",
+        files_out.begin(), files_out.end());
+
+    const char* query[] = {"f", "e"};
+
+    std::vector<const h1st::hist_node*> expected;
+    graph.track(query, query + 2, std::back_inserter(expected), false);
+
+    h1st::provenance_range<h1st::hist_node> range = graph.ancestors(
+        query, query + 2, false);
+
+    std::vector<const h1st::hist_node*> nodes(range.begin(), range.end());
+
+    ASSERT_EQ(6, nodes.size());
+    ASSERT_EQ(std::vector<const h1st::hist_node*>(
+        expected.rbegin(), expected.rend()), nodes);
+    ASSERT_TRUE(range.found_all());
+    ASSERT_TRUE(range.empty());
+}
+
+/**
+ *
+ */
+TEST(TestProvenance, StopEarly)
+{
+    h1st::hist_graph graph;
+    make_chain(graph, 100000);
+
+    const std::string file = file_name(99999);
+
+    h1st::provenance_range<h1st::hist_node> range = graph.ancestors(
+        &file, &file + 1, false);
+
+    h1st::provenance_range<h1st::hist_node>::iterator it = range.begin();
+
+    while (it != range.end() && (*it)->command() != "command 99995")
+        ++it;
+
+    ASSERT_TRUE(it != range.end());
+    ASSERT_EQ(99995, (*it)->uuid());
+    ASSERT_EQ(5, range.num_discovered());
+}
+
+/**
+ *
+ */
+TEST(TestProvenance, MissingInput)
+{
+    h1st::hist_graph graph;
+    make_chain(graph, 10);
+
+    std::vector<std::string> files;
+    files.push_back(file_name(4));
+    files.push_back("missing");
+
+    ASSERT_THROW(graph.ancestors(files.begin(), files.end(), false),
+        h1st::input_not_found_exception);
+
+    h1st::provenance_range<h1st::hist_node> range = graph.ancestors(
+        files.begin(), files.end(), true);
+
+    ASSERT_FALSE(range.found_all());
+    ASSERT_EQ(5, std::distance(range.begin(), range.end()));
+
+    h1st::provenance_range<h1st::hist_node> none = graph.ancestors(
+        files.begin() + 1, files.end(), true);
+
+    ASSERT_TRUE(none.begin() == none.end());
+}
+
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class collect_nodes
+{
+public:
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    void operator ()(
+        const h1st::hist_node* node
+    )
+    {
+        nodes.push_back(node);
+    }
+};
+
+/**
+ *
+ */
+std::vector<std::string> dependents(
+    const h1st::hist_graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const h1st::hist_node*> nodes;
+    graph.dependents(&file, &file + 1, std::back_inserter(nodes), false);
+
+    std::vector<std::string> commands;
+    for (size_t i = 0; i < nodes.size(); i++)
+        commands.push_back(nodes[i]->command().str());
+
+    return commands;
+}
+
+/**
+ *
+ */
+void push(
+    h1st::hist_graph& graph,
+    const std::string& files_in,
+    const std::string& command,
+    const std::string& files_out
+)
+{
+    std::vector<std::string> in;
+    std::vector<std::string> out;
+
+    std::stringstream ss_in(files_in);
+    std::stringstream ss_out(files_out);
+    std::string file;
+
+    while (ss_in >> file)
+        in.push_back(file);
+
+    while (ss_out >> file)
+        out.push_back(file);
+
+    graph.push_node(in.begin(), in.end(), command, out.begin(), out.end());
+}
+
+/**
+ *
+ */
+TEST(TestDependents, Diamond)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "make_a", "a");
+    push(graph, "a", "make_b", "b");
+    push(graph, "a", "make_c", "c");
+    push(graph, "b c", "make_d", "d");
+
+    std::vector<std::string> from_a = dependents(graph, "a");
+
+    ASSERT_EQ(3, from_a.size());
+    ASSERT_EQ("make_d", from_a[2]);
+
+    std::vector<std::string> from_b = dependents(graph, "b");
+
+    ASSERT_EQ(1, from_b.size());
+    ASSERT_EQ("make_d", from_b[0]);
+
+    ASSERT_TRUE(dependents(graph, "d").empty());
+}
+
+/**
+ *
+ */
+TEST(TestDependents, OnlyConsumersOfTheFile)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "make_xy", "x y");
+    push(graph, "x", "use_x", "z");
+
+    ASSERT_EQ(std::vector<std::string>(1, "use_x"), dependents(graph, "x"));
+    ASSERT_TRUE(dependents(graph, "y").empty());
+}
+
+/**
+ *
+ */
+TEST(TestDependents, ReleasedConsumers)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "make_a", "a");
+
+    for (int i = 0; i < 100; i++)
+    {
+        std::stringstream command;
+        command << "make_b " << i;
+        push(graph, "a", command.str(), "b");
+    }
+
+    ASSERT_EQ(std::vector<std::string>(1, "make_b 99"),
+        dependents(graph, "a"));
+
+    std::vector<std::string> missing(1, "missing");
+    std::vector<const h1st::hist_node*> nodes;
+
+    ASSERT_THROW(graph.dependents(missing.begin(), missing.end(),
+        std::back_inserter(nodes), false), h1st::input_not_found_exception);
+    ASSERT_FALSE(graph.dependents(missing.begin(), missing.end(),
+        std::back_inserter(nodes), true));
+}
+
+/**
+ *
+ */
+TEST(TestDependents, MatchesFullScan)
+{
+    h1st::hist_graph graph;
+
+    const int num_files = 50;
+    unsigned int seed = 4321;
+
+    for (int i = 0; i < num_files; i++)
+    {
+        std::stringstream file;
+        file << "f" << i;
+        push(graph, "", "source", file.str());
+    }
+
+    for (int i = 0; i < 2000; i++)
+    {
+        std::stringstream files_in;
+        std::stringstream file_out;
+
+        for (int j = 0; j < 2; j++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            files_in << "f" << (seed >> 8) % num_files << " ";
+        }
+
+        seed = seed * 1103515245u + 12345u;
+        file_out << "f" << (seed >> 8) % num_files;
+
+        push(graph, files_in.str(), "step", file_out.str());
+    }
+
+    collect_nodes printer;
+    graph.print(printer);
+
+    for (int f = 0; f < num_files; f++)
+    {
+        std::stringstream ss;
+        ss << "f" << f;
+
+        const std::string file = ss.str();
+        const h1st::path_id id = graph.paths().find(file);
+        const h1st::hist_node* producer = graph.binding(id);
+
+        // Nodes are printed in topological order, so a single pass
+        // propagates the change downstream
+
+        std::set<const h1st::hist_node*> expected;
+
+        for (size_t i = 0; i < printer.nodes.size(); i++)
+        {
+            const h1st::hist_node* node = printer.nodes[i];
+
+            for (size_t j = 0; j < node->nodes_in().size(); j++)
+            {
+                const h1st::node_input& input = node->nodes_in()[j];
+
+                if ((input.node() == producer && input.file_id() == id) ||
+                    expected.count(input.node()) != 0)
+                    expected.insert(node);
+            }
+        }
+
+        std::vector<const h1st::hist_node*> nodes;
+        graph.dependents(&file, &file + 1,
+            std::back_inserter(nodes), false);
+
+        ASSERT_EQ(expected,
+            std::set<const h1st::hist_node*>(nodes.begin(), nodes.end()));
+        ASSERT_EQ(expected.size(), nodes.size());
+
+        std::set<const h1st::hist_node*> emitted;
+
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            for (size_t j = 0; j < nodes[i]->nodes_in().size(); j++)
+            {
+                const h1st::hist_node* input = nodes[i]->nodes_in()[j].node();
+
+                if (expected.count(input) != 0)
+                {
+                    ASSERT_EQ(1, emitted.count(input));
+                }
+            }
+
+            emitted.insert(nodes[i]);
+        }
+    }
+}
+
+}
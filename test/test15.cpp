@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/build_cache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Graph whose step keys can be forced to collide with a recorded one
+ */
+class colliding_graph :
+    public h1st::hist_graph
+{
+public:
+
+    boost::uint64_t forced_key;
+
+    colliding_graph(
+    ) :
+        h1st::hist_graph(),
+        forced_key(0)
+    {
+    }
+
+    template <typename ITF>
+    boost::uint64_t step_key(
+        ITF files_in_begin,
+        ITF files_in_end,
+        const std::string& command
+    ) const
+    {
+        if (forced_key != 0)
+            return forced_key;
+
+        return h1st::hist_graph::step_key(files_in_begin, files_in_end,
+            command);
+    }
+};
+
+/**
+ *
+ */
+std::vector<std::string> files(
+    const char* a,
+    const char* b = 0
+)
+{
+    std::vector<std::string> result(1, a);
+
+    if (b != 0)
+        result.push_back(b);
+
+    return result;
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, HitAndMiss)
+{
+    h1st::hist_graph graph;
+    h1st::build_cache<h1st::hist_graph> cache(graph);
+
+    const std::vector<std::string> src = files("main.c");
+    const std::vector<std::string> obj = files("main.o");
+
+    ASSERT_EQ(0, cache.lookup("edit"));
+    cache.push_node("edit", src.begin(), src.end());
+
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -c"));
+    const h1st::hist_node* node = cache.push_node(src.begin(), src.end(),
+        "cc -c", obj.begin(), obj.end());
+
+    ASSERT_EQ(node, cache.lookup(src.begin(), src.end(), "cc -c"));
+    ASSERT_EQ("main.o", node->files_out()[0].str());
+
+    // A different command on the same inputs is a different step
+
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -O2 -c"));
+
+    ASSERT_EQ(1, cache.hits());
+    ASSERT_EQ(3, cache.misses());
+    ASSERT_EQ(2, cache.size());
+
+    cache.reset_counters();
+
+    ASSERT_EQ(0, cache.hits());
+    ASSERT_EQ(0, cache.misses());
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, UpstreamChange)
+{
+    h1st::hist_graph graph;
+    h1st::build_cache<h1st::hist_graph> cache(graph);
+
+    const std::vector<std::string> src = files("main.c");
+    const std::vector<std::string> obj = files("main.o");
+
+    cache.push_node("edit 1", src.begin(), src.end());
+    cache.push_node(src.begin(), src.end(), "cc -c", obj.begin(), obj.end());
+
+    const boost::uint64_t key = graph.step_key(src.begin(), src.end(),
+        "cc -c");
+
+    // A new producer of the input changes the key of the step
+
+    cache.push_node("edit 2", src.begin(), src.end());
+
+    ASSERT_NE(key, graph.step_key(src.begin(), src.end(), "cc -c"));
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -c"));
+
+    // Recreating the same history brings the key back
+
+    cache.push_node("edit 1", src.begin(), src.end());
+
+    ASSERT_EQ(key, graph.step_key(src.begin(), src.end(), "cc -c"));
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, OutputOverwritten)
+{
+    h1st::hist_graph graph;
+    h1st::build_cache<h1st::hist_graph> cache(graph);
+
+    const std::vector<std::string> src = files("main.c");
+    const std::vector<std::string> out = files("main.o", "main.d");
+    const std::vector<std::string> dep = files("main.d");
+
+    cache.push_node("edit", src.begin(), src.end());
+    cache.push_node(src.begin(), src.end(), "cc -MD -c",
+        out.begin(), out.end());
+
+    ASSERT_NE(static_cast<const h1st::hist_node*>(0),
+        cache.lookup(src.begin(), src.end(), "cc -MD -c"));
+
+    graph.push_node("touch main.d", dep.begin(), dep.end());
+
+    // The stale entry is dropped by the lookup that finds it
+
+    ASSERT_EQ(2, cache.size());
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -MD -c"));
+    ASSERT_EQ(1, cache.size());
+
+    const std::vector<std::string> missing = files("missing.c");
+
+    ASSERT_THROW(cache.lookup(missing.begin(), missing.end(), "cc -c"),
+        h1st::input_not_found_exception);
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, InputRebound)
+{
+    colliding_graph graph;
+    h1st::build_cache<colliding_graph> cache(graph);
+
+    const std::vector<std::string> src = files("main.c");
+    const std::vector<std::string> obj = files("main.o");
+
+    cache.push_node("edit 1", src.begin(), src.end());
+    const h1st::hist_node* node = cache.push_node(src.begin(), src.end(),
+        "cc -c", obj.begin(), obj.end());
+
+    graph.push_node("edit 2", src.begin(), src.end());
+
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -c"));
+
+    // Even with a colliding key the node read another producer
+
+    graph.forced_key = node->key();
+
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -c"));
+    ASSERT_EQ(2, cache.size());
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, CollidingSteps)
+{
+    colliding_graph graph;
+    h1st::build_cache<colliding_graph> cache(graph);
+
+    const std::vector<std::string> src = files("main.c", "util.c");
+    const std::vector<std::string> obj = files("main.o");
+
+    cache.push_node("edit", src.begin(), src.end());
+    const h1st::hist_node* node = cache.push_node(src.begin(),
+        src.begin() + 1, "cc -c", obj.begin(), obj.end());
+
+    graph.forced_key = node->key();
+
+    ASSERT_EQ(node, cache.lookup(src.begin(), src.begin() + 1, "cc -c"));
+
+    // Same outputs and key, but another command or other inputs
+
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.begin() + 1, "cc -O2 -c"));
+    ASSERT_EQ(0, cache.lookup(src.begin() + 1, src.end(), "cc -c"));
+    ASSERT_EQ(0, cache.lookup(src.begin(), src.end(), "cc -c"));
+
+    ASSERT_EQ(1, cache.hits());
+    ASSERT_EQ(3, cache.misses());
+    ASSERT_EQ(2, cache.size());
+}
+
+/**
+ *
+ */
+TEST(TestBuildCache, SaveAndLoad)
+{
+    const std::string file = "test15_cache.bin";
+
+    const std::vector<std::string> src = files("main.c");
+    const std::vector<std::string> obj = files("main.o");
+
+    {
+        h1st::hist_graph graph;
+        h1st::build_cache<h1st::hist_graph> cache(graph);
+
+        cache.push_node("edit", src.begin(), src.end());
+        cache.push_node(src.begin(), src.end(), "cc -c",
+            obj.begin(), obj.end());
+
+        cache.save(file);
+    }
+
+    // The keys do not depend on addresses or uuids, so the entries
+    // match a graph rebuilt from the same history
+
+    h1st::hist_graph graph;
+    graph.push_node("edit", src.begin(), src.end());
+    graph.push_node(src.begin(), src.end(), "cc -c", obj.begin(), obj.end());
+
+    h1st::build_cache<h1st::hist_graph> cache(graph);
+    cache.load(file);
+
+    ASSERT_EQ(2, cache.size());
+    ASSERT_NE(static_cast<const h1st::hist_node*>(0),
+        cache.lookup(src.begin(), src.end(), "cc -c"));
+
+    {
+        std::ofstream stream(file.c_str(), std::ios::out |
+            std::ios::binary | std::ios::trunc);
+        stream << "H1STBCH";
+    }
+
+    ASSERT_THROW(cache.load(file), h1st::invalid_format_exception);
+
+    std::remove(file.c_str());
+
+    ASSERT_THROW(cache.load(file), h1st::io_exception);
+}
+
+}
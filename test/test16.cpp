@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/command_store.hpp>
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+TEST(TestCommandStore, Deduplicate)
+{
+    h1st::command_store store;
+
+    const h1st::command_entry* a = store.acquire("gcc -c a.c");
+    const h1st::command_entry* b = store.acquire(std::string("gcc -c a.c"));
+    const h1st::command_entry* c = store.acquire("gcc -c b.c");
+
+    ASSERT_EQ(a, b);
+    ASSERT_NE(a, c);
+    ASSERT_EQ(2, store.size());
+
+    store.release(a);
+    ASSERT_EQ(2, store.size());
+
+    store.release(b);
+    ASSERT_EQ(1, store.size());
+
+    ASSERT_EQ("gcc -c b.c", h1st::command_ref(c).str());
+
+    store.release(c);
+    ASSERT_EQ(0, store.size());
+}
+
+/**
+ *
+ */
+TEST(TestCommandStore, Tokenized)
+{
+    h1st::command_store store(h1st::command_store::encoding_tokenized);
+
+    const std::string text = "gcc  -O2 -c src/a.c -o obj/a.o ";
+    const h1st::command_ref a(store.acquire(text));
+    const h1st::command_ref b(store.acquire("gcc  -O2 -c src/b.c -o obj/b.o "));
+
+    ASSERT_EQ(text, a.str());
+    ASSERT_EQ(text.size(), a.size());
+    ASSERT_EQ(std::string(a.begin(), a.end()), text);
+    ASSERT_TRUE(a == text);
+    ASSERT_TRUE(a != b);
+    ASSERT_EQ(h1st::path_table::hash(text), a.hash());
+
+    // "gcc ", " ", "-O2 ", "-c ", "-o " are shared between both commands
+
+    ASSERT_EQ(9, store.num_tokens());
+
+    std::stringstream ss;
+    ss << a;
+    ASSERT_EQ(text, ss.str());
+
+    ASSERT_TRUE(a.compare("gcc") > 0);
+    ASSERT_TRUE(a.compare("gcc  -O2 -c src/a.c -o obj/a.o  x") < 0);
+    ASSERT_TRUE(a.compare("gcc  -O2 -c src/b.c") < 0);
+
+    const h1st::command_ref empty(store.acquire(""));
+
+    ASSERT_TRUE(empty.empty());
+    ASSERT_TRUE(empty.begin() == empty.end());
+    ASSERT_EQ("", empty.str());
+}
+
+/**
+ *
+ */
+TEST(TestCommandStore, ReuseAfterRelease)
+{
+    h1st::command_store store;
+    std::vector<const h1st::command_entry*> entries;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        std::stringstream ss;
+        ss << "command " << i;
+        entries.push_back(store.acquire(ss.str()));
+    }
+
+    for (int i = 0; i < 1000; i += 2)
+        store.release(entries[i]);
+
+    ASSERT_EQ(500, store.size());
+
+    // Backward shift deletion must keep every remaining entry reachable
+
+    for (int i = 1; i < 1000; i += 2)
+    {
+        std::stringstream ss;
+        ss << "command " << i;
+        ASSERT_EQ(entries[i], store.acquire(ss.str()));
+    }
+}
+
+/**
+ *
+ */
+TEST(TestCommandStore, GraphSharesCommands)
+{
+    h1st::hist_graph graph(h1st::command_store::encoding_tokenized);
+
+    for (int i = 0; i < 100; i++)
+    {
+        std::stringstream file;
+        file << "out" << i % 10;
+
+        std::vector<std::string> files_out(1, file.str());
+        graph.push_node("touch " + file.str(),
+            files_out.begin(), files_out.end());
+    }
+
+    ASSERT_EQ(10, graph.commands().size());
+    ASSERT_EQ(11, graph.commands().num_tokens());
+    ASSERT_TRUE(graph.has_input("out3"));
+
+    std::vector<const h1st::hist_node*> nodes;
+    const std::string file = "out3";
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    ASSERT_EQ(1, nodes.size());
+    ASSERT_EQ("touch out3", nodes[0]->command());
+}
+
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/output_buffer.hpp>
+#include <h1st/concurrent.hpp>
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+template <typename Graph>
+void make_graph(
+    Graph& graph
+)
+{
+    for (int i = 0; i < 200; i++)
+    {
+        std::stringstream command;
+        command << "command " << i;
+
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out;
+
+        if (i > 0)
+            files_in.push_back(i % 3 == 0 ? "a" : "b");
+
+        files_out.push_back(i % 2 == 0 ? "b" : "a");
+
+        if (files_in.empty() || !graph.has_input(files_in[0]))
+            graph.push_node(command.str(), files_out.begin(), files_out.end());
+        else
+            graph.push_node(files_in.begin(), files_in.end(), command.str(),
+                files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print_stream(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    h1st::hist_node_print_to_stream printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print_buffered(
+    const Graph& graph,
+    size_t capacity
+)
+{
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss, capacity);
+        h1st::hist_node_print_buffered printer(&buffer);
+        graph.print(printer);
+        buffer.flush();
+    }
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestOutputBuffer, SameAsStreamPrinter)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    const std::string expected = print_stream(graph);
+
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected, print_buffered(graph, 1));
+    ASSERT_EQ(expected, print_buffered(graph, 7));
+    ASSERT_EQ(expected, print_buffered(graph,
+        h1st::output_buffer::default_capacity));
+
+    ASSERT_EQ(expected, print_buffered(graph.snapshot(), 64));
+}
+
+/**
+ *
+ */
+TEST(TestOutputBuffer, ConcurrentGraph)
+{
+    h1st::concurrent_hist_graph graph;
+    make_graph(graph);
+
+    ASSERT_EQ(print_stream(graph), print_buffered(graph, 16));
+}
+
+/**
+ *
+ */
+TEST(TestOutputBuffer, Integers)
+{
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss, 4);
+
+        buffer.append(0);
+        buffer.append(' ');
+        buffer.append(-12345);
+        buffer.append(' ');
+        buffer.append(static_cast<boost::uint64_t>(18446744073709551615ULL));
+        buffer.append(' ');
+        buffer.append(static_cast<boost::uint32_t>(4294967295u));
+    }
+
+    ASSERT_EQ("0 -12345 18446744073709551615 4294967295", ss.str());
+}
+
+/**
+ *
+ */
+TEST(TestOutputBuffer, FileDescriptor)
+{
+    const std::string file = "test17_output.txt";
+
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_TRUE(fd >= 0);
+
+    {
+        h1st::output_buffer buffer(fd, 100);
+        h1st::hist_node_print_buffered printer(&buffer);
+        graph.print(printer);
+        buffer.flush();
+    }
+
+    ::close(fd);
+
+    std::ifstream stream(file.c_str());
+    std::stringstream contents;
+    contents << stream.rdbuf();
+
+    ASSERT_EQ(print_stream(graph), contents.str());
+
+    std::remove(file.c_str());
+
+    ASSERT_THROW(h1st::output_buffer(-1), h1st::null_value_exception);
+    ASSERT_THROW(h1st::hist_node_print_buffered(0),
+        h1st::null_value_exception);
+}
+
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/exporters.hpp>
+#include <h1st/historian.hpp>
+#include <h1st/snapshot.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+void make_graph(
+    h1st::hist_graph& graph
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out;
+
+    files_out.push_back("a.c");
+    graph.push_node("gen \"a\"", files_out.begin(), files_out.end());
+
+    files_in.push_back("a.c");
+    files_out.clear();
+    files_out.push_back("a\\b.o");
+    files_out.push_back("a.d");
+    graph.push_node(files_in.begin(), files_in.end(), "cc\t-c a.c",
+        files_out.begin(), files_out.end());
+
+    files_in.clear();
+    files_in.push_back("a\\b.o");
+    files_out.clear();
+    files_out.push_back("app");
+    graph.push_node(files_in.begin(), files_in.end(), "ld a\\b.o",
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+TEST(TestExporters, Dot)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss, 8);
+        h1st::hist_node_export_dot exporter(&buffer);
+        graph.print(exporter);
+        exporter.close();
+    }
+
+    ASSERT_EQ(
+        "digraph h1st {\n"
+        "  n0 [label=\"gen \\\"a\\\"\\na.c\"];\n"
+        "  n1 [label=\"cc -c a.c\\na\\\\b.o\\na.d\"];\n"
+        "  n0 -> n1 [label=\"a.c\"];\n"
+        "  n2 [label=\"ld a\\\\b.o\\napp\"];\n"
+        "  n1 -> n2 [label=\"a\\\\b.o\"];\n"
+        "}\n", ss.str());
+}
+
+/**
+ *
+ */
+TEST(TestExporters, JsonLines)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+        graph.print(exporter);
+    }
+
+    ASSERT_EQ(
+        "{\"uuid\":0,\"command\":\"gen \\\"a\\\"\",\"inputs\":[],"
+            "\"outputs\":[\"a.c\"]}\n"
+        "{\"uuid\":1,\"command\":\"cc\\u0009-c a.c\",\"inputs\":"
+            "[{\"file\":\"a.c\",\"uuid\":0}],"
+            "\"outputs\":[\"a\\\\b.o\",\"a.d\"]}\n"
+        "{\"uuid\":2,\"command\":\"ld a\\\\b.o\",\"inputs\":"
+            "[{\"file\":\"a\\\\b.o\",\"uuid\":1}],"
+            "\"outputs\":[\"app\"]}\n", ss.str());
+}
+
+/**
+ *
+ */
+TEST(TestExporters, TrackIterator)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    std::vector<std::string> files;
+    files.push_back("a.d");
+
+    std::stringstream expected;
+    std::stringstream ss;
+
+    {
+        std::vector<const h1st::hist_node*> nodes;
+        graph.track(files.begin(), files.end(), std::back_inserter(nodes),
+            false);
+
+        h1st::output_buffer buffer(&expected);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+
+        for (size_t i = 0; i < nodes.size(); i++)
+            exporter(nodes[i]);
+    }
+
+    {
+        h1st::output_buffer buffer(&ss);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+        graph.track(files.begin(), files.end(),
+            h1st::make_printer_iterator(exporter), false);
+    }
+
+    const std::string lines = expected.str();
+
+    ASSERT_EQ(2, std::count(lines.begin(), lines.end(), '\n'));
+    ASSERT_EQ(expected.str(), ss.str());
+}
+
+/**
+ *
+ */
+TEST(TestExporters, Snapshot)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    std::stringstream expected;
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&expected);
+        h1st::hist_node_export_dot exporter(&buffer);
+        graph.print(exporter);
+        exporter.close();
+    }
+
+    {
+        h1st::output_buffer buffer(&ss);
+        h1st::hist_node_export_dot exporter(&buffer);
+        graph.snapshot().print(exporter);
+        exporter.close();
+    }
+
+    ASSERT_EQ(expected.str(), ss.str());
+
+    ASSERT_THROW(h1st::hist_node_export_dot(0), h1st::null_value_exception);
+    ASSERT_THROW(h1st::hist_node_export_jsonl(0),
+        h1st::null_value_exception);
+}
+
+}
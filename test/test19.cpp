@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/loader.hpp>
+#include <h1st/exporters.hpp>
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+void push(
+    h1st::hist_graph& graph,
+    const std::string& file_in,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+const h1st::hist_node* node_of(
+    const h1st::hist_graph& graph,
+    const std::string& file
+)
+{
+    return graph.binding(graph.paths().find(file));
+}
+
+/**
+ *
+ */
+void make_graph(
+    h1st::hist_graph& graph
+)
+{
+    // b is built from the first a, which is then rewritten, so the
+    // input of the second node can only be restored through its uuid
+
+    push(graph, "", "gen a", "a");
+    push(graph, "a", "cc -o b a", "b");
+    push(graph, "", "gen \"a\"\t2", "a");
+    push(graph, "b", "x(0) y", "c");
+    push(graph, "a", "", "d");
+}
+
+/**
+ *
+ */
+std::string print(
+    const h1st::hist_graph& graph
+)
+{
+    std::stringstream ss;
+    h1st::hist_node_print_to_stream printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+std::string export_jsonl(
+    const h1st::hist_graph& graph
+)
+{
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+        graph.print(exporter);
+    }
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+struct linked
+{
+    std::vector<std::string> in;
+    std::vector<size_t> src;
+    std::string cmd;
+    std::vector<std::string> out;
+
+    const std::vector<std::string>& files_in(
+    ) const
+    {
+        return in;
+    }
+
+    const std::vector<size_t>& sources(
+    ) const
+    {
+        return src;
+    }
+
+    const std::string& command(
+    ) const
+    {
+        return cmd;
+    }
+
+    const std::vector<std::string>& files_out(
+    ) const
+    {
+        return out;
+    }
+};
+
+/**
+ *
+ */
+TEST(TestLoader, PushLinkedBatch)
+{
+    std::vector<linked> steps(3);
+
+    steps[0].cmd = "gen";
+    steps[0].out.push_back("a");
+    steps[1].cmd = "gen again";
+    steps[1].out.push_back("a");
+    steps[2].cmd = "use";
+    steps[2].in.push_back("a");
+    steps[2].src.push_back(0);
+    steps[2].out.push_back("b");
+
+    h1st::hist_graph graph;
+    ASSERT_EQ(3u, graph.push_linked_batch(steps.begin(), steps.end()));
+
+    ASSERT_EQ("gen again", node_of(graph, "a")->command().str());
+    ASSERT_EQ("gen", node_of(graph, "b")->nodes_in()[0].node()->command()
+        .str());
+
+    const std::string before = print(graph);
+
+    steps[2].src[0] = 2;
+    ASSERT_THROW(graph.push_linked_batch(steps.begin(), steps.end()),
+        h1st::input_not_found_exception);
+
+    steps[2].src[0] = 0;
+    steps[2].in[0] = "b";
+    ASSERT_THROW(graph.push_linked_batch(steps.begin(), steps.end()),
+        h1st::input_not_found_exception);
+
+    steps[2].src.clear();
+    ASSERT_THROW(graph.push_linked_batch(steps.begin(), steps.end()),
+        h1st::invalid_format_exception);
+
+    ASSERT_EQ(before, print(graph));
+}
+
+/**
+ *
+ */
+TEST(TestLoader, RejectedLinkedBatchThenBatch)
+{
+    std::vector<linked> steps(2);
+
+    steps[0].cmd = "gen";
+
+    for (int i = 0; i < 200; i++)
+    {
+        std::stringstream file;
+        file << "z" << i;
+        steps[0].out.push_back(file.str());
+    }
+
+    steps[1].cmd = "use";
+    steps[1].in.push_back("z0");
+    steps[1].src.push_back(1);
+    steps[1].out.push_back("y");
+
+    h1st::hist_graph graph;
+    ASSERT_THROW(graph.push_linked_batch(steps.begin(), steps.end()),
+        h1st::input_not_found_exception);
+
+    const std::vector<std::string> files_in(1, "z150");
+    const std::vector<std::string> files_out(1, "y");
+    const h1st::hist_step step(files_in.begin(), files_in.end(), "use",
+        files_out.begin(), files_out.end());
+
+    ASSERT_THROW(graph.push_batch(&step, &step + 1),
+        h1st::input_not_found_exception);
+    ASSERT_EQ(0u, graph.num_nodes());
+
+    steps[1].src[0] = 0;
+    ASSERT_EQ(2u, graph.push_linked_batch(steps.begin(), steps.end()));
+    ASSERT_EQ(1u, graph.push_batch(&step, &step + 1));
+}
+
+/**
+ *
+ */
+TEST(TestLoader, PrintedRoundTrip)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    const std::string text = print(graph);
+
+    h1st::hist_graph loaded;
+    ASSERT_EQ(5u, h1st::load_printed_graph(loaded, text.data(),
+        text.size()));
+
+    ASSERT_EQ(text, print(loaded));
+    ASSERT_EQ(node_of(graph, "a")->uuid(),
+        node_of(loaded, "a")->uuid());
+    ASSERT_EQ(node_of(graph, "b")->nodes_in()[0].node()->uuid(),
+        node_of(loaded, "b")->nodes_in()[0].node()->uuid());
+}
+
+/**
+ *
+ */
+TEST(TestLoader, JsonLinesRoundTrip)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    const std::string jsonl = export_jsonl(graph);
+
+    h1st::hist_graph loaded;
+    ASSERT_EQ(5u, h1st::load_jsonl_graph(loaded, jsonl.data(),
+        jsonl.size()));
+
+    ASSERT_EQ(print(graph), print(loaded));
+    ASSERT_EQ(jsonl, export_jsonl(loaded));
+}
+
+/**
+ *
+ */
+TEST(TestLoader, Renumbered)
+{
+    // Released nodes are not printed, the loaded graph renumbers the
+    // remaining ones and must print the same text after another trip
+
+    h1st::hist_graph graph;
+
+    for (int i = 0; i < 20; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+        push(graph, i % 4 == 0 ? "" : "a", command.str(), "a");
+        push(graph, "a", "copy", i % 2 == 0 ? "b" : "c");
+    }
+
+    const std::string text = print(graph);
+
+    h1st::hist_graph first;
+    h1st::load_printed_graph(first, text.data(), text.size());
+
+    const std::string first_text = print(first);
+
+    h1st::hist_graph second;
+    h1st::load_printed_graph(second, first_text.data(), first_text.size());
+
+    ASSERT_EQ(first_text, print(second));
+    ASSERT_EQ(graph.bytes_used() != 0, first.bytes_used() != 0);
+
+    std::vector<std::string> files;
+    files.push_back("b");
+    files.push_back("c");
+
+    std::vector<const h1st::hist_node*> expected;
+    std::vector<const h1st::hist_node*> actual;
+    graph.track(files.begin(), files.end(), std::back_inserter(expected),
+        false);
+    first.track(files.begin(), files.end(), std::back_inserter(actual),
+        false);
+
+    ASSERT_EQ(expected.size(), actual.size());
+
+    for (size_t i = 0; i < expected.size(); i++)
+        ASSERT_EQ(expected[i]->command(), actual[i]->command());
+}
+
+/**
+ *
+ */
+TEST(TestLoader, Unescape)
+{
+    const std::string jsonl =
+        "{\"uuid\":7,\"command\":\"a\\u00e9\\ud83d\\ude00\\/\\n\","
+            "\"inputs\":[],\"outputs\":[\"x y\"]}\n"
+        "\n"
+        " { \"outputs\" : [ \"z\" ] , \"inputs\" : [ { \"uuid\" : 7 , "
+            "\"file\" : \"x y\" } ] , \"command\" : \"\" , \"uuid\" : 9 }\n";
+
+    h1st::hist_graph loaded;
+    ASSERT_EQ(2u, h1st::load_jsonl_graph(loaded, jsonl.data(),
+        jsonl.size()));
+
+    ASSERT_EQ("a\xc3\xa9\xf0\x9f\x98\x80/\n",
+        node_of(loaded, "x y")->command().str());
+    ASSERT_EQ("", node_of(loaded, "z")->command().str());
+    ASSERT_EQ(node_of(loaded, "x y"),
+        node_of(loaded, "z")->nodes_in()[0].node());
+}
+
+/**
+ *
+ */
+TEST(TestLoader, File)
+{
+    const std::string file = "test19_graph.txt";
+
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    {
+        std::ofstream stream(file.c_str());
+        stream << print(graph);
+    }
+
+    h1st::hist_graph loaded;
+    ASSERT_EQ(5u, h1st::load_printed_graph(loaded, file));
+    ASSERT_EQ(print(graph), print(loaded));
+
+    {
+        std::ofstream stream(file.c_str());
+        stream << export_jsonl(graph);
+    }
+
+    h1st::hist_graph loaded_jsonl;
+    ASSERT_EQ(5u, h1st::load_jsonl_graph(loaded_jsonl, file));
+    ASSERT_EQ(print(graph), print(loaded_jsonl));
+
+    std::remove(file.c_str());
+
+    ASSERT_THROW(h1st::load_printed_graph(loaded, file),
+        h1st::io_exception);
+}
+
+/**
+ *
+ */
+TEST(TestLoader, InvalidInput)
+{
+    const std::string unknown = "a(0) cmd b(1) \nc(5) cmd d(2) \n";
+    const std::string no_output = "a(0) cmd b(1) \njust a command\n";
+    const std::string duplicate = "a(0) \nb(0) \n";
+    const std::string bad_json = "{\"uuid\":0,\"command\":\"x\","
+        "\"inputs\":[],\"outputs\":[\"a\"]}\n{\"uuid\":1,\"command\":\"x\","
+        "\"inputs\":[{\"file\":\"b\",\"uuid\":0}],\"outputs\":[\"c\"]}\n";
+    const std::string truncated = "{\"uuid\":0,\"command\":\"x\"";
+
+    h1st::hist_graph graph;
+
+    // A first token that names no loaded node is part of the command
+
+    ASSERT_EQ(2u, h1st::load_printed_graph(graph, unknown.data(),
+        unknown.size()));
+    ASSERT_EQ("c(5) cmd", node_of(graph, "d")->command().str());
+
+    const std::string before = print(graph);
+
+    try
+    {
+        h1st::load_printed_graph(graph, no_output.data(), no_output.size());
+        FAIL();
+    }
+    catch (h1st::invalid_format_exception& ex)
+    {
+        const size_t* line = boost::get_error_info<h1st::line_number>(ex);
+        ASSERT_TRUE(line != 0);
+        ASSERT_EQ(2u, *line);
+    }
+
+    ASSERT_THROW(h1st::load_printed_graph(graph, duplicate.data(),
+        duplicate.size()), h1st::invalid_format_exception);
+    ASSERT_THROW(h1st::load_jsonl_graph(graph, bad_json.data(),
+        bad_json.size()), h1st::invalid_format_exception);
+    ASSERT_THROW(h1st::load_jsonl_graph(graph, truncated.data(),
+        truncated.size()), h1st::invalid_format_exception);
+
+    ASSERT_EQ(before, print(graph));
+}
+
+}
@@ -191,12 +191,12 @@ TEST_F(TestSingleInOut, TrackAllInputs)
         std::back_inserter(nodes), false));
 
     ASSERT_EQ(6, nodes.size());
-    ASSERT_STREQ("command 4" , nodes[0]->command().c_str());
-    ASSERT_STREQ("command 5" , nodes[1]->command().c_str());
-    ASSERT_STREQ("command 6" , nodes[2]->command().c_str());
-    ASSERT_STREQ("command 7" , nodes[3]->command().c_str());
-    ASSERT_STREQ("command 9" , nodes[4]->command().c_str());
-    ASSERT_STREQ("command 10", nodes[5]->command().c_str());
+    ASSERT_STREQ("command 4" , nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 5" , nodes[1]->command().str().c_str());
+    ASSERT_STREQ("command 6" , nodes[2]->command().str().c_str());
+    ASSERT_STREQ("command 7" , nodes[3]->command().str().c_str());
+    ASSERT_STREQ("command 9" , nodes[4]->command().str().c_str());
+    ASSERT_STREQ("command 10", nodes[5]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
@@ -220,9 +220,9 @@ TEST_F(TestSingleInOut, TrackInputB)
         std::back_inserter(nodes), false));
 
     ASSERT_EQ(3, nodes.size());
-    ASSERT_STREQ("command 4" , nodes[0]->command().c_str());
-    ASSERT_STREQ("command 9" , nodes[1]->command().c_str());
-    ASSERT_STREQ("command 10", nodes[2]->command().c_str());
+    ASSERT_STREQ("command 4" , nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 9" , nodes[1]->command().str().c_str());
+    ASSERT_STREQ("command 10", nodes[2]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
@@ -283,8 +283,8 @@ TEST_F(TestSingleInOut, TrackAnyInputA)
         std::back_inserter(nodes), true));
 
     ASSERT_EQ(2, nodes.size());
-    ASSERT_STREQ("command 4" , nodes[0]->command().c_str());
-    ASSERT_STREQ("command 9" , nodes[1]->command().c_str());
+    ASSERT_STREQ("command 4" , nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 9" , nodes[1]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
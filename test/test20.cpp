@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+#include <h1st/graph_stats.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::counting_stats> counted_graph;
+
+/**
+ *
+ */
+void push(
+    counted_graph& graph,
+    const std::string& file_in,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), "command",
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+struct latency_log
+{
+    std::vector<h1st::graph_operation> operations;
+
+    static void hook(
+        void* context,
+        h1st::graph_operation operation,
+        boost::uint64_t
+    )
+    {
+        static_cast<latency_log*>(context)->operations.push_back(operation);
+    }
+};
+
+/**
+ *
+ */
+struct ignore_nodes
+{
+    void operator ()(
+        const h1st::hist_node*
+    )
+    {
+    }
+};
+
+/**
+ *
+ */
+TEST(TestGraphStats, Counters)
+{
+    counted_graph graph;
+
+    push(graph, "", "a");
+    push(graph, "a", "b");
+    push(graph, "b", "c");
+
+    const h1st::counting_stats& stats = graph.stats();
+
+    ASSERT_EQ(3u, stats.nodes_pushed());
+    ASSERT_EQ(0u, stats.nodes_released());
+    ASSERT_EQ(2u, stats.lookups());
+    ASSERT_EQ(3u, stats.peak_nodes());
+    ASSERT_EQ(graph.bytes_used(), stats.peak_bytes());
+    ASSERT_EQ(3u, stats.operation(h1st::op_push).count);
+    ASSERT_EQ(3u, stats.operation(h1st::op_prune).count);
+    ASSERT_TRUE(stats.operation(h1st::op_push).total_ns >=
+        stats.operation(h1st::op_push).max_ns);
+
+    // Rewriting a releases the whole chain once b and c are rebound
+
+    push(graph, "", "a");
+    push(graph, "a", "b");
+    push(graph, "b", "c");
+
+    ASSERT_EQ(6u, stats.nodes_pushed());
+    ASSERT_EQ(3u, stats.nodes_released());
+    ASSERT_EQ(3u, graph.num_nodes());
+    ASSERT_EQ(5u, stats.peak_nodes());
+
+    const std::string file = "c";
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    ASSERT_EQ(3u, nodes.size());
+    ASSERT_EQ(2u, stats.edges_traversed());
+    ASSERT_EQ(1u, stats.operation(h1st::op_track).count);
+
+    const std::string source = "a";
+    nodes.clear();
+    graph.dependents(&source, &source + 1, std::back_inserter(nodes), false);
+
+    ASSERT_EQ(2u, nodes.size());
+    ASSERT_EQ(4u, stats.edges_traversed());
+    ASSERT_EQ(1u, stats.operation(h1st::op_dependents).count);
+
+    graph.stats().reset();
+
+    ASSERT_EQ(0u, stats.nodes_pushed());
+    ASSERT_EQ(0u, stats.operation(h1st::op_track).count);
+}
+
+/**
+ *
+ */
+TEST(TestGraphStats, Batch)
+{
+    counted_graph graph;
+
+    std::vector<h1st::hist_step> steps;
+    std::vector<std::string> files_in(1, "a");
+    std::vector<std::string> files_out(1, "a");
+
+    steps.push_back(h1st::hist_step("gen", files_out.begin(),
+        files_out.end()));
+
+    for (int i = 0; i < 9; i++)
+        steps.push_back(h1st::hist_step(files_in.begin(), files_in.end(),
+            "touch", files_out.begin(), files_out.end()));
+
+    ASSERT_EQ(10u, graph.push_batch(steps.begin(), steps.end()));
+
+    ASSERT_EQ(10u, graph.stats().nodes_pushed());
+    ASSERT_EQ(9u, graph.stats().lookups());
+    ASSERT_EQ(1u, graph.stats().operation(h1st::op_push_batch).count);
+    ASSERT_EQ(1u, graph.stats().operation(h1st::op_prune).count);
+    ASSERT_EQ(0u, graph.stats().operation(h1st::op_push).count);
+}
+
+/**
+ *
+ */
+TEST(TestGraphStats, Hook)
+{
+    counted_graph graph;
+    latency_log log;
+
+    graph.stats().set_hook(&latency_log::hook, &log);
+
+    push(graph, "", "a");
+
+    ignore_nodes ignore;
+    graph.print(ignore);
+
+    ASSERT_EQ(3u, log.operations.size());
+    ASSERT_EQ(h1st::op_prune, log.operations[0]);
+    ASSERT_EQ(h1st::op_push, log.operations[1]);
+    ASSERT_EQ(h1st::op_print, log.operations[2]);
+
+    graph.stats().reset();
+    push(graph, "a", "b");
+
+    ASSERT_EQ(5u, log.operations.size());
+}
+
+/**
+ *
+ */
+TEST(TestGraphStats, NullStatsIsEmpty)
+{
+    ASSERT_EQ(1u, sizeof(h1st::null_stats));
+    ASSERT_EQ(1u, sizeof(h1st::null_stats::timer));
+}
+
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/exporters.hpp>
+#include <h1st/historian.hpp>
+#include <h1st/graph_policies.hpp>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::deferred_pruning> deferred_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::no_pruning> unpruned_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::eager_pruning, h1st::heap_node_allocator> heap_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::eager_pruning, h1st::node_arena, h1st::serialized> locked_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::no_pruning, h1st::node_arena, h1st::single_threaded,
+    h1st::no_retention, h1st::uuid64> wide_graph;
+
+/**
+ *
+ */
+template <typename Graph>
+void push(
+    Graph& graph,
+    const std::string& file_in,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+template <typename Graph>
+void churn(
+    Graph& graph,
+    int steps
+)
+{
+    for (int i = 0; i < steps; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+
+        std::stringstream file_in;
+        std::stringstream file_out;
+        file_in << "f" << (i + 1) % 5;
+        file_out << "f" << i % 5;
+
+        push(graph, i % 7 == 0 || !graph.has_input(file_in.str()) ? "" :
+            file_in.str(), command.str(), file_out.str());
+    }
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    h1st::hist_node_print_to_stream printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string track(
+    const Graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const typename Graph::node_type*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    std::stringstream ss;
+    for (size_t i = 0; i < nodes.size(); i++)
+        ss << nodes[i]->command() << ";";
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestGraphPolicies, DeferredPruning)
+{
+    h1st::hist_graph eager;
+    deferred_graph deferred(h1st::command_store::encoding_plain,
+        h1st::deferred_pruning(16));
+
+    for (int round = 0; round < 10; round++)
+    {
+        churn(eager, 13);
+        churn(deferred, 13);
+
+        ASSERT_EQ(eager.num_nodes(), deferred.num_nodes());
+        ASSERT_TRUE(deferred.num_garbage() < 16);
+        ASSERT_EQ(0u, eager.num_garbage());
+
+        for (int i = 0; i < 5; i++)
+        {
+            std::stringstream file;
+            file << "f" << i;
+            ASSERT_EQ(track(eager, file.str()), track(deferred, file.str()));
+        }
+    }
+
+    const size_t bytes = deferred.bytes_used();
+
+    eager.collect();
+    deferred.collect();
+
+    ASSERT_EQ(0u, deferred.num_garbage());
+    ASSERT_TRUE(deferred.bytes_used() <= bytes);
+    ASSERT_EQ(print(eager), print(deferred));
+}
+
+/**
+ *
+ */
+TEST(TestGraphPolicies, NoPruningKeepsUuids)
+{
+    unpruned_graph graph;
+
+    push(graph, "", "keep", "kept");
+    const h1st::hist_node* kept = graph.binding(graph.paths().find("kept"));
+
+    churn(graph, 200);
+
+    ASSERT_EQ(0, kept->uuid());
+    ASSERT_EQ(kept, graph.binding(graph.paths().find("kept")));
+    ASSERT_TRUE(graph.num_garbage() > 100);
+
+    const size_t num_nodes = graph.num_nodes();
+    const size_t bytes = graph.bytes_used();
+
+    graph.collect();
+
+    ASSERT_EQ(0u, graph.num_garbage());
+    ASSERT_EQ(num_nodes, graph.num_nodes());
+    ASSERT_TRUE(graph.bytes_used() < bytes);
+    ASSERT_EQ(0, kept->uuid());
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string export_jsonl(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+
+    {
+        h1st::output_buffer buffer(&ss);
+        h1st::hist_node_export_jsonl exporter(&buffer);
+        graph.print(exporter);
+    }
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestGraphPolicies, WideUuids)
+{
+    h1st::hist_graph narrow;
+    wide_graph wide;
+
+    churn(narrow, 100);
+    churn(wide, 100);
+
+    const h1st::path_id id = wide.paths().find("f0");
+
+    ASSERT_EQ(sizeof(boost::int64_t), sizeof(wide.binding(id)->uuid()));
+    ASSERT_EQ(sizeof(int), sizeof(narrow.binding(id)->uuid()));
+
+    narrow.collect();
+    wide.collect();
+
+    ASSERT_EQ(print(narrow), print(wide));
+    ASSERT_EQ(export_jsonl(narrow), export_jsonl(wide));
+
+    for (int i = 0; i < 5; i++)
+    {
+        std::stringstream file;
+        file << "f" << i;
+        ASSERT_EQ(track(narrow, file.str()), track(wide, file.str()));
+    }
+
+    // Branches of either graph number their own nodes past the base
+
+    h1st::hist_branch branch = wide.fork();
+    std::vector<std::string> files(1, "g");
+    branch.push_node("make_g", files.begin(), files.end());
+
+    std::vector<h1st::hist_branch_node> nodes;
+    branch.track(files.begin(), files.end(), std::back_inserter(nodes),
+        false);
+
+    ASSERT_EQ(1u, nodes.size());
+    ASSERT_EQ(static_cast<h1st::uuid64::type>(wide.num_nodes()),
+        nodes[0].uuid());
+}
+
+/**
+ *
+ */
+TEST(TestGraphPolicies, HeapAllocator)
+{
+    h1st::hist_graph arena;
+    heap_graph heap;
+
+    churn(arena, 100);
+    churn(heap, 100);
+
+    ASSERT_EQ(print(arena), print(heap));
+    ASSERT_TRUE(heap.bytes_used() > 0);
+    ASSERT_TRUE(heap.bytes_used() <= arena.bytes_used());
+}
+
+/**
+ *
+ */
+struct locked_context
+{
+    locked_graph* graph;
+    int thread;
+};
+
+/**
+ *
+ */
+void* push_locked(
+    void* arg
+)
+{
+    locked_context* context = static_cast<locked_context*>(arg);
+
+    for (int i = 0; i < 500; i++)
+    {
+        std::stringstream file;
+        file << "t" << context->thread << "." << i % 10;
+
+        push(*context->graph, "", "command", file.str());
+        context->graph->has_input(file.str());
+    }
+
+    return 0;
+}
+
+/**
+ *
+ */
+TEST(TestGraphPolicies, Serialized)
+{
+    locked_graph graph;
+
+    const int num_threads = 4;
+    pthread_t threads[num_threads];
+    locked_context contexts[num_threads];
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        contexts[i].graph = &graph;
+        contexts[i].thread = i;
+        ASSERT_EQ(0, pthread_create(&threads[i], 0, push_locked,
+            &contexts[i]));
+    }
+
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], 0);
+
+    ASSERT_EQ(40u, graph.num_nodes());
+}
+
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+#include <h1st/graph_policies.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::null_stats, h1st::eager_pruning,
+    h1st::node_arena, h1st::single_threaded,
+    h1st::version_retention> versioned_graph;
+
+/**
+ *
+ */
+void push(
+    versioned_graph& graph,
+    const std::string& file_in,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+std::string track(
+    const versioned_graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    std::stringstream ss;
+    for (size_t i = 0; i < nodes.size(); i++)
+        ss << nodes[i]->command() << ";";
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestVersions, TrackOldVersions)
+{
+    versioned_graph graph;
+
+    for (int i = 1; i <= 5; i++)
+    {
+        std::stringstream command;
+        command << "gen " << i;
+        push(graph, "", command.str(), "src");
+        push(graph, "src", "cc", "out.txt");
+    }
+
+    ASSERT_EQ(5u, graph.generation("out.txt"));
+    ASSERT_EQ(0u, graph.generation("missing"));
+
+    ASSERT_EQ("gen 5;cc;", track(graph, "out.txt"));
+    ASSERT_EQ("gen 5;cc;", track(graph, "out.txt@v5"));
+    ASSERT_EQ("gen 3;cc;", track(graph, "out.txt@v3"));
+    ASSERT_EQ("gen 1;cc;", track(graph, "out.txt@v1"));
+    ASSERT_EQ("gen 2;", track(graph, "src@v2"));
+
+    ASSERT_TRUE(graph.has_input("out.txt@v4"));
+    ASSERT_FALSE(graph.has_input("out.txt@v6"));
+    ASSERT_FALSE(graph.has_input("out.txt@v0"));
+    ASSERT_FALSE(graph.has_input("out.txt@vx"));
+    ASSERT_FALSE(graph.has_input("missing@v1"));
+
+    std::vector<std::string> files;
+    files.push_back("src@v2");
+    std::vector<const h1st::hist_node*> nodes;
+    graph.dependents(files.begin(), files.end(), std::back_inserter(nodes),
+        false);
+
+    ASSERT_EQ(1u, nodes.size());
+    ASSERT_EQ("cc", nodes[0]->command().str());
+    ASSERT_EQ(graph.binding(graph.paths().find("src")),
+        graph.binding(graph.paths().find("out.txt"))->nodes_in()[0].node());
+}
+
+/**
+ *
+ */
+TEST(TestVersions, PerPathLimit)
+{
+    versioned_graph graph(h1st::command_store::encoding_plain,
+        h1st::eager_pruning(), h1st::version_retention(2));
+
+    for (int i = 1; i <= 10; i++)
+    {
+        std::stringstream command;
+        command << "gen " << i;
+        push(graph, "", command.str(), "out");
+    }
+
+    ASSERT_EQ(10u, graph.generation("out"));
+    ASSERT_EQ(2u, graph.num_retained_versions());
+    ASSERT_EQ(3u, graph.num_nodes());
+
+    ASSERT_EQ("gen 9;", track(graph, "out@v9"));
+    ASSERT_EQ("gen 8;", track(graph, "out@v8"));
+    ASSERT_FALSE(graph.has_input("out@v7"));
+    ASSERT_FALSE(graph.has_input("out@v1"));
+}
+
+/**
+ *
+ */
+TEST(TestVersions, TotalLimit)
+{
+    versioned_graph graph(h1st::command_store::encoding_plain,
+        h1st::eager_pruning(), h1st::version_retention(100, 3));
+
+    for (int i = 1; i <= 4; i++)
+    {
+        push(graph, "", "a", "a");
+        push(graph, "", "b", "b");
+    }
+
+    // Six overwritten versions, only the three most recent are kept
+
+    ASSERT_EQ(3u, graph.num_retained_versions());
+    ASSERT_TRUE(graph.has_input("b@v3"));
+    ASSERT_TRUE(graph.has_input("a@v3"));
+    ASSERT_TRUE(graph.has_input("b@v2"));
+    ASSERT_FALSE(graph.has_input("a@v2"));
+    ASSERT_EQ(5u, graph.num_nodes());
+
+    // Memory stays bounded under heavy churn
+
+    for (int i = 0; i < 1000; i++)
+        push(graph, i % 2 == 0 ? "" : "a", "a", "a");
+
+    ASSERT_EQ(3u, graph.num_retained_versions());
+    ASSERT_TRUE(graph.num_nodes() < 10);
+}
+
+/**
+ *
+ */
+TEST(TestVersions, DisabledByDefault)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_out(1, "out");
+    graph.push_node("a", files_out.begin(), files_out.end());
+    graph.push_node("b", files_out.begin(), files_out.end());
+
+    ASSERT_EQ(0u, graph.generation("out"));
+    ASSERT_EQ(1u, graph.num_nodes());
+    ASSERT_FALSE(graph.has_input("out@v1"));
+}
+
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/branch.hpp>
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+template <typename Graph>
+void push(
+    Graph& graph,
+    const std::string& file_in,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string track(
+    const Graph& graph,
+    const std::string& file
+)
+{
+    std::vector<h1st::hist_branch_node> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    std::stringstream ss;
+    for (size_t i = 0; i < nodes.size(); i++)
+        ss << nodes[i]->command() << ";";
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    h1st::hist_node_print_to_stream printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+class command_printer
+{
+private:
+
+    std::stringstream* _p_stream;
+
+public:
+
+    command_printer(
+        std::stringstream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+    }
+
+    template <typename Node>
+    void operator ()(
+        const Node& node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+            (*_p_stream) << node->nodes_in()[i].file() << " ";
+
+        (*_p_stream) << node->command();
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            (*_p_stream) << " " << node->files_out()[i];
+
+        (*_p_stream) << ";";
+    }
+};
+
+/**
+ * The graph renumbers its nodes when it prunes, so only the commands
+ * and the files are compared
+ */
+template <typename Graph>
+std::string print_commands(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    command_printer printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+void make_graph(
+    h1st::hist_graph& graph
+)
+{
+    push(graph, "", "gen", "a");
+    push(graph, "a", "cc a", "b");
+    push(graph, "b", "ld b", "c");
+    push(graph, "", "gen 2", "d");
+}
+
+/**
+ *
+ */
+TEST(TestBranch, ForkSharesGraph)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    h1st::hist_branch branch = graph.fork();
+    h1st::hist_branch other = graph.fork();
+
+    ASSERT_EQ(&branch.base(), &other.base());
+    ASSERT_EQ(&branch.base(), &graph.snapshot());
+    ASSERT_EQ(4u, branch.num_nodes());
+    ASSERT_EQ(print(graph), print(branch));
+    ASSERT_EQ("gen;cc a;ld b;", track(branch, "c"));
+
+    push(branch, "a", "cc -O2 a", "b");
+    push(branch, "b", "ld b", "c");
+
+    ASSERT_EQ("gen;cc -O2 a;ld b;", track(branch, "c"));
+    ASSERT_EQ("gen;cc a;ld b;", track(other, "c"));
+    ASSERT_EQ(4u, graph.num_nodes());
+
+    // A modified graph builds a new snapshot and leaves the branches
+    // on the old one
+
+    push(graph, "", "gen 3", "d");
+
+    ASSERT_NE(&branch.base(), &graph.snapshot());
+    ASSERT_EQ("gen;cc a;ld b;", track(other, "c"));
+    ASSERT_EQ("gen 3;", track(graph.fork(), "d"));
+    ASSERT_EQ("gen 2;", track(other, "d"));
+}
+
+/**
+ *
+ */
+TEST(TestBranch, ForksAreIndependent)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    h1st::hist_branch first = graph.fork();
+    push(first, "c", "strip c", "e");
+
+    h1st::hist_branch second = first.fork();
+    push(second, "c", "upx c", "e");
+    push(second, "e", "tar e", "f");
+
+    push(first, "e", "zip e", "g");
+
+    ASSERT_EQ("gen;cc a;ld b;strip c;", track(first, "e"));
+    ASSERT_EQ("gen;cc a;ld b;upx c;", track(second, "e"));
+    ASSERT_EQ("gen;cc a;ld b;upx c;tar e;", track(second, "f"));
+    ASSERT_EQ("gen;cc a;ld b;strip c;zip e;", track(first, "g"));
+
+    ASSERT_FALSE(first.has_input("f"));
+    ASSERT_FALSE(second.has_input("g"));
+    ASSERT_FALSE(graph.has_input("e"));
+
+    // Both branches gave their new nodes the same indices and uuids
+
+    ASSERT_EQ(6u, first.num_nodes());
+    ASSERT_EQ(7u, second.num_nodes());
+    ASSERT_EQ(first.node(5).uuid(), second.node(5).uuid());
+    ASSERT_EQ("zip e", first.node(5).command().str());
+    ASSERT_EQ("tar e", second.node(6).command().str());
+}
+
+/**
+ *
+ */
+TEST(TestBranch, PrintSameAsGraph)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    h1st::hist_branch branch = graph.fork();
+
+    for (int i = 0; i < 50; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+
+        const std::string file_in = i % 3 == 0 ? "a" : "c";
+        const std::string file_out = i % 2 == 0 ? "c" : "e";
+
+        push(graph, file_in, command.str(), file_out);
+        push(branch, file_in, command.str(), file_out);
+
+        // Forks merge their layers from time to time
+
+        if (i % 2 == 0)
+            branch = branch.fork();
+
+        ASSERT_EQ(print_commands(graph), print_commands(branch));
+    }
+
+    ASSERT_EQ(track(graph.fork(), "c"), track(branch, "c"));
+    ASSERT_EQ(track(graph.fork(), "e"), track(branch, "e"));
+}
+
+/**
+ *
+ */
+TEST(TestBranch, NestedForks)
+{
+    h1st::hist_graph graph;
+    push(graph, "", "start", "c");
+
+    h1st::hist_branch branch = graph.fork();
+    std::vector<h1st::hist_branch> kept;
+
+    for (int i = 0; i < 2000; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+
+        push(branch, "c", command.str(), "c");
+        branch = branch.fork();
+
+        if (i % 100 == 0)
+            kept.push_back(branch);
+    }
+
+    for (size_t k = 0; k < kept.size(); k++)
+    {
+        const std::string file = "c";
+
+        std::vector<h1st::hist_branch_node> nodes;
+        kept[k].track(&file, &file + 1, std::back_inserter(nodes), false);
+
+        std::stringstream command;
+        command << "step " << k * 100;
+
+        ASSERT_EQ(k * 100 + 2, nodes.size());
+        ASSERT_EQ("start", nodes.front()->command().str());
+        ASSERT_EQ(command.str(), nodes.back()->command().str());
+    }
+
+    push(kept.front(), "c", "other", "d");
+
+    ASSERT_TRUE(kept.front().has_input("d"));
+    ASSERT_FALSE(branch.has_input("d"));
+    ASSERT_EQ(2001u, branch.num_nodes());
+}
+
+/**
+ *
+ */
+TEST(TestBranch, EmptyGraph)
+{
+    h1st::hist_graph graph;
+    h1st::hist_branch branch = graph.fork();
+
+    ASSERT_EQ(0u, branch.num_nodes());
+    ASSERT_EQ("", print(branch));
+
+    push(branch, "", "gen", "a");
+
+    ASSERT_EQ("gen;", track(branch, "a"));
+    ASSERT_EQ("a(0) ", print(branch).substr(4, 5));
+}
+
+/**
+ *
+ */
+TEST(TestBranch, Errors)
+{
+    h1st::hist_graph graph;
+    make_graph(graph);
+
+    h1st::hist_branch branch = graph.fork();
+
+    std::vector<std::string> none;
+    std::vector<std::string> files(1, "missing");
+
+    ASSERT_THROW(branch.push_node(files.begin(), files.end(), "x",
+        files.begin(), files.end()), h1st::input_not_found_exception);
+    ASSERT_THROW(branch.push_node("x", none.begin(), none.end()),
+        h1st::empty_output_exception);
+    ASSERT_THROW(track(branch, "missing"), h1st::input_not_found_exception);
+    ASSERT_THROW(h1st::hist_branch(
+        boost::shared_ptr<const h1st::hist_csr_view>()),
+        h1st::null_value_exception);
+
+    ASSERT_EQ(4u, branch.num_nodes());
+
+    std::vector<h1st::hist_branch_node> nodes;
+    files.push_back("c");
+    ASSERT_FALSE(branch.track(files.begin(), files.end(),
+        std::back_inserter(nodes), true));
+    ASSERT_EQ(3u, nodes.size());
+}
+
+}
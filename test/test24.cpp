@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::counting_stats> counted_graph;
+
+/**
+ *
+ */
+template <typename Graph>
+void push(
+    Graph& graph,
+    const std::string& file_in,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    if (!file_in.empty())
+        files_in.push_back(file_in);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string track(
+    const Graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    std::stringstream ss;
+    for (size_t i = 0; i < nodes.size(); i++)
+        ss << nodes[i]->command() << ";";
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+class command_printer
+{
+private:
+
+    std::stringstream* _p_stream;
+
+public:
+
+    command_printer(
+        std::stringstream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+    }
+
+    void operator ()(
+        const h1st::hist_node* node
+    )
+    {
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+            (*_p_stream) << node->nodes_in()[i].file() << " ";
+
+        (*_p_stream) << node->command();
+
+        for (size_t i = 0; i < node->files_out().size(); i++)
+            (*_p_stream) << " " << node->files_out()[i];
+
+        (*_p_stream) << ";";
+    }
+};
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print_commands(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    command_printer printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestMerge, Disjoint)
+{
+    h1st::hist_graph first;
+    push(first, "", "gen a", "a");
+    push(first, "a", "cc a", "b");
+
+    h1st::hist_graph second;
+    push(second, "", "gen x", "x");
+    push(second, "x", "cc x", "y");
+
+    std::vector<const h1st::hist_graph*> graphs;
+    graphs.push_back(&first);
+    graphs.push_back(&second);
+
+    h1st::hist_graph graph;
+
+    ASSERT_EQ(4u, graph.merge(graphs.begin(), graphs.end()));
+    ASSERT_EQ(4u, graph.num_nodes());
+    ASSERT_EQ("gen a;cc a;", track(graph, "b"));
+    ASSERT_EQ("gen x;cc x;", track(graph, "y"));
+    ASSERT_EQ(print_commands(first) + print_commands(second),
+        print_commands(graph));
+}
+
+/**
+ *
+ */
+TEST(TestMerge, DedupeSharedHistory)
+{
+    h1st::hist_graph first;
+    push(first, "", "gen", "a");
+    push(first, "a", "cc a", "b");
+
+    h1st::hist_graph second;
+    push(second, "", "gen", "a");
+    push(second, "a", "ld a", "c");
+
+    h1st::hist_graph graph;
+
+    ASSERT_EQ(2u, graph.merge(first));
+    ASSERT_EQ(1u, graph.merge(second));
+    ASSERT_EQ(3u, graph.num_nodes());
+
+    std::vector<std::string> files;
+    files.push_back("b");
+    files.push_back("c");
+
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(files.begin(), files.end(), std::back_inserter(nodes),
+        false);
+
+    ASSERT_EQ(3u, nodes.size());
+    ASSERT_EQ(graph.binding(graph.paths().find("a")),
+        graph.binding(graph.paths().find("c"))->nodes_in()[0].node());
+
+    // Merging the same graph again creates nothing
+
+    ASSERT_EQ(0u, graph.merge(second));
+    ASSERT_EQ(3u, graph.num_nodes());
+
+    // Same within a single merge
+
+    std::vector<const h1st::hist_graph*> graphs;
+    graphs.push_back(&first);
+    graphs.push_back(&second);
+
+    h1st::hist_graph single;
+
+    ASSERT_EQ(3u, single.merge(graphs.begin(), graphs.end()));
+    ASSERT_EQ(print_commands(graph), print_commands(single));
+
+    // Same command and inputs but other outputs is another node
+
+    h1st::hist_graph third;
+    push(third, "", "gen", "d");
+
+    ASSERT_EQ(1u, graph.merge(third));
+    ASSERT_EQ(4u, graph.num_nodes());
+}
+
+/**
+ *
+ */
+TEST(TestMerge, WriterPolicy)
+{
+    h1st::hist_graph first;
+    push(first, "", "gen 1", "out");
+    push(first, "", "tmp 1", "tmp");
+
+    h1st::hist_graph second;
+    push(second, "", "gen 2", "out");
+
+    std::vector<const h1st::hist_graph*> graphs;
+    graphs.push_back(&first);
+    graphs.push_back(&second);
+
+    h1st::hist_graph last;
+    push(last, "", "gen 0", "out");
+    last.merge(graphs.begin(), graphs.end(), h1st::merge_last_writer);
+
+    ASSERT_EQ("gen 2;", track(last, "out"));
+    ASSERT_EQ("tmp 1;", track(last, "tmp"));
+    ASSERT_EQ(2u, last.num_nodes());
+
+    h1st::hist_graph first_writer;
+    push(first_writer, "", "gen 0", "out");
+    first_writer.merge(graphs.begin(), graphs.end(),
+        h1st::merge_first_writer);
+
+    ASSERT_EQ("gen 0;", track(first_writer, "out"));
+    ASSERT_EQ("tmp 1;", track(first_writer, "tmp"));
+    ASSERT_EQ(2u, first_writer.num_nodes());
+
+    h1st::hist_graph empty;
+    empty.merge(graphs.begin(), graphs.end(), h1st::merge_first_writer);
+
+    ASSERT_EQ("gen 1;", track(empty, "out"));
+}
+
+/**
+ *
+ */
+TEST(TestMerge, SameAsPushing)
+{
+    // Files are rebound after they are read, so the merge has to keep
+    // shadowed producers that are still ancestors
+
+    h1st::hist_graph source;
+
+    for (int i = 0; i < 200; i++)
+    {
+        std::stringstream command;
+        command << "command " << i;
+
+        push(source, i == 0 ? "" : i % 3 == 0 ? "a" : "b", command.str(),
+            i % 2 == 0 ? "b" : "a");
+    }
+
+    counted_graph graph;
+
+    ASSERT_EQ(source.num_nodes(), graph.merge(source));
+    ASSERT_EQ(print_commands(source), print_commands(graph));
+    ASSERT_EQ(track(source, "a"), track(graph, "a"));
+    ASSERT_EQ(track(source, "b"), track(graph, "b"));
+
+    // One prune for the whole merge
+
+    ASSERT_EQ(1u, graph.stats().operation(h1st::op_prune).count);
+    ASSERT_EQ(1u, graph.stats().operation(h1st::op_push_batch).count);
+    ASSERT_EQ(source.num_nodes(), graph.stats().nodes_pushed());
+
+    // Merged back into a graph of another type
+
+    h1st::hist_graph copy;
+    copy.merge(graph);
+
+    ASSERT_EQ(print_commands(source), print_commands(copy));
+}
+
+}
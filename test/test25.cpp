@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+#include <h1st/graph_policies.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::incremental_pruning> incremental_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::generational_pruning> generational_graph;
+
+typedef h1st::basic_hist_graph<h1st::null_stats,
+    h1st::generational_pruning, h1st::heap_node_allocator> heap_graph;
+
+/**
+ *
+ */
+template <typename Graph>
+void churn(
+    Graph& graph,
+    int first,
+    int steps
+)
+{
+    // Most outputs are overwritten soon, a few live for long
+
+    for (int i = first; i < first + steps; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+
+        std::stringstream file_in;
+        std::stringstream file_out;
+        file_in << "f" << (i * 7 + 3) % 11;
+        file_out << "f" << (i % 13 == 0 ? i % 97 + 11 : i % 11);
+
+        std::vector<std::string> files_in;
+        std::vector<std::string> files_out(1, file_out.str());
+
+        if (i % 5 != 0 && graph.has_input(file_in.str()))
+            files_in.push_back(file_in.str());
+
+        graph.push_node(files_in.begin(), files_in.end(), command.str(),
+            files_out.begin(), files_out.end());
+    }
+}
+
+/**
+ *
+ */
+class command_printer
+{
+private:
+
+    std::stringstream* _p_stream;
+
+public:
+
+    command_printer(
+        std::stringstream* p_stream
+    ) :
+        _p_stream(p_stream)
+    {
+    }
+
+    void operator ()(
+        const h1st::hist_node* node
+    )
+    {
+        // The uuids depend on the pruning policy, but they must be the
+        // indices of the nodes in push order
+
+        for (size_t i = 0; i < node->nodes_in().size(); i++)
+        {
+            if (node->nodes_in()[i].node()->uuid() >= node->uuid())
+                (*_p_stream) << "!";
+
+            (*_p_stream) << node->nodes_in()[i].file() << " ";
+        }
+
+        (*_p_stream) << node->command() << ";";
+    }
+};
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print_commands(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    command_printer printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string print(
+    const Graph& graph
+)
+{
+    std::stringstream ss;
+    h1st::hist_node_print_to_stream printer(&ss);
+    graph.print(printer);
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+std::string track_all(
+    const Graph& graph
+)
+{
+    std::vector<std::string> files;
+
+    for (int i = 0; i < 108; i++)
+    {
+        std::stringstream file;
+        file << "f" << i;
+        files.push_back(file.str());
+    }
+
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(files.begin(), files.end(), std::back_inserter(nodes), true);
+
+    std::vector<const h1st::hist_node*> consumers;
+    graph.dependents(files.begin(), files.begin() + 11,
+        std::back_inserter(consumers), true);
+
+    std::stringstream ss;
+
+    for (size_t i = 0; i < nodes.size(); i++)
+        ss << nodes[i]->command() << ";";
+
+    ss << "|";
+
+    for (size_t i = 0; i < consumers.size(); i++)
+        ss << consumers[i]->command() << ";";
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+template <typename Graph>
+void check_same_as_eager(
+    Graph& graph
+)
+{
+    h1st::hist_graph eager;
+
+    for (int round = 0; round < 40; round++)
+    {
+        churn(eager, round * 50, 50);
+        churn(graph, round * 50, 50);
+
+        ASSERT_EQ(eager.num_nodes(), graph.num_nodes());
+        ASSERT_EQ(print_commands(eager), print_commands(graph));
+        ASSERT_EQ(track_all(eager), track_all(graph));
+    }
+
+    eager.collect();
+    graph.collect();
+
+    ASSERT_EQ(0u, graph.num_garbage());
+    ASSERT_EQ(print(eager), print(graph));
+}
+
+/**
+ *
+ */
+TEST(TestPruningModes, Incremental)
+{
+    incremental_graph graph(h1st::command_store::encoding_plain,
+        h1st::incremental_pruning(4));
+
+    check_same_as_eager(graph);
+}
+
+/**
+ *
+ */
+TEST(TestPruningModes, IncrementalKeepsUp)
+{
+    incremental_graph graph(h1st::command_store::encoding_plain,
+        h1st::incremental_pruning(4));
+
+    size_t max_garbage = 0;
+
+    for (int i = 0; i < 200; i++)
+    {
+        churn(graph, i * 100, 100);
+        max_garbage = std::max(max_garbage, graph.num_garbage());
+    }
+
+    ASSERT_TRUE(max_garbage < 100);
+
+    // Without a budget only collect() reclaims the nodes
+
+    graph.pruning().set_budget(0);
+    churn(graph, 20000, 1000);
+
+    ASSERT_TRUE(graph.num_garbage() > 500);
+
+    graph.pruning().set_budget(1000000);
+    churn(graph, 21000, 1);
+
+    ASSERT_EQ(0u, graph.num_garbage());
+}
+
+/**
+ *
+ */
+TEST(TestPruningModes, Generational)
+{
+    generational_graph graph(h1st::command_store::encoding_plain,
+        h1st::generational_pruning(32));
+
+    check_same_as_eager(graph);
+
+    generational_graph budgeted(h1st::command_store::encoding_plain,
+        h1st::generational_pruning(32, 8));
+
+    check_same_as_eager(budgeted);
+
+    heap_graph heap(h1st::command_store::encoding_plain,
+        h1st::generational_pruning(16, 2));
+
+    check_same_as_eager(heap);
+}
+
+/**
+ *
+ */
+template <typename Graph>
+int max_young_uuid(
+    Graph& graph
+)
+{
+    // The long lived nodes at the start of the graph are never released,
+    // so the whole graph is compacted only when the young holes
+    // outnumber them
+
+    std::vector<std::string> files_out(1);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        std::stringstream file;
+        file << "old" << i;
+        files_out[0] = file.str();
+        graph.push_node("old", files_out.begin(), files_out.end());
+    }
+
+    // Collecting promotes them out of the nursery
+
+    graph.collect();
+
+    files_out[0] = "young";
+
+    int max_uuid = 0;
+
+    for (int i = 0; i < 10000; i++)
+    {
+        graph.push_node("young", files_out.begin(), files_out.end());
+
+        max_uuid = std::max(max_uuid,
+            graph.binding(graph.paths().find("young"))->uuid());
+    }
+
+    return max_uuid;
+}
+
+/**
+ *
+ */
+TEST(TestPruningModes, NurseryKeepsYoungNodesDense)
+{
+    // Each nursery compaction promotes the young node that is still
+    // bound, which leaves one hole behind once it is shadowed
+
+    h1st::hist_graph eager;
+    generational_graph graph(h1st::command_store::encoding_plain,
+        h1st::generational_pruning(64));
+
+    ASSERT_TRUE(max_young_uuid(eager) > 1900);
+    ASSERT_TRUE(max_young_uuid(graph) < 1000 + 64 + 10000 / 60);
+    ASSERT_EQ(1001u, graph.num_nodes());
+}
+
+}
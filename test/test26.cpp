@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/exporters.hpp>
+#include <h1st/historian.hpp>
+#include <h1st/output_buffer.hpp>
+#include <h1st/provenance.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::condensed_provenance<const h1st::hist_node*> condensed;
+
+/**
+ *
+ */
+void push(
+    h1st::hist_graph& graph,
+    const std::string& files,
+    const std::string& command,
+    const std::string& file_out
+)
+{
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, file_out);
+
+    std::stringstream ss(files);
+    std::string file;
+
+    while (ss >> file)
+        files_in.push_back(file);
+
+    graph.push_node(files_in.begin(), files_in.end(), command,
+        files_out.begin(), files_out.end());
+}
+
+/**
+ *
+ */
+std::vector<const h1st::hist_node*> track(
+    const h1st::hist_graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+    return nodes;
+}
+
+/**
+ *
+ */
+template <typename Node>
+std::string describe(
+    const h1st::condensed_provenance<Node>& provenance
+)
+{
+    std::stringstream ss;
+
+    for (size_t s = 0; s < provenance.num_segments(); s++)
+    {
+        ss << s << ":" << provenance.head(s)->command();
+
+        if (provenance.size(s) > 1)
+            ss << ".." << provenance.tail(s)->command();
+
+        for (size_t i = 0; i < provenance.num_inputs(s); i++)
+            ss << (i == 0 ? "<" : ",") << provenance.input(s, i).source;
+
+        ss << ";";
+    }
+
+    return ss.str();
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, LongChain)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "step 0", "f");
+
+    for (int i = 1; i < 1000; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+        push(graph, "f", command.str(), "f");
+    }
+
+    const std::vector<const h1st::hist_node*> nodes = track(graph, "f");
+    const condensed provenance(nodes.begin(), nodes.end());
+
+    ASSERT_EQ(1000u, provenance.num_nodes());
+    ASSERT_EQ(1u, provenance.num_segments());
+    ASSERT_EQ(0u, provenance.num_edges());
+    ASSERT_EQ(1000u, provenance.size(0));
+    ASSERT_EQ("0:step 0..step 999;", describe(provenance));
+
+    for (size_t i = 0; i < provenance.size(0); i++)
+    {
+        ASSERT_EQ(nodes[i], provenance.node(0, i));
+        ASSERT_EQ(0u, provenance.segment_of(i));
+    }
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, FanOutAndFanIn)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "a", "a");
+    push(graph, "a", "b1", "b");
+    push(graph, "b", "b2", "b");
+    push(graph, "a", "c", "c");
+    push(graph, "b c", "d1", "d");
+    push(graph, "d", "d2", "d");
+    push(graph, "d d", "d3", "d");
+
+    const std::vector<const h1st::hist_node*> nodes = track(graph, "d");
+    const condensed provenance(nodes.begin(), nodes.end());
+
+    ASSERT_EQ(7u, provenance.num_nodes());
+    ASSERT_EQ(4u, provenance.num_edges());
+    ASSERT_EQ("0:a;1:b1..b2<0;2:c<0;3:d1..d3<1,2;", describe(provenance));
+    ASSERT_EQ(1u, provenance.input(3, 1).input);
+    ASSERT_EQ("c", provenance.head(3)->nodes_in()[
+        provenance.input(3, 1).input].file());
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, TransitiveReduction)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "a", "a");
+    push(graph, "a", "b", "b");
+    push(graph, "a b", "c", "c");
+    push(graph, "", "x", "x");
+    push(graph, "a b c x", "d", "d");
+    push(graph, "b", "e", "e");
+    push(graph, "d e", "f", "f");
+
+    const std::vector<const h1st::hist_node*> nodes = track(graph, "f");
+    condensed provenance(nodes.begin(), nodes.end());
+
+    ASSERT_EQ("0:a;1:b<0;2:c<0,1;3:x;4:d<0,1,2,3;5:e<1;6:f<4,5;",
+        describe(provenance));
+    ASSERT_EQ(10u, provenance.num_edges());
+
+    provenance.reduce();
+
+    ASSERT_EQ("0:a;1:b<0;2:c<1;3:x;4:d<2,3;5:e<1;6:f<4,5;",
+        describe(provenance));
+    ASSERT_EQ(7u, provenance.num_edges());
+    ASSERT_EQ(7u, provenance.num_nodes());
+
+    provenance.reduce();
+
+    ASSERT_EQ(7u, provenance.num_edges());
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, PartialNodes)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "a", "a");
+    push(graph, "a", "b", "b");
+    push(graph, "b", "c", "c");
+
+    const std::vector<const h1st::hist_node*> nodes = track(graph, "c");
+    const condensed provenance(nodes.begin() + 1, nodes.end());
+
+    ASSERT_EQ("0:b..c;", describe(provenance));
+
+    const condensed empty(nodes.end(), nodes.end());
+
+    ASSERT_EQ(0u, empty.num_segments());
+    ASSERT_EQ(0u, empty.num_edges());
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, Snapshot)
+{
+    h1st::hist_graph graph;
+
+    for (int i = 0; i < 100; i++)
+    {
+        std::stringstream command;
+        command << "step " << i;
+        push(graph, i % 10 == 0 ? "" : i % 10 == 5 ? "f g" : "f",
+            command.str(), i % 30 == 2 ? "g" : "f");
+    }
+
+    const std::string file = "f";
+    const std::vector<const h1st::hist_node*> nodes = track(graph, file);
+
+    std::vector<h1st::hist_csr_node> csr_nodes;
+    graph.snapshot().track(&file, &file + 1,
+        std::back_inserter(csr_nodes), false);
+
+    condensed provenance(nodes.begin(), nodes.end());
+    h1st::condensed_provenance<h1st::hist_csr_node> csr_provenance(
+        csr_nodes.begin(), csr_nodes.end());
+
+    ASSERT_TRUE(provenance.num_segments() < provenance.num_nodes());
+    ASSERT_EQ(describe(provenance), describe(csr_provenance));
+
+    provenance.reduce();
+    csr_provenance.reduce();
+
+    ASSERT_EQ(describe(provenance), describe(csr_provenance));
+}
+
+/**
+ *
+ */
+TEST(TestCondensedProvenance, ExportDot)
+{
+    h1st::hist_graph graph;
+
+    push(graph, "", "a", "a");
+    push(graph, "a", "b", "b");
+    push(graph, "b", "c", "c");
+    push(graph, "c", "d", "d");
+    push(graph, "a d", "e \"1\"", "e");
+
+    const std::vector<const h1st::hist_node*> nodes = track(graph, "e");
+    condensed provenance(nodes.begin(), nodes.end());
+    provenance.reduce();
+
+    std::stringstream ss;
+    h1st::output_buffer buffer(&ss);
+    h1st::export_condensed_dot(&buffer, provenance);
+
+    ASSERT_EQ(
+        "digraph h1st {\n"
+        "  s0 [label=\"a\\na\"];\n"
+        "  s1 [label=\"b\\n... 1 more ...\\nd\\nd\"];\n"
+        "  s0 -> s1 [label=\"a\"];\n"
+        "  s2 [label=\"e \\\"1\\\"\\ne\"];\n"
+        "  s1 -> s2 [label=\"d\"];\n"
+        "}\n", ss.str());
+
+    ASSERT_THROW(h1st::export_condensed_dot(0, provenance),
+        h1st::null_value_exception);
+}
+
+}
@@ -145,10 +145,10 @@ TEST_F(TestMultipleInOut, TrackAllInputs)
         std::back_inserter(nodes), false));
 
     ASSERT_EQ(4, nodes.size());
-    ASSERT_STREQ("command 2", nodes[0]->command().c_str());
-    ASSERT_STREQ("command 3", nodes[1]->command().c_str());
-    ASSERT_STREQ("command 4", nodes[2]->command().c_str());
-    ASSERT_STREQ("command 5", nodes[3]->command().c_str());
+    ASSERT_STREQ("command 2", nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 3", nodes[1]->command().str().c_str());
+    ASSERT_STREQ("command 4", nodes[2]->command().str().c_str());
+    ASSERT_STREQ("command 5", nodes[3]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
@@ -172,9 +172,9 @@ TEST_F(TestMultipleInOut, TrackInputD)
         std::back_inserter(nodes), false));
 
     ASSERT_EQ(3, nodes.size());
-    ASSERT_STREQ("command 2", nodes[0]->command().c_str());
-    ASSERT_STREQ("command 3", nodes[1]->command().c_str());
-    ASSERT_STREQ("command 5", nodes[2]->command().c_str());
+    ASSERT_STREQ("command 2", nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 3", nodes[1]->command().str().c_str());
+    ASSERT_STREQ("command 5", nodes[2]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
@@ -235,9 +235,9 @@ TEST_F(TestMultipleInOut, TrackAnyInputC)
         std::back_inserter(nodes), true));
 
     ASSERT_EQ(3, nodes.size());
-    ASSERT_STREQ("command 2" , nodes[0]->command().c_str());
-    ASSERT_STREQ("command 3" , nodes[1]->command().c_str());
-    ASSERT_STREQ("command 4" , nodes[2]->command().c_str());
+    ASSERT_STREQ("command 2" , nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 3" , nodes[1]->command().str().c_str());
+    ASSERT_STREQ("command 4" , nodes[2]->command().str().c_str());
 
     for (size_t i = 0; i < nodes.size(); i++)
         ASSERT_NO_THROW(printer(nodes[i]));
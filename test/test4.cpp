@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class collect_nodes
+{
+public:
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    void operator ()(
+        const h1st::hist_node* node
+    )
+    {
+        nodes.push_back(node);
+    }
+};
+
+/**
+ *
+ */
+TEST(TestPruning, Overwrite)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_out;
+    files_out.push_back("out.txt");
+
+    for (int i = 0; i < 1000; i++)
+    {
+        std::stringstream ss;
+        ss << "command " << i;
+
+        ASSERT_NO_THROW(graph.push_node(
+            ss.str(), files_out.begin(), files_out.end()));
+    }
+
+    collect_nodes printer;
+    graph.print(printer);
+
+    ASSERT_EQ(1, printer.nodes.size());
+    ASSERT_STREQ("command 999", printer.nodes[0]->command().str().c_str());
+}
+
+/**
+ *
+ */
+TEST(TestPruning, InPlaceUpdate)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files;
+    files.push_back("out.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 0", files.begin(), files.end()));
+
+    for (int i = 1; i < 100; i++)
+    {
+        std::stringstream ss;
+        ss << "command " << i;
+
+        ASSERT_NO_THROW(graph.push_node(files.begin(), files.end(),
+            ss.str(), files.begin(), files.end()));
+    }
+
+    collect_nodes printer;
+    graph.print(printer);
+
+    ASSERT_EQ(100, printer.nodes.size());
+
+    for (size_t i = 0; i < printer.nodes.size(); i++)
+        ASSERT_EQ((int)i, printer.nodes[i]->uuid());
+}
+
+/**
+ *
+ */
+TEST(TestPruning, ShadowCascade)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> x(1, "x.txt");
+    std::vector<std::string> y(1, "y.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 1", x.begin(), x.end()));
+    ASSERT_NO_THROW(graph.push_node(x.begin(), x.end(),
+        "command 2", y.begin(), y.end()));
+    ASSERT_NO_THROW(graph.push_node(
+        "command 3", x.begin(), x.end()));
+
+    {
+        collect_nodes printer;
+        graph.print(printer);
+
+        ASSERT_EQ(3, printer.nodes.size());
+    }
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 4", y.begin(), y.end()));
+
+    collect_nodes printer;
+    graph.print(printer);
+
+    ASSERT_EQ(2, printer.nodes.size());
+    ASSERT_STREQ("command 3", printer.nodes[0]->command().str().c_str());
+    ASSERT_STREQ("command 4", printer.nodes[1]->command().str().c_str());
+}
+
+/**
+ *
+ */
+TEST(TestTraversal, DeepChain)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_in;
+    std::vector<std::string> files_out(1, "out.0.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 0", files_out.begin(), files_out.end()));
+
+    for (int i = 1; i < 200000; i++)
+    {
+        std::stringstream ss;
+        ss << "out." << i << ".txt";
+
+        files_in.swap(files_out);
+        files_out.assign(1, ss.str());
+
+        ASSERT_NO_THROW(graph.push_node(files_in.begin(), files_in.end(),
+            "command", files_out.begin(), files_out.end()));
+    }
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    ASSERT_TRUE(graph.track(files_out.begin(), files_out.end(),
+        std::back_inserter(nodes), false));
+
+    ASSERT_EQ(200000, nodes.size());
+    ASSERT_STREQ("command 0", nodes[0]->command().str().c_str());
+}
+
+/**
+ *
+ */
+TEST(TestTraversal, DiamondLattice)
+{
+    const int width = 4;
+    const int depth = 200;
+
+    h1st::hist_graph graph;
+
+    std::vector<std::string> layer;
+
+    for (int i = 0; i < width; i++)
+    {
+        std::stringstream ss;
+        ss << "out.0." << i << ".txt";
+        layer.push_back(ss.str());
+
+        ASSERT_NO_THROW(graph.push_node(
+            "command", layer.end() - 1, layer.end()));
+    }
+
+    for (int d = 1; d < depth; d++)
+    {
+        std::vector<std::string> next;
+
+        for (int i = 0; i < width; i++)
+        {
+            std::stringstream ss;
+            ss << "out." << d << "." << i << ".txt";
+            next.push_back(ss.str());
+
+            std::vector<std::string> files_in;
+            files_in.push_back(layer[i]);
+            files_in.push_back(layer[(i + 1) % width]);
+
+            ASSERT_NO_THROW(graph.push_node(files_in.begin(), files_in.end(),
+                "command", next.end() - 1, next.end()));
+        }
+
+        layer.swap(next);
+    }
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    ASSERT_TRUE(graph.track(layer.begin(), layer.begin() + 1,
+        std::back_inserter(nodes), false));
+
+    ASSERT_EQ(width * depth - (width - 1) * width / 2, nodes.size());
+}
+
+/**
+ *
+ */
+TEST(TestTraversal, IgnoreMissing)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_out(1, "out.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 1", files_out.begin(), files_out.end()));
+
+    std::vector<std::string> files_in;
+    files_in.push_back("out.txt");
+    files_in.push_back("foobar");
+
+    std::vector<const h1st::hist_node*> nodes;
+
+    ASSERT_TRUE(graph.track(files_in.begin(), files_in.begin() + 1,
+        std::back_inserter(nodes), false));
+    ASSERT_FALSE(graph.track(files_in.begin(), files_in.end(),
+        std::back_inserter(nodes), true));
+
+    ASSERT_EQ(2, nodes.size());
+}
+
+}
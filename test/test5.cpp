@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/graph_policies.hpp>
+#include <h1st/historian.hpp>
+#include <h1st/path_table.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef h1st::basic_hist_graph<h1st::null_stats, h1st::eager_pruning,
+    h1st::node_arena, h1st::single_threaded,
+    h1st::version_retention> versioned_graph;
+
+/**
+ *
+ */
+std::string producer(
+    const versioned_graph& graph,
+    const std::string& file
+)
+{
+    std::vector<const h1st::hist_node*> nodes;
+    graph.track(&file, &file + 1, std::back_inserter(nodes), false);
+
+    return nodes.back()->command().str();
+}
+
+/**
+ *
+ */
+TEST(TestPathTable, Intern)
+{
+    h1st::path_table paths;
+
+    ASSERT_EQ(h1st::invalid_path_id, paths.find("out.txt"));
+
+    const h1st::path_id a = paths.intern("out.A.txt");
+    const h1st::path_id b = paths.intern("out.B.txt");
+
+    ASSERT_EQ(0, a);
+    ASSERT_EQ(1, b);
+    ASSERT_EQ(a, paths.intern("out.A.txt"));
+    ASSERT_EQ(b, paths.find("out.B.txt"));
+    ASSERT_EQ(2, paths.size());
+    ASSERT_STREQ("out.B.txt", paths.ref(b).str().c_str());
+    ASSERT_EQ(b, paths.ref(b).id());
+}
+
+/**
+ *
+ */
+TEST(TestPathTable, SharedPrefixes)
+{
+    h1st::path_table paths;
+
+    std::vector<std::string> files;
+
+    for (int i = 0; i < 10000; i++)
+    {
+        std::stringstream ss;
+        ss << "/data/run_0001/stage_" << (i % 7) << "/part_" << i << ".bin";
+        files.push_back(ss.str());
+    }
+
+    std::vector<const std::string*> refs;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        ASSERT_EQ(i, paths.intern(files[i]));
+        refs.push_back(&paths.str(paths.find(files[i])));
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        ASSERT_EQ(i, paths.find(files[i]));
+        ASSERT_EQ(refs[i], &paths.str(static_cast<h1st::path_id>(i)));
+    }
+
+    ASSERT_EQ(h1st::invalid_path_id, paths.find("/data/run_0001/stage_0"));
+}
+
+/**
+ *
+ */
+TEST(TestPathTable, StableHash)
+{
+    ASSERT_EQ(14695981039346656037ULL, h1st::path_table::hash(""));
+    ASSERT_EQ(0xaf63dc4c8601ec8cULL, h1st::path_table::hash("a"));
+}
+
+/**
+ *
+ */
+TEST(TestPathTable, CompactGraphPaths)
+{
+    versioned_graph graph;
+
+    const std::vector<std::string> src(1, "main.c");
+    const std::vector<std::string> obj(1, "main.o");
+
+    graph.push_node("edit 1", src.begin(), src.end());
+    graph.push_node("edit 2", src.begin(), src.end());
+
+    // Rejected batches leave their outputs interned but unbound
+
+    for (int i = 0; i < 100; i++)
+    {
+        std::stringstream ss;
+        ss << "tmp" << i << ".o";
+
+        const std::string file = ss.str();
+
+        std::vector<h1st::hist_step> steps;
+        steps.push_back(h1st::hist_step(src.begin(), src.end(), "cc -c",
+            &file, &file + 1));
+        steps.push_back(h1st::hist_step(obj.begin(), obj.end(), "ld",
+            src.begin(), src.end()));
+
+        ASSERT_THROW(graph.push_batch(steps.begin(), steps.end()),
+            h1st::input_not_found_exception);
+    }
+
+    graph.push_node(src.begin(), src.end(), "cc -c",
+        obj.begin(), obj.end());
+
+    ASSERT_EQ(102, graph.paths().size());
+    ASSERT_EQ(100, graph.compact_paths());
+    ASSERT_EQ(2, graph.paths().size());
+    ASSERT_EQ(0, graph.compact_paths());
+
+    const h1st::path_id id = graph.paths().find("main.o");
+    const h1st::hist_node* node = graph.binding(id);
+
+    ASSERT_EQ(id, node->files_out()[0].id());
+    ASSERT_EQ("main.o", node->files_out()[0].str());
+    ASSERT_EQ(graph.paths().find("main.c"), node->nodes_in()[0].file_id());
+    ASSERT_EQ("main.c", node->nodes_in()[0].file());
+
+    ASSERT_FALSE(graph.has_input("tmp0.o"));
+    ASSERT_EQ(2, graph.generation("main.c"));
+    ASSERT_EQ("edit 1", producer(graph, "main.c@v1"));
+
+    graph.push_node("edit 3", src.begin(), src.end());
+
+    ASSERT_EQ(3, graph.generation("main.c"));
+    ASSERT_EQ("edit 2", producer(graph, "main.c@v2"));
+    ASSERT_EQ("edit 3", producer(graph, "main.c"));
+}
+
+}
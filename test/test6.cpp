@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+#include <h1st/node_arena.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+TEST(TestNodeArena, ReuseFreed)
+{
+    h1st::node_arena arena;
+
+    void* a = arena.allocate(100);
+    void* b = arena.allocate(100);
+
+    ASSERT_NE(a, b);
+    ASSERT_EQ(224, arena.bytes_used());
+
+    arena.deallocate(a, 100);
+    ASSERT_EQ(112, arena.bytes_used());
+
+    ASSERT_EQ(a, arena.allocate(97));
+    ASSERT_NE(a, arena.allocate(100));
+}
+
+/**
+ *
+ */
+TEST(TestNodeArena, LargeBlocks)
+{
+    h1st::node_arena arena;
+
+    void* a = arena.allocate(1 << 20);
+    arena.deallocate(a, 1 << 20);
+
+    ASSERT_EQ(0, arena.bytes_used());
+    ASSERT_EQ(a, arena.allocate((1 << 20) - 100));
+    ASSERT_EQ(1 << 20, arena.bytes_reserved());
+}
+
+/**
+ *
+ */
+TEST(TestNodeArena, GraphChurn)
+{
+    h1st::hist_graph graph;
+
+    std::vector<std::string> files_in(1, "in.txt");
+    std::vector<std::string> files_out(1, "out.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command", files_in.begin(), files_in.end()));
+    ASSERT_NO_THROW(graph.push_node(files_in.begin(), files_in.end(),
+        "command", files_out.begin(), files_out.end()));
+
+    const size_t bytes_used = graph.bytes_used();
+
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_NO_THROW(graph.push_node(files_in.begin(), files_in.end(),
+            "command", files_out.begin(), files_out.end()));
+    }
+
+    ASSERT_EQ(bytes_used, graph.bytes_used());
+}
+
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class TestSnapshot : public ::testing::Test
+{
+protected:
+
+    h1st::hist_graph graph;
+
+    void SetUp(
+    )
+    {
+        {
+            std::vector<std::string> files_out;
+            files_out.push_back("out.A.txt");
+            files_out.push_back("out.B.txt");
+
+            ASSERT_NO_THROW(graph.push_node(
+                "command 1", files_out.begin(), files_out.end()));
+        }
+        {
+            std::vector<std::string> files_out;
+            files_out.push_back("out.A.txt");
+
+            ASSERT_NO_THROW(graph.push_node(
+                "command 2", files_out.begin(), files_out.end()));
+        }
+        {
+            std::vector<std::string> files_in;
+            files_in.push_back("out.A.txt");
+            files_in.push_back("out.B.txt");
+
+            std::vector<std::string> files_out;
+            files_out.push_back("out.C.txt");
+
+            ASSERT_NO_THROW(graph.push_node(files_in.begin(), files_in.end(),
+                "command 3", files_out.begin(), files_out.end()));
+        }
+        {
+            std::vector<std::string> files_out;
+            files_out.push_back("out.D.txt");
+
+            ASSERT_NO_THROW(graph.push_node(
+                "command 4", files_out.begin(), files_out.end()));
+        }
+    }
+};
+
+/**
+ *
+ */
+TEST_F(TestSnapshot, PrintGraph)
+{
+    std::stringstream ss_graph;
+    h1st::hist_node_print_to_stream printer_graph(&ss_graph);
+    graph.print(printer_graph);
+
+    std::stringstream ss_snapshot;
+    h1st::hist_node_print_to_stream printer_snapshot(&ss_snapshot);
+    graph.snapshot().print(printer_snapshot);
+
+    ASSERT_EQ(4, graph.snapshot().num_nodes());
+    ASSERT_EQ(ss_graph.str(), ss_snapshot.str());
+}
+
+/**
+ *
+ */
+TEST_F(TestSnapshot, HasInputs)
+{
+    const h1st::hist_snapshot& snapshot = graph.snapshot();
+
+    ASSERT_TRUE(snapshot.has_input("out.A.txt"));
+    ASSERT_TRUE(snapshot.has_input("out.B.txt"));
+    ASSERT_TRUE(snapshot.has_input("out.C.txt"));
+    ASSERT_TRUE(snapshot.has_input("out.D.txt"));
+    ASSERT_FALSE(snapshot.has_input("out.E.txt"));
+    ASSERT_FALSE(snapshot.has_input(""));
+}
+
+/**
+ *
+ */
+TEST_F(TestSnapshot, TrackInputC)
+{
+    const std::string file = "out.C.txt";
+
+    std::vector<h1st::hist_csr_node> nodes;
+
+    ASSERT_TRUE(graph.snapshot().track(&file, &file + 1,
+        std::back_inserter(nodes), false));
+
+    ASSERT_EQ(3, nodes.size());
+    ASSERT_EQ("command 1", nodes[0]->command());
+    ASSERT_EQ("command 2", nodes[1]->command());
+    ASSERT_EQ("command 3", nodes[2]->command());
+    ASSERT_EQ(2, nodes[2]->nodes_in().size());
+    ASSERT_EQ("out.B.txt", nodes[2]->nodes_in()[1].file());
+    ASSERT_EQ(0, nodes[2]->nodes_in()[1].node()->uuid());
+}
+
+/**
+ *
+ */
+TEST_F(TestSnapshot, TrackMissing)
+{
+    std::vector<std::string> files_in;
+    files_in.push_back("out.D.txt");
+    files_in.push_back("out.E.txt");
+
+    std::vector<h1st::hist_csr_node> nodes;
+
+    ASSERT_THROW(graph.snapshot().track(files_in.begin(), files_in.end(),
+        std::back_inserter(nodes), false), h1st::input_not_found_exception);
+
+    ASSERT_FALSE(graph.snapshot().track(files_in.begin(), files_in.end(),
+        std::back_inserter(nodes), true));
+
+    ASSERT_EQ(1, nodes.size());
+    ASSERT_EQ("command 4", nodes[0]->command());
+}
+
+/**
+ *
+ */
+TEST_F(TestSnapshot, Rebuild)
+{
+    ASSERT_FALSE(graph.snapshot().has_input("out.E.txt"));
+
+    std::vector<std::string> files_out;
+    files_out.push_back("out.D.txt");
+    files_out.push_back("out.E.txt");
+
+    ASSERT_NO_THROW(graph.push_node(
+        "command 5", files_out.begin(), files_out.end()));
+
+    ASSERT_TRUE(graph.snapshot().has_input("out.E.txt"));
+    ASSERT_EQ(4, graph.snapshot().num_nodes());
+}
+
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/historian.hpp>
+#include <h1st/hist_file.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class TestHistFile : public ::testing::Test
+{
+protected:
+
+    h1st::hist_graph graph;
+    std::string file;
+
+    void SetUp(
+    )
+    {
+        file = "test_hist_file.bin";
+
+        for (int i = 0; i < 100; i++)
+        {
+            std::stringstream ss_in;
+            ss_in << "out." << (i - 1) << ".txt";
+
+            std::stringstream ss_out;
+            ss_out << "out." << i << ".txt";
+
+            std::stringstream ss_cmd;
+            ss_cmd << "command " << i;
+
+            std::vector<std::string> files_in(1, ss_in.str());
+            std::vector<std::string> files_out(1, ss_out.str());
+
+            if (i % 10 == 0)
+            {
+                ASSERT_NO_THROW(graph.push_node(ss_cmd.str(),
+                    files_out.begin(), files_out.end()));
+            }
+            else
+            {
+                ASSERT_NO_THROW(graph.push_node(
+                    files_in.begin(), files_in.end(), ss_cmd.str(),
+                    files_out.begin(), files_out.end()));
+            }
+        }
+
+        std::vector<std::string> files_out(1, "out.55.txt");
+
+        ASSERT_NO_THROW(graph.push_node("overwrite",
+            files_out.begin(), files_out.end()));
+    }
+
+    void TearDown(
+    )
+    {
+        std::remove(file.c_str());
+    }
+};
+
+/**
+ *
+ */
+TEST_F(TestHistFile, RoundTrip)
+{
+    ASSERT_NO_THROW(h1st::write_hist_file(file, graph.snapshot()));
+
+    h1st::hist_file_view view(file);
+
+    ASSERT_NO_THROW(view.validate());
+    ASSERT_EQ(graph.snapshot().num_nodes(), view.num_nodes());
+
+    std::stringstream ss_graph;
+    h1st::hist_node_print_to_stream printer_graph(&ss_graph);
+    graph.print(printer_graph);
+
+    std::stringstream ss_view;
+    h1st::hist_node_print_to_stream printer_view(&ss_view);
+    view.print(printer_view);
+
+    ASSERT_EQ(ss_graph.str(), ss_view.str());
+
+    ASSERT_TRUE(view.has_input("out.0.txt"));
+    ASSERT_TRUE(view.has_input("out.99.txt"));
+    ASSERT_FALSE(view.has_input("out.100.txt"));
+
+    const std::string tracked = "out.59.txt";
+    std::vector<h1st::hist_csr_node> nodes;
+
+    ASSERT_TRUE(view.track(&tracked, &tracked + 1,
+        std::back_inserter(nodes), false));
+
+    ASSERT_EQ(10, nodes.size());
+    ASSERT_EQ("command 50", nodes[0]->command());
+    ASSERT_EQ("command 59", nodes[9]->command());
+}
+
+/**
+ *
+ */
+TEST_F(TestHistFile, EmptyGraph)
+{
+    h1st::hist_graph empty;
+
+    ASSERT_NO_THROW(h1st::write_hist_file(file, empty.snapshot()));
+
+    h1st::hist_file_view view(file);
+
+    ASSERT_NO_THROW(view.validate());
+    ASSERT_EQ(0, view.num_nodes());
+    ASSERT_FALSE(view.has_input("out.0.txt"));
+}
+
+/**
+ *
+ */
+TEST_F(TestHistFile, MissingFile)
+{
+    ASSERT_THROW(h1st::hist_file_view view("does/not/exist.bin"),
+        h1st::io_exception);
+}
+
+/**
+ *
+ */
+TEST_F(TestHistFile, Truncated)
+{
+    std::stringstream ss;
+    h1st::write_hist_file(ss, graph.snapshot());
+
+    const std::string data = ss.str();
+
+    {
+        std::ofstream stream(file.c_str(), std::ios::binary);
+        stream.write(data.data(), static_cast<std::streamsize>(
+            data.size() / 2));
+    }
+
+    ASSERT_THROW(h1st::hist_file_view view(file),
+        h1st::invalid_format_exception);
+
+    {
+        std::ofstream stream(file.c_str(), std::ios::binary);
+        stream.write("H1STXXX", 8);
+        stream.write(data.data() + 8, static_cast<std::streamsize>(
+            data.size() - 8));
+    }
+
+    ASSERT_THROW(h1st::hist_file_view view(file),
+        h1st::invalid_format_exception);
+}
+
+/**
+ *
+ */
+void write_corrupt(
+    const std::string& file,
+    std::string data,
+    int section,
+    size_t index,
+    boost::uint32_t value
+)
+{
+    h1st::hist_file_header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    std::memcpy(&data[static_cast<size_t>(header.offsets[section]) +
+        index * sizeof(value)], &value, sizeof(value));
+
+    std::ofstream stream(file.c_str(), std::ios::binary);
+    stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+/**
+ *
+ */
+TEST_F(TestHistFile, Corrupt)
+{
+    std::stringstream ss;
+    h1st::write_hist_file(ss, graph.snapshot());
+
+    const std::string data = ss.str();
+
+    write_corrupt(file, data, h1st::hist_file_header::in_nodes, 3, 1000);
+
+    {
+        h1st::hist_file_view view(file);
+        ASSERT_THROW(view.validate(), h1st::invalid_format_exception);
+    }
+
+    write_corrupt(file, data, h1st::hist_file_header::out_files, 0, 1000);
+
+    {
+        h1st::hist_file_view view(file);
+        ASSERT_THROW(view.validate(), h1st::invalid_format_exception);
+    }
+
+    write_corrupt(file, data, h1st::hist_file_header::bindings, 0, 1000);
+
+    {
+        h1st::hist_file_view view(file);
+        ASSERT_THROW(view.validate(), h1st::invalid_format_exception);
+    }
+
+    write_corrupt(file, data, h1st::hist_file_header::in_offsets, 0, 1);
+
+    ASSERT_THROW(h1st::hist_file_view view(file),
+        h1st::invalid_format_exception);
+
+    write_corrupt(file, data, h1st::hist_file_header::in_offsets, 50, 0);
+
+    {
+        h1st::hist_file_view view(file);
+        ASSERT_THROW(view.validate(), h1st::invalid_format_exception);
+    }
+}
+
+}
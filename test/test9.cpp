@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <h1st/journal.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ *
+ */
+class TestJournal : public ::testing::Test
+{
+protected:
+
+    std::string base;
+    h1st::journal_options options;
+
+    void SetUp(
+    )
+    {
+        base = "test_journal";
+        options.group_records = 4;
+        TearDown();
+    }
+
+    void TearDown(
+    )
+    {
+        std::remove((base + ".journal").c_str());
+        std::remove((base + ".snapshot").c_str());
+    }
+
+    static void push(
+        h1st::journaled_hist_graph& graph,
+        int first,
+        int last
+    )
+    {
+        for (int i = first; i < last; i++)
+        {
+            std::stringstream ss_in;
+            ss_in << "out." << ((i + 6) % 7) << ".txt";
+
+            std::stringstream ss_out;
+            ss_out << "out." << (i % 7) << ".txt";
+
+            std::stringstream ss_cmd;
+            ss_cmd << "command " << i;
+
+            std::vector<std::string> files_in(1, ss_in.str());
+            std::vector<std::string> files_out(1, ss_out.str());
+
+            if (i % 3 == 0 && graph.graph().has_input(files_in[0]))
+            {
+                ASSERT_NO_THROW(graph.push_node(
+                    files_in.begin(), files_in.end(), ss_cmd.str(),
+                    files_out.begin(), files_out.end()));
+            }
+            else
+            {
+                ASSERT_NO_THROW(graph.push_node(ss_cmd.str(),
+                    files_out.begin(), files_out.end()));
+            }
+        }
+    }
+
+    class print_commands
+    {
+    private:
+
+        std::ostream* _p_stream;
+
+    public:
+
+        print_commands(
+            std::ostream* p_stream
+        ) :
+            _p_stream(p_stream)
+        {
+        }
+
+        void operator ()(
+            const h1st::hist_node* node
+        )
+        {
+            for (size_t i = 0; i < node->nodes_in().size(); i++)
+            {
+                (*_p_stream)
+                    << node->nodes_in()[i].file() << "("
+                    << node->nodes_in()[i].node()->command() << ") ";
+            }
+
+            (*_p_stream) << node->command() << " ";
+
+            for (size_t i = 0; i < node->files_out().size(); i++)
+                (*_p_stream) << node->files_out()[i] << " ";
+
+            (*_p_stream) << "\n";
+        }
+    };
+
+    static std::string dump(
+        const h1st::hist_graph& graph
+    )
+    {
+        std::stringstream ss;
+        print_commands printer(&ss);
+        graph.print(printer);
+        return ss.str();
+    }
+};
+
+/**
+ *
+ */
+TEST_F(TestJournal, Replay)
+{
+    std::string expected;
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+        push(graph, 0, 50);
+        expected = dump(graph.graph());
+    }
+
+    h1st::journaled_hist_graph graph(base, options);
+
+    ASSERT_EQ(50, graph.num_records());
+    ASSERT_EQ(expected, dump(graph.graph()));
+}
+
+/**
+ *
+ */
+TEST_F(TestJournal, TornTail)
+{
+    std::string expected;
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+        push(graph, 0, 10);
+        expected = dump(graph.graph());
+    }
+
+    {
+        std::ofstream stream((base + ".journal").c_str(),
+            std::ios::binary | std::ios::app);
+        stream.write("\x20\x00\x00\x00garbage", 11);
+    }
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+
+        ASSERT_EQ(10, graph.num_records());
+        ASSERT_EQ(expected, dump(graph.graph()));
+
+        push(graph, 10, 20);
+        expected = dump(graph.graph());
+    }
+
+    h1st::journaled_hist_graph graph(base, options);
+
+    ASSERT_EQ(20, graph.num_records());
+    ASSERT_EQ(expected, dump(graph.graph()));
+}
+
+/**
+ *
+ */
+TEST_F(TestJournal, Compaction)
+{
+    std::string expected;
+
+    options.compact_records = 16;
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+        push(graph, 0, 40);
+        expected = dump(graph.graph());
+
+        ASSERT_EQ(8, graph.num_records());
+    }
+
+    h1st::journaled_hist_graph graph(base, options);
+
+    ASSERT_EQ(8, graph.num_records());
+    ASSERT_EQ(expected, dump(graph.graph()));
+}
+
+/**
+ *
+ */
+TEST_F(TestJournal, StaleJournal)
+{
+    std::string expected;
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+        push(graph, 0, 30);
+        graph.sync();
+        expected = dump(graph.graph());
+
+        // Simulate a crash between writing the snapshot and resetting
+        // the journal
+        h1st::write_hist_file(base + ".snapshot",
+            graph.graph().snapshot(), 1);
+    }
+
+    {
+        h1st::journaled_hist_graph graph(base, options);
+
+        ASSERT_EQ(0, graph.num_records());
+        ASSERT_EQ(expected, dump(graph.graph()));
+    }
+
+    h1st::write_hist_file(base + ".snapshot", h1st::hist_graph().snapshot(), 5);
+
+    ASSERT_THROW(h1st::journaled_hist_graph graph(base, options),
+        h1st::invalid_format_exception);
+}
+
+}
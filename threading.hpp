@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2019 Caian Benedicto <caianbene@gmail.com>
+ *
+ * This file is part of h1st.
+ *
+ * h1st is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * h1st is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with h1st.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <pthread.h>
+
+namespace h1st {
+
+namespace detail {
+
+class mutex
+{
+private:
+
+    pthread_mutex_t _mutex;
+
+public:
+
+    explicit mutex(
+        bool recursive = false
+    )
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+
+        if (recursive)
+            pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+
+        const int rc = pthread_mutex_init(&_mutex, &attr);
+
+        pthread_mutexattr_destroy(&attr);
+
+        if (rc != 0)
+        {
+            EX3_THROW(thread_exception()
+                << errno_value(rc));
+        }
+    }
+
+    void lock(
+    )
+    {
+        pthread_mutex_lock(&_mutex);
+    }
+
+    void unlock(
+    )
+    {
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    pthread_mutex_t* native(
+    )
+    {
+        return &_mutex;
+    }
+
+    ~mutex(
+    )
+    {
+        pthread_mutex_destroy(&_mutex);
+    }
+
+private:
+
+    mutex(
+        const mutex&
+    );
+
+    mutex& operator =(
+        const mutex&
+    );
+};
+
+class scoped_lock
+{
+private:
+
+    mutex* _mutex;
+
+public:
+
+    scoped_lock(
+        mutex& m
+    ) :
+        _mutex(&m)
+    {
+        _mutex->lock();
+    }
+
+    ~scoped_lock(
+    )
+    {
+        _mutex->unlock();
+    }
+
+private:
+
+    scoped_lock(
+        const scoped_lock&
+    );
+
+    scoped_lock& operator =(
+        const scoped_lock&
+    );
+};
+
+class condition
+{
+private:
+
+    pthread_cond_t _cond;
+
+public:
+
+    condition(
+    )
+    {
+        const int rc = pthread_cond_init(&_cond, 0);
+
+        if (rc != 0)
+        {
+            EX3_THROW(thread_exception()
+                << errno_value(rc));
+        }
+    }
+
+    void wait(
+        mutex& m
+    )
+    {
+        pthread_cond_wait(&_cond, m.native());
+    }
+
+    void notify_one(
+    )
+    {
+        pthread_cond_signal(&_cond);
+    }
+
+    void notify_all(
+    )
+    {
+        pthread_cond_broadcast(&_cond);
+    }
+
+    ~condition(
+    )
+    {
+        pthread_cond_destroy(&_cond);
+    }
+
+private:
+
+    condition(
+        const condition&
+    );
+
+    condition& operator =(
+        const condition&
+    );
+};
+
+}
+
+}